@@ -30,7 +30,11 @@ CONNECTION_DELAY_MSEC  = 4000
 
 USB_UPDATE_MSEC = 200
 
+# Shown with the serial ports, for vehicles running UDP_Receiver
+WIFI_PORTNAME = 'WiFi'
+
 from comms import Comms
+from udpcomms import UdpComms
 from serial.tools.list_ports import comports
 import os
 import tkcompat as tk
@@ -53,6 +57,7 @@ class GCS(msppg.Parser):
         # No communications or arming yet
         self.comms = None
         self.armed = False
+        self.wifi = False
         self.gotimu = False
 
         # Do basic Tk initialization
@@ -345,7 +350,10 @@ class GCS(msppg.Parser):
 
             #self.maps.stop()
 
-            self.comms = Comms(self)
+            # WiFi carries only attitude and receiver display; motors need USB
+            self.wifi = self.portsvar.get() == WIFI_PORTNAME
+
+            self.comms = UdpComms(self) if self.wifi else Comms(self)
             self.comms.start()
 
             self.button_connect['text'] = 'Connecting ...'
@@ -372,6 +380,8 @@ class GCS(msppg.Parser):
                 if not portname in ['COM1', 'COM2']:
                     ports.append(portname)
 
+        ports.append(WIFI_PORTNAME)
+
         return ports
 
     # Checks for changes in port status (hot-plugging USB cables)
@@ -425,7 +435,8 @@ class GCS(msppg.Parser):
     def _enable_buttons(self):
 
         self._enable_button(self.button_imu)
-        self._enable_button(self.button_motors)
+        if not self.wifi:
+            self._enable_button(self.button_motors)
         self._enable_button(self.button_receiver)
         #self._enable_button(self.button_messages)
 
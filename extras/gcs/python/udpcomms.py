@@ -0,0 +1,145 @@
+#!/usr/bin/env python
+'''
+UDP communications support for Hackflight GCS, for ESP8266 and ESP32 vehicles
+running UDP_Receiver
+
+Stick demands go to the RC port, newest-wins: each datagram carries a sequence
+number, and the vehicle ignores any that arrive after a newer one.  Requests go
+to the telemetry port, and each reply comes back with the sequence number of
+its request, so late replies can be dropped.  Nothing is retransmitted except
+a request whose reply never came, so that polling doesn't stall.
+
+The vehicle answers only attitude and receiver requests over WiFi, and takes
+no commands but stick demands; motor tests, arming and parameters need the
+USB serial link, so send_message() drops any other message.
+
+This file is part of Hackflight.
+
+Hackflight is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as 
+published by the Free Software Foundation, either version 3 of the 
+License, or (at your option) any later version.
+This code is distributed in the hope that it will be useful,     
+but WITHOUT ANY WARRANTY without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License 
+along with this code.  If not, see <http:#www.gnu.org/licenses/>.
+'''
+
+HOST           = '192.168.4.1' # vehicle's address on its own access point
+RC_PORT        = 9000
+TELEMETRY_PORT = 9001
+
+MAX_DATAGRAM   = 128
+RESEND_SEC     = 0.05
+
+import socket
+import struct
+from threading import Thread, Lock
+
+import msppg
+
+class UdpComms:
+
+    def __init__(self, gcs, host=HOST):
+
+        self.gcs = gcs
+
+        self.host = host
+
+        self.rc_socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.telemetry_socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.telemetry_socket.settimeout(RESEND_SEC)
+
+        self.rc_sequence = 0
+        self.telemetry_sequence = 0
+
+        # Newest reply so far, and the request still waiting for one
+        self.reply_sequence = 0
+        self.pending = None
+
+        self.lock = Lock()
+
+        self.thread = Thread(target=self.run)
+        self.thread.setDaemon(True)
+
+        self.running = False
+
+    def _send_telemetry(self, message):
+
+        with self.lock:
+            self.telemetry_sequence += 1
+            sequence = self.telemetry_sequence
+
+        self.telemetry_socket.sendto(_datagram(sequence, message), (self.host, TELEMETRY_PORT))
+
+        return sequence
+
+    def send_message(self, serializer, contents):
+
+        # Stick demands only; see above
+        if serializer != msppg.serialize_SET_RC_NORMAL:
+            return
+
+        self.rc_sequence += 1
+        self.rc_socket.sendto(_datagram(self.rc_sequence, serializer(*contents)), (self.host, RC_PORT))
+
+    def send_rc(self, c1, c2, c3, c4, c5, c6):
+
+        self.send_message(msppg.serialize_SET_RC_NORMAL, (c1, c2, c3, c4, c5, c6))
+
+    def send_request(self, request):
+
+        self.pending = request
+        self._send_telemetry(request)
+
+    def run(self):
+
+        while self.running:
+
+            try:
+                data = self.telemetry_socket.recv(MAX_DATAGRAM)
+
+            except socket.timeout:
+                if self.pending is not None:
+                    self._send_telemetry(self.pending)
+                continue
+
+            except:
+                continue
+
+            if len(data) < 4:
+                continue
+
+            sequence = struct.unpack('<I', data[:4])[0]
+
+            # Overtaken by a newer reply
+            if sequence <= self.reply_sequence:
+                continue
+
+            self.reply_sequence = sequence
+            self.pending = None
+
+            for k in range(4, len(data)):
+                self.gcs.parse(data[k:k+1])
+
+    def start(self):
+
+        self.running = True
+
+        self.thread.start()
+
+        self.gcs.newconnect = True
+
+    def stop(self):
+
+        self.running = False
+
+        self.rc_socket.close()
+        self.telemetry_socket.close()
+
+def _datagram(sequence, message):
+
+    return struct.pack('<I', sequence & 0xFFFFFFFF) + message
@@ -0,0 +1,137 @@
+/*
+   Attitude: quaternion and rotation matrix against per-update Euler angles
+
+   The flight code used to turn every IMU quaternion into Euler angles,
+   and to take tilt and vertical acceleration from their sines and cosines.
+   Now it stores the quaternion and rotation matrix, and computes Euler
+   angles only when asked.  Over small-angle flight (roll and pitch within
+   0.2 rad, any heading) both paths must agree, and the new per-update
+   cost must be lower.
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include <random>
+
+#include "testing.hpp"
+
+#include "attitude.hpp"
+
+static const uint16_t COUNT = 1024;
+
+// What every IMU update used to cost
+static void eulerFromQuaternion(const float q[4], float euler[3])
+{
+    euler[0] = atan2f(2*(q[0]*q[1]+q[2]*q[3]), q[0]*q[0]-q[1]*q[1]-q[2]*q[2]+q[3]*q[3]);
+    euler[1] = asinf(2*(q[1]*q[3]-q[0]*q[2]));
+    euler[2] = atan2f(2*(q[1]*q[2]+q[0]*q[3]), q[0]*q[0]+q[1]*q[1]-q[2]*q[2]-q[3]*q[3]);
+    if (euler[2] < 0) euler[2] += 2*M_PI;
+}
+
+static void quaternionFromEuler(float roll, float pitch, float yaw, float q[4])
+{
+    float cr = cosf(roll/2),  sr = sinf(roll/2);
+    float cp = cosf(pitch/2), sp = sinf(pitch/2);
+    float cy = cosf(yaw/2),   sy = sinf(yaw/2);
+
+    q[0] = cr*cp*cy + sr*sp*sy;
+    q[1] = sr*cp*cy - cr*sp*sy;
+    q[2] = cr*sp*cy + sr*cp*sy;
+    q[3] = cr*cp*sy - sr*sp*cy;
+}
+
+static float angleDifference(float a, float b)
+{
+    float d = fmodf(fabsf(a - b), 2*M_PI);
+    return d > M_PI ? 2*M_PI - d : d;
+}
+
+int main(void)
+{
+    printf("attitude_test: quaternion/rotation-matrix attitude vs. per-update Euler angles\n");
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> tilt(-0.2f, 0.2f);
+    std::uniform_real_distribution<float> heading(-M_PI, M_PI);
+
+    static float quaternions[COUNT][4];
+
+    for (uint16_t i=0; i<COUNT; ++i) {
+        quaternionFromEuler(tilt(rng), tilt(rng), heading(rng), quaternions[i]);
+    }
+
+    hf::state_t state = {};
+
+    float maxAngleDiff = 0;
+    float maxTiltDiff = 0;
+    bool memoized = true;
+
+    for (uint16_t i=0; i<COUNT; ++i) {
+
+        const float * q = quaternions[i];
+
+        float old[3];
+        eulerFromQuaternion(q, old);
+
+        hf::Attitude::setQuaternion(state, q[0], q[1], q[2], q[3]);
+
+        const float * euler = hf::Attitude::getEulerAngles(state);
+
+        for (uint8_t k=0; k<3; ++k) {
+            maxAngleDiff = fmaxf(maxAngleDiff, angleDifference(euler[k], old[k]));
+        }
+
+        // Asking again before the next quaternion must not recompute
+        float roll = state.eulerAngles[0];
+        state.eulerAngles[0] = 123;
+        memoized = memoized && hf::Attitude::getEulerAngles(state)[0] == 123;
+        state.eulerAngles[0] = roll;
+
+        // Rangefinder tilt compensation and vertical acceleration, as they were computed from Euler angles
+        const float * R = state.rotationMatrix[2];
+        maxTiltDiff = fmaxf(maxTiltDiff, fabsf(cosf(old[0])*cosf(old[1]) - R[2]));
+
+        float ax = 0.1f, ay = -0.05f, az = 0.99f;
+        float oldAz = -sinf(old[1])*ax + sinf(old[0])*cosf(old[1])*ay + cosf(old[0])*cosf(old[1])*az;
+        maxTiltDiff = fmaxf(maxTiltDiff, fabsf(oldAz - (-R[0]*ax + R[1]*ay + R[2]*az)));
+    }
+
+    hftest::check(maxAngleDiff < 1e-4f, "Euler angles on demand match the per-update ones: max difference %.1e rad", maxAngleDiff);
+
+    hftest::check(memoized, "Euler angles are computed once per quaternion");
+
+    hftest::check(maxTiltDiff < 1e-5f, "tilt and vertical acceleration from the rotation matrix: max difference %.1e", maxTiltDiff);
+
+    volatile float sink = 0;
+
+    double eulerNs = hftest::nsPerCall([&](uint32_t k) {
+            float euler[3];
+            eulerFromQuaternion(quaternions[k % COUNT], euler);
+            sink = sink + euler[0];
+            }, 1000000);
+
+    double quaternionNs = hftest::nsPerCall([&](uint32_t k) {
+            const float * q = quaternions[k % COUNT];
+            hf::Attitude::setQuaternion(state, q[0], q[1], q[2], q[3]);
+            sink = sink + state.rotationMatrix[2][2];
+            }, 1000000);
+
+    printf("  per update: Euler angles %.1f ns, quaternion and rotation matrix %.1f ns\n", eulerNs, quaternionNs);
+
+    hftest::check(quaternionNs < eulerNs, "storing the quaternion costs less than computing Euler angles");
+
+    return hftest::report("attitude_test");
+}
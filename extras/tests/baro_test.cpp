@@ -0,0 +1,209 @@
+/*
+   Barometric altitude: the complementary estimator on simulated pressure traces
+
+   A simulated vehicle sits on the ground while the weather drifts, then
+   climbs well above rangefinder range and hovers, with the barometer at
+   50 Hz (with 1.5 Pa of noise, typical of a MEMS barometer), the accelerometer at 500 Hz, and the
+   rangefinder at 50 Hz while it is in range.  We check the ground
+   reference, the altitude and climb rate above rangefinder range, and the
+   hand-off from rangefinder to barometer.
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include <random>
+
+#include "testing.hpp"
+
+#define private public
+#define protected public
+#include "estimators/complementary.hpp"
+#undef protected
+#undef private
+
+static const float GRAVITY = 9.80665f;
+
+static const float SEA_LEVEL = 101325;
+
+static const float DT = 0.002f;
+
+class SimSensor : public hf::Sensor {
+
+    protected:
+
+        virtual void getMeasurement(hf::measurement_t & measurement) override
+        {
+            (void)measurement;
+        }
+
+        virtual bool ready(float time) override
+        {
+            (void)time;
+            return false;
+        }
+
+    public:
+
+        void add(uint8_t type, float time, float value)
+        {
+            hf::measurement_t m = {};
+            m.type = type;
+            m.time = time;
+            m.values[0] = value;
+            addMeasurement(m);
+        }
+
+        void addAccel(float time, float az)
+        {
+            hf::measurement_t m = {};
+            m.type = hf::MEASUREMENT_ACCELEROMETER;
+            m.time = time;
+            m.values[2] = az;
+            addMeasurement(m);
+        }
+};
+
+// Inverse of the estimator's hypsometric formula
+static float altitudeToPressure(float altitude, float reference)
+{
+    return reference * powf(1 - altitude / 44330.f, 1 / 0.190295f);
+}
+
+// Climbs at 2 m/s from t=4 to t=14, reaching 20 m, easing in and out over half a second
+static void truth(float t, float & z, float & vz, float & az)
+{
+    static const float START = 4, END = 14, RATE = 2, EASE = 0.5f;
+
+    z = vz = az = 0;
+
+    if (t < START) return;
+
+    if (t < START + EASE) {
+        az = RATE / EASE;
+        vz = az * (t - START);
+        z = vz * (t - START) / 2;
+        return;
+    }
+
+    float zEase = RATE * EASE / 2;
+
+    if (t < END - EASE) {
+        vz = RATE;
+        z = zEase + RATE * (t - START - EASE);
+        return;
+    }
+
+    float zCruise = zEase + RATE * (END - START - 2 * EASE);
+
+    if (t < END) {
+        float u = t - (END - EASE);
+        az = -RATE / EASE;
+        vz = RATE + az * u;
+        z = zCruise + RATE * u + az * u * u / 2;
+        return;
+    }
+
+    z = zCruise + zEase;
+}
+
+int main(void)
+{
+    printf("baro_test: barometric altitude on simulated pressure traces\n");
+
+    std::mt19937 rng(1);
+    std::normal_distribution<float> gauss(0, 1);
+
+    hf::ComplementaryEstimator estimator;
+    SimSensor sensor;
+    estimator.addSensor(&sensor);
+
+    hf::state_t state = {};
+    hf::Attitude::setQuaternion(state, 1, 0, 0, 0);
+
+    float maxGroundError = 0;
+    float maxHighError = 0;
+    double highRateSquares = 0;
+    int highCount = 0;
+    float maxHandoffStep = 0;
+    float previousZ = 0;
+    float groundPressureAtArming = 0;
+    float weatherAtArming = 0;
+
+    for (int k=1; k<=10000; ++k) {
+
+        float t = k * DT;
+
+        // Weather: ground pressure falls 10 Pa over the first two seconds, then holds
+        float weather = SEA_LEVEL - 5 * (t < 2 ? t : 2);
+
+        // Arm just before the climb
+        if (t >= 3.5f && !state.armed) {
+            state.armed = true;
+            groundPressureAtArming = estimator._groundPressure;
+            weatherAtArming = weather;
+        }
+
+        float z, vz, az;
+        truth(t, z, vz, az);
+
+        sensor.addAccel(t, 1 + (az + 0.05f * gauss(rng)) / GRAVITY);
+
+        bool inRange = z < 3.5f;
+
+        if (k % 10 == 0) {
+            sensor.add(hf::MEASUREMENT_BAROMETER, t, altitudeToPressure(z, weather) + 1.5f * gauss(rng));
+            if (inRange) {
+                sensor.add(hf::MEASUREMENT_RANGEFINDER, t, z + 0.01f);
+            }
+        }
+
+        estimator.update(state, t);
+
+        float error = fabsf(state.location[2] - z);
+
+        if (t < 3.5f && error > maxGroundError) maxGroundError = error;
+
+        if (t > 16 && error > maxHighError) maxHighError = error;
+
+        if (t > 16) {
+            highRateSquares += (state.inertialVel[2] - vz) * (state.inertialVel[2] - vz);
+            highCount++;
+        }
+
+        // Around the hand-off, the altitude should move like the vehicle, without a step
+        if (t > 4 && z > 3 && z < 8) {
+            float step = fabsf(state.location[2] - previousZ - vz * DT);
+            if (step > maxHandoffStep) maxHandoffStep = step;
+        }
+
+        previousZ = state.location[2];
+    }
+
+    hftest::check(fabsf(groundPressureAtArming - weatherAtArming) < 2,
+            "ground reference tracks the weather: %.1f Pa off at arming", groundPressureAtArming - weatherAtArming);
+
+    hftest::check(maxGroundError < 0.3f, "altitude on the ground stays within %.2f m of zero", maxGroundError);
+
+    hftest::check(maxHighError < 1.0f, "altitude at 20 m, above rangefinder range, within %.2f m", maxHighError);
+
+    float highRateError = sqrt(highRateSquares / highCount);
+
+    hftest::check(highRateError < 0.35f, "climb rate at 20 m: RMS error %.2f m/s", highRateError);
+
+    hftest::check(maxHandoffStep < 0.1f, "no altitude step at the rangefinder-to-barometer hand-off (largest %.3f m)", maxHandoffStep);
+
+    return hftest::report("baro_test");
+}
@@ -0,0 +1,398 @@
+/*
+   DShot frames and timing buffers
+
+   Checks the frame encoder against the worked example in the DShot
+   description (value 1046, no telemetry, is 0x82C6) and the CRC of every
+   value and telemetry bit, plain and bidirectional, against the CRC taken
+   over the whole 12 bits.  Then, for timer clocks from 72 to 600 MHz at
+   each bitrate, it reads the frames back out of the compare-value buffer
+   the way an ESC would, by the duty cycle of each bit, and checks the
+   duty cycles, the low slots after the frame, and that a telemetry
+   request goes out once.  A special command must survive the mixer's
+   writes for its repeat count, and a send() that interrupts another must
+   give way.  Last, ESC replies: we encode commutation periods as an ESC
+   would, to GCR and then to edge times with jitter, and they must come
+   back out of receive() as the right RPM, while replies with a bit flipped
+   or edges missing must be rejected, and enough bad ones in a row must
+   make getRpm() give up.
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include <math.h>
+#include <random>
+
+#include "testing.hpp"
+
+#define private public
+#define protected public
+#include "motors/dshot.hpp"
+#undef protected
+#undef private
+
+static const uint8_t PINS[4] = {1, 2, 3, 4};
+
+static const uint8_t SLOTS = hf::DShotMotor::FRAME_BITS + hf::DShotMotor::RESET_SLOTS;
+
+class TestDShot : public hf::DShotMotor {
+
+    public:
+
+        const uint16_t * buffer = NULL;
+        uint16_t length = 0;
+        uint32_t transfers = 0;
+
+        // Sends again from inside transfer(), as a timer interrupt might
+        bool interrupt = false;
+
+        TestDShot(uint32_t timerHz, uint32_t bitrate, bool bidirectional=false)
+            : hf::DShotMotor(PINS, 4, timerHz, bitrate, bidirectional)
+        {
+        }
+
+        void transfer(const uint16_t * buf, uint16_t len) override
+        {
+            buffer = buf;
+            length = len;
+            ++transfers;
+
+            if (interrupt) {
+                interrupt = false;
+                send();
+            }
+        }
+
+        // Reads a motor's frame back by the duty cycle of each bit
+        uint16_t readFrame(uint8_t index)
+        {
+            uint16_t data = 0;
+
+            for (uint8_t k=0; k<FRAME_BITS; ++k) {
+                // Halfway between the 3/8 and 3/4 duty cycles
+                data = (data << 1) | (buffer[k*4+index] * 16 > _bitTicks * 9);
+            }
+
+            return data;
+        }
+
+}; // class TestDShot
+
+// CRC over the whole 12 bits of value and telemetry, nibble by nibble
+static uint16_t reference(uint16_t value, bool telemetry, bool bidirectional)
+{
+    uint16_t data = (value << 5) | (telemetry ? 0x10 : 0);
+
+    uint16_t crc = (data >> 4) ^ (data >> 8) ^ (data >> 12);
+
+    if (bidirectional) crc = ~crc;
+
+    return data | (crc & 0x0F);
+}
+
+static void checkFrames(void)
+{
+    hftest::check(hf::DShotMotor::frame(1046, false) == 0x82C6, "value 1046 encodes to 0x82C6");
+
+    uint32_t bad = 0;
+
+    for (uint16_t value=0; value<2048; ++value) {
+        for (uint8_t telemetry=0; telemetry<2; ++telemetry) {
+            for (uint8_t bidirectional=0; bidirectional<2; ++bidirectional) {
+                if (hf::DShotMotor::frame(value, telemetry, bidirectional) != reference(value, telemetry, bidirectional)) {
+                    ++bad;
+                }
+            }
+        }
+    }
+
+    hftest::check(bad == 0, "all 4096 values and telemetry bits get the right CRC, plain and inverted (%u wrong)", bad);
+}
+
+static void checkBuffers(void)
+{
+    static const uint32_t clocks[] = {72000000, 84000000, 108000000, 150000000, 168000000, 216000000, 600000000};
+    static const uint32_t bitrates[] = {hf::DSHOT150, hf::DSHOT300, hf::DSHOT600};
+
+    static const float values[4] = {0, 0.001f, 0.5f, 1};
+
+    uint32_t wrongFrames = 0;
+    uint32_t badSlots = 0;
+    uint32_t repeatedTelemetry = 0;
+    double worstPeriod = 0;
+    double worstDuty = 0;
+
+    for (uint32_t hz : clocks) {
+
+        for (uint32_t bitrate : bitrates) {
+
+            TestDShot motors(hz, bitrate);
+
+            motors.requestTelemetry(2);
+            motors.writeAll(values, 4);
+
+            if (motors.length != SLOTS * 4) ++badSlots;
+
+            double bitTicks = (double)hz / bitrate;
+            worstPeriod = fmax(worstPeriod, fabs(motors.getBitTicks() - bitTicks) / bitTicks);
+
+            for (uint8_t k=0; k<4; ++k) {
+
+                uint16_t expected = hf::DShotMotor::frame(hf::DShotMotor::throttleValue(values[k]), k==2);
+
+                if (motors.readFrame(k) != expected) ++wrongFrames;
+
+                for (uint8_t b=0; b<hf::DShotMotor::FRAME_BITS; ++b) {
+                    uint16_t ticks = motors.buffer[b*4+k];
+                    double duty = ticks / bitTicks;
+                    bool one = (expected & (0x8000 >> b)) != 0;
+                    worstDuty = fmax(worstDuty, fabs(duty - (one ? 0.75 : 0.375)));
+                    if (ticks == 0 || ticks >= motors.getBitTicks()) ++badSlots;
+                }
+
+                for (uint8_t b=hf::DShotMotor::FRAME_BITS; b<SLOTS; ++b) {
+                    if (motors.buffer[b*4+k] != 0) ++badSlots;
+                }
+            }
+
+            motors.writeAll(values, 4);
+
+            if (motors.readFrame(2) & 0x10) ++repeatedTelemetry;
+        }
+    }
+
+    hftest::check(wrongFrames == 0, "frames read back from the timing buffers match at 7 clocks x 3 bitrates (%u wrong)", wrongFrames);
+    hftest::check(badSlots == 0, "every bit is high for part of its period and the line idles low after the frame");
+    hftest::check(worstPeriod < 0.01, "bit period within 1%% of the bitrate (worst %.2f%%)", worstPeriod * 100);
+    hftest::check(worstDuty < 0.02, "duty cycles within 2%% of 3/4 and 3/8 (worst %.2f%%)", worstDuty * 100);
+    hftest::check(repeatedTelemetry == 0, "a telemetry request goes out on one frame only");
+}
+
+static void checkCommands(void)
+{
+    static const float values[4] = {0.5f, 0.5f, 0.5f, 0.5f};
+
+    TestDShot motors(168000000, hf::DSHOT600);
+
+    static const uint16_t BEEP = 1;
+
+    motors.command(1, BEEP);
+
+    uint16_t throttle = hf::DShotMotor::frame(hf::DShotMotor::throttleValue(0.5f), false);
+
+    uint8_t commandFrames = 0;
+    uint32_t others = 0;
+
+    // Mixer updates right after the command, which mustn't overwrite it
+    for (uint8_t k=0; k<2*hf::DShotMotor::COMMAND_REPEATS; ++k) {
+
+        motors.writeAll(values, 4);
+
+        if (motors.readFrame(1) == hf::DShotMotor::frame(BEEP, false)) {
+            // The command goes out for its first frames in a row, then never again
+            if (commandFrames == k) ++commandFrames;
+        }
+        else if (motors.readFrame(1) != throttle) {
+            ++others;
+        }
+
+        if (motors.readFrame(0) != throttle || motors.readFrame(2) != throttle || motors.readFrame(3) != throttle) {
+            ++others;
+        }
+    }
+
+    hftest::check(commandFrames == hf::DShotMotor::COMMAND_REPEATS && others == 0,
+            "a command goes out for %u frames despite the mixer's writes, then the throttle resumes (%u)",
+            hf::DShotMotor::COMMAND_REPEATS, commandFrames);
+
+    motors.command(1, hf::DShotMotor::VALUE_MIN);
+    motors.writeAll(values, 4);
+
+    hftest::check(motors.readFrame(1) == throttle, "a throttle value isn't taken as a command");
+
+    // A timer send interrupting the mixer's: only one transfer, with the command counted once
+    motors.command(1, BEEP, 2);
+    motors.transfers = 0;
+    motors.interrupt = true;
+    motors.writeAll(values, 4);
+    uint32_t transfers = motors.transfers;
+    motors.writeAll(values, 4);
+    bool second = motors.readFrame(1) == hf::DShotMotor::frame(BEEP, false);
+
+    hftest::check(transfers == 1 && second, "a send() that interrupts another gives way to it");
+}
+
+// ESC side of a reply: commutation period in usec to 20 bits of GCR
+static uint32_t encodeReply(uint32_t period)
+{
+    static const uint8_t gcr[16] = {
+        0x19, 0x1B, 0x12, 0x13, 0x1D, 0x15, 0x16, 0x17, 0x1A, 0x09, 0x0A, 0x0B, 0x1E, 0x0D, 0x0E, 0x0F
+    };
+
+    // 3-bit shift and 9-bit mantissa, with all ones for a stopped motor
+    uint32_t value = 0x0FFF;
+
+    if (period > 0) {
+        uint32_t shift = 0;
+        while (period > 511) {
+            period >>= 1;
+            ++shift;
+        }
+        value = (shift << 9) | period;
+    }
+
+    uint32_t data = (value << 4) | (~(value ^ (value >> 4) ^ (value >> 8)) & 0x0F);
+
+    uint32_t result = 0;
+
+    for (int8_t k=3; k>=0; --k) {
+        result = (result << 5) | gcr[(data >> (4*k)) & 0x0F];
+    }
+
+    return result;
+}
+
+// Period as the reply can carry it, with the low bits lost to the shift
+static uint32_t representable(uint32_t period)
+{
+    uint32_t shift = 0;
+
+    while (period > 511) {
+        period >>= 1;
+        ++shift;
+    }
+
+    return period << shift;
+}
+
+static std::mt19937 rng(1);
+
+// Times of the level changes for a start bit and the GCR bits, each moved by up to jitter bits
+static uint8_t replyEdges(uint32_t gcr, uint32_t bitTicks, float jitter, uint32_t * edges)
+{
+    std::uniform_real_distribution<float> offset(-jitter, jitter);
+
+    uint32_t bits = (1 << 20) | gcr;
+
+    uint8_t count = 0;
+
+    for (int8_t k=20; k>=0; --k) {
+        if (bits & (1 << k)) {
+            edges[count++] = (uint32_t)(1000 + ((20 - k) + offset(rng)) * bitTicks);
+        }
+    }
+
+    return count;
+}
+
+static void checkReplies(void)
+{
+    TestDShot motors(168000000, hf::DSHOT600, true);
+
+    uint32_t bitTicks = motors.getReplyBitTicks();
+    uint32_t edges[21] = {};
+
+    // Every period up to 1024 usec, then a sample of the rest, with edges off by up to a fifth of a bit
+    uint32_t trips = 0;
+    uint32_t wrongRpm = 0;
+
+    for (uint32_t period=0; period<65408; period += (period < 1024 ? 1 : 37)) {
+
+        uint8_t count = replyEdges(encodeReply(period), bitTicks, 0.2f, edges);
+
+        motors.receive(0, edges, count, bitTicks);
+
+        float rpm = -1;
+        uint32_t expected = representable(period);
+
+        // 14 poles: seven commutation periods per revolution
+        float expectedRpm = expected ? 60e6f / (expected * 7) : 0;
+
+        if (!motors.getRpm(0, rpm) || fabsf(rpm - expectedRpm) > 1e-4f * expectedRpm) {
+            ++wrongRpm;
+        }
+
+        ++trips;
+    }
+
+    hftest::check(wrongRpm == 0 && motors.getReplyErrors() == 0,
+            "%u periods through GCR, jittered edges and receive() come back as the right RPM (%u wrong)", trips, wrongRpm);
+
+    uint32_t flipped = 0;
+    uint32_t flippedPassed = 0;
+
+    for (uint32_t period=20; period<4000; period+=7) {
+        for (uint8_t bit=0; bit<20; ++bit) {
+            uint8_t count = replyEdges(encodeReply(period) ^ (1 << bit), bitTicks, 0, edges);
+            if (hf::DShotMotor::gcrToPeriod(hf::DShotMotor::edgesToGcr(edges, count, bitTicks)) != hf::DShotMotor::INVALID) {
+                ++flippedPassed;
+            }
+            ++flipped;
+        }
+    }
+
+    hftest::check(flippedPassed == 0, "every reply with a bit flipped is rejected (%u of %u got through)", flippedPassed, flipped);
+
+    uint32_t truncated = 0;
+    uint32_t truncatedPassed = 0;
+
+    for (uint32_t period=20; period<4000; period+=13) {
+        uint8_t count = replyEdges(encodeReply(period), bitTicks, 0, edges);
+        for (uint8_t captured=1; captured<count-1; ++captured) {
+            if (hf::DShotMotor::gcrToPeriod(hf::DShotMotor::edgesToGcr(edges, captured, bitTicks)) != hf::DShotMotor::INVALID) {
+                ++truncatedPassed;
+            }
+            ++truncated;
+        }
+    }
+
+    hftest::check(truncatedPassed == 0, "every capture missing edges is rejected (%u of %u got through)", truncatedPassed, truncated);
+
+    // A good reply, then bad ones: the last good RPM stands until MAX_REPLY_ERRORS in a row
+    uint8_t count = replyEdges(encodeReply(200), bitTicks, 0, edges);
+    motors.receive(1, edges, count, bitTicks);
+
+    static const uint32_t garbage[3] = {0, 10, 20};
+
+    float rpm = 0;
+    bool heldOn = true;
+
+    for (uint8_t k=0; k<hf::DShotMotor::MAX_REPLY_ERRORS-1; ++k) {
+        motors.receive(1, garbage, 3, bitTicks);
+        heldOn = heldOn && motors.getRpm(1, rpm) && fabsf(rpm - 60e6f / (200 * 7)) < 1;
+    }
+
+    motors.receive(1, garbage, 3, bitTicks);
+    bool gaveUp = !motors.getRpm(1, rpm);
+
+    motors.receive(1, edges, count, bitTicks);
+    bool recovered = motors.getRpm(1, rpm);
+
+    hftest::check(heldOn && gaveUp && recovered && motors.getReplyErrors() == hf::DShotMotor::MAX_REPLY_ERRORS,
+            "RPM holds through %u bad replies, is dropped at %u, and returns with the next good one",
+            hf::DShotMotor::MAX_REPLY_ERRORS-1, hf::DShotMotor::MAX_REPLY_ERRORS);
+}
+
+int main(void)
+{
+    printf("dshot_test: DShot frames, timing buffers, commands and replies\n");
+
+    checkFrames();
+    checkBuffers();
+    checkCommands();
+    checkReplies();
+
+    return hftest::report("dshot_test");
+}
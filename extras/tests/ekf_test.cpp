@@ -0,0 +1,276 @@
+/*
+   Optical-flow EKF: sparse covariance propagation against the dense original
+
+   The reference below is the dense algebra the EKF used before it was
+   rewritten: full 9x9 KH, (KH - I) P (KH - I)' plus KRK' for the scalar
+   update, and full A P A' for the attitude rotation, with the same
+   symmetrizing and bounding.  Both filters get the same random sequence
+   of measurements and attitude errors, and their covariances must agree
+   to within float round-off.  Then we time one update/finalize cycle of
+   each.
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include <math.h>
+#include <random>
+
+#include "testing.hpp"
+
+#define private public
+#include "estimators/flowekf.hpp"
+#undef private
+
+static const int N = 9;
+
+static const float MAX_COVARIANCE = 100.f;
+static const float MIN_COVARIANCE = 1e-6f;
+
+class DenseEkf {
+
+    public:
+
+        float P[N][N];
+        float S[N];
+
+        static void mult(const float A[N][N], const float B[N][N], float C[N][N])
+        {
+            for (int i=0; i<N; ++i) {
+                for (int j=0; j<N; ++j) {
+                    float sum = 0;
+                    for (int k=0; k<N; ++k) {
+                        sum += A[i][k] * B[k][j];
+                    }
+                    C[i][j] = sum;
+                }
+            }
+        }
+
+        static void trans(const float A[N][N], float At[N][N])
+        {
+            for (int i=0; i<N; ++i) {
+                for (int j=0; j<N; ++j) {
+                    At[j][i] = A[i][j];
+                }
+            }
+        }
+
+        void bound(int i, int j, float p)
+        {
+            if (std::isnan(p) || p > MAX_COVARIANCE) {
+                p = MAX_COVARIANCE;
+            }
+            else if (i==j && p < MIN_COVARIANCE) {
+                p = MIN_COVARIANCE;
+            }
+            P[i][j] = p;
+            P[j][i] = p;
+        }
+
+        void scalarUpdate(const float H[N], float error, float stdMeasNoise)
+        {
+            float PHt[N];
+            for (int i=0; i<N; ++i) {
+                PHt[i] = 0;
+                for (int k=0; k<N; ++k) {
+                    PHt[i] += P[i][k] * H[k];
+                }
+            }
+
+            float R = stdMeasNoise * stdMeasNoise;
+            float HPHR = R;
+            for (int i=0; i<N; ++i) {
+                HPHR += H[i] * PHt[i];
+            }
+
+            float K[N];
+            for (int i=0; i<N; ++i) {
+                K[i] = PHt[i] / HPHR;
+                S[i] += K[i] * error;
+            }
+
+            float KHI[N][N], KHIt[N][N], tmp[N][N];
+            for (int i=0; i<N; ++i) {
+                for (int j=0; j<N; ++j) {
+                    KHI[i][j] = K[i] * H[j] - (i==j ? 1 : 0);
+                }
+            }
+            trans(KHI, KHIt);
+            mult(KHI, P, tmp);
+            mult(tmp, KHIt, P);
+
+            for (int i=0; i<N; ++i) {
+                for (int j=i; j<N; ++j) {
+                    bound(i, j, 0.5f*P[i][j] + 0.5f*P[j][i] + K[i] * R * K[j]);
+                }
+            }
+        }
+
+        void finalize(void)
+        {
+            float v0 = S[6], v1 = S[7], v2 = S[8];
+
+            if ((fabsf(v0) > 0.1e-3f || fabsf(v1) > 0.1e-3f || fabsf(v2) > 0.1e-3f) && (fabsf(v0) < 10 && fabsf(v1) < 10 && fabsf(v2) < 10)) {
+
+                float d0 = v0/2, d1 = v1/2, d2 = v2/2;
+
+                float A[N][N] = {};
+                for (int i=0; i<6; ++i) {
+                    A[i][i] = 1;
+                }
+
+                A[6][6] = 1 - d1*d1/2 - d2*d2/2;
+                A[6][7] = d2 + d0*d1/2;
+                A[6][8] = -d1 + d0*d2/2;
+                A[7][6] = -d2 + d0*d1/2;
+                A[7][7] = 1 - d0*d0/2 - d2*d2/2;
+                A[7][8] = d0 + d1*d2/2;
+                A[8][6] = d1 + d0*d2/2;
+                A[8][7] = -d0 + d1*d2/2;
+                A[8][8] = 1 - d0*d0/2 - d1*d1/2;
+
+                float At[N][N], AP[N][N];
+                trans(A, At);
+                mult(A, P, AP);
+                mult(AP, At, P);
+            }
+
+            S[6] = S[7] = S[8] = 0;
+
+            for (int i=0; i<N; ++i) {
+                for (int j=i; j<N; ++j) {
+                    bound(i, j, 0.5f*P[i][j] + 0.5f*P[j][i]);
+                }
+            }
+        }
+
+}; // class DenseEkf
+
+int main(void)
+{
+    printf("ekf_test: sparse covariance propagation vs. dense reference\n");
+
+    std::mt19937 rng(1);
+    std::normal_distribution<float> gauss(0, 1);
+
+    hf::FlowEkfEstimator sparse;
+    DenseEkf dense;
+
+    // A correlated starting covariance, so that every block takes part
+    for (int i=0; i<N; ++i) {
+        for (int j=0; j<N; ++j) {
+            float p = i==j ? 1.0f + 0.1f*i : 0.05f / (1 + abs(i-j));
+            sparse.P[i][j] = p;
+            dense.P[i][j] = p;
+        }
+        sparse.S[i] = dense.S[i] = 0.1f * i;
+    }
+
+    static const int STEPS = 2000;
+
+    double maxRelDiff = 0;
+    double maxStateDiff = 0;
+
+    for (int step=0; step<STEPS; ++step) {
+
+        // Flow measurement rows have two nonzeros: altitude and one horizontal velocity
+        for (uint8_t axis=0; axis<2; ++axis) {
+
+            uint8_t idx[2] = {2, (uint8_t)(3+axis)};
+            float h[2] = {0.3f*gauss(rng), 0.3f*gauss(rng)};
+
+            // A consistent innovation, so the health monitor stays quiet
+            float HPHR = 0.25f * 0.25f;
+            for (int a=0; a<2; ++a) {
+                for (int b=0; b<2; ++b) {
+                    HPHR += h[a] * dense.P[idx[a]][idx[b]] * h[b];
+                }
+            }
+            float error = sqrtf(HPHR) * gauss(rng);
+
+            sparse.stateEstimatorScalarUpdate(idx, h, 2, error, 0.25f);
+
+            float H[N] = {};
+            H[idx[0]] = h[0];
+            H[idx[1]] = h[1];
+            dense.scalarUpdate(H, error, 0.25f);
+        }
+
+        for (int k=6; k<9; ++k) {
+            float v = 0.01f * gauss(rng);
+            sparse.S[k] = v;
+            dense.S[k] = v;
+        }
+
+        sparse.stateEstimatorFinalize();
+        dense.finalize();
+
+        for (int i=0; i<N; ++i) {
+            for (int j=0; j<N; ++j) {
+                double d = fabs(sparse.P[i][j] - dense.P[i][j]) / (1e-3 + fabs(dense.P[i][j]));
+                if (d > maxRelDiff) maxRelDiff = d;
+            }
+            double d = fabs(sparse.S[i] - dense.S[i]);
+            if (d > maxStateDiff) maxStateDiff = d;
+        }
+    }
+
+    const hf::estimator_health_t & health = sparse._health;
+
+    hftest::check(health.nanResets == 0 && health.divergenceResets == 0,
+            "no health resets during the comparison (%u NaN, %u divergence)", health.nanResets, health.divergenceResets);
+
+    hftest::check(maxRelDiff < 1e-3, "covariance matches dense reference over %d steps: max relative difference %.2e", STEPS, maxRelDiff);
+
+    hftest::check(maxStateDiff < 1e-3, "state matches dense reference: max difference %.2e", maxStateDiff);
+
+    // A block whose correlation exceeds what its variances allow is no longer positive
+    // semi-definite, and gets reset even though its diagonal looks healthy
+    uint32_t resets = health.divergenceResets;
+    sparse.P[3][4] = sparse.P[4][3] = 2 * sqrtf(sparse.P[3][3] * sparse.P[4][4]);
+    sparse.checkHealth();
+    hftest::check(health.divergenceResets == resets + 1 && sparse.P[3][4] == 0,
+            "invalid correlation inside a block triggers a block reset");
+
+    // Cost of one cycle: two scalar updates and a finalize with an attitude rotation
+    double sparseNs = hftest::nsPerCall([&](uint32_t) {
+            uint8_t idx[2] = {2, 3};
+            float h[2] = {0.1f, 0.2f};
+            sparse.stateEstimatorScalarUpdate(idx, h, 2, 0.01f, 0.25f);
+            idx[1] = 4;
+            sparse.stateEstimatorScalarUpdate(idx, h, 2, 0.01f, 0.25f);
+            sparse.S[6] = 1e-3f;
+            sparse.stateEstimatorFinalize();
+            }, 100000);
+
+    double denseNs = hftest::nsPerCall([&](uint32_t) {
+            float H[N] = {};
+            H[2] = 0.1f;
+            H[3] = 0.2f;
+            dense.scalarUpdate(H, 0.01f, 0.25f);
+            H[3] = 0;
+            H[4] = 0.2f;
+            dense.scalarUpdate(H, 0.01f, 0.25f);
+            dense.S[6] = 1e-3f;
+            dense.finalize();
+            }, 100000);
+
+    printf("  update/finalize cycle: sparse %.0f ns, dense %.0f ns (%.1fx)\n", sparseNs, denseNs, denseNs / sparseNs);
+
+    hftest::check(sparseNs < denseNs, "sparse cycle is faster than dense");
+
+    return hftest::report("ekf_test");
+}
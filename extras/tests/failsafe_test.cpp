@@ -0,0 +1,356 @@
+/*
+   Staged failsafe under simulated packet loss
+
+   A vehicle hovering at 10 m, tilted and flown in acro, gets receiver
+   frames every 11 msec through the same path Hackflight uses: LinkQuality
+   decides whether the link is good, Failsafe steps through its stages,
+   and the PID controllers it engages fly a simple rigid-body model with a
+   motor lag.  Each loss pattern (random loss, dropouts of various length,
+   a link lost for good, a low reported link quality, a loss on the
+   ground) must give the stages at the times failsafe_config_t sets, with
+   the default timings and with others.  LinkQuality must also learn the
+   frame rate when the first gaps are odd.
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include <math.h>
+#include <random>
+
+#include "testing.hpp"
+
+#define private public
+#define protected public
+#include "linkquality.hpp"
+#include "failsafe.hpp"
+#include "filters/rcsmoother.hpp"
+#include "pidcontrollers/rate.hpp"
+#include "pidcontrollers/level.hpp"
+#include "pidcontrollers/althold.hpp"
+#undef protected
+#undef private
+
+void hf::Board::outbuf(char * buf)
+{
+    (void)buf;
+}
+
+static const float DT = 1 / 300.f;
+static const float FRAME = 0.011f;
+
+// Loss starts here, once everything has settled
+static const float LOSS_START = 5;
+
+// Tolerance on stage times: a frame, plus a loop iteration
+static const float SLACK = FRAME + DT;
+
+// Frame at time t lost?
+typedef bool (*loss_t)(float t, std::mt19937 & rng);
+
+static bool noLoss(float t, std::mt19937 & rng)
+{
+    (void)t;
+    (void)rng;
+    return false;
+}
+
+static bool random20(float t, std::mt19937 & rng)
+{
+    return t > LOSS_START && rng() % 5 == 0;
+}
+
+static bool dropout300ms(float t, std::mt19937 & rng)
+{
+    (void)rng;
+    return t > LOSS_START && t < LOSS_START + 0.3f;
+}
+
+static bool dropout3s(float t, std::mt19937 & rng)
+{
+    (void)rng;
+    return t > LOSS_START && t < LOSS_START + 3;
+}
+
+static bool lostForGood(float t, std::mt19937 & rng)
+{
+    (void)rng;
+    return t > LOSS_START;
+}
+
+class Run {
+
+    public:
+
+        // Seconds after LOSS_START that each stage was first entered, or -1
+        float entered[5] = {-1, -1, -1, -1, -1};
+
+        // ... that the failsafe went back to OK, and that the link was last judged good again
+        float recovered = -1;
+        float restored = -1;
+
+        uint8_t maxStage = 0;
+
+        float tiltAtLoss = 0;
+        float tiltAtDescent = 0;
+        float meanDescentRate = 0;
+        float minQuality = 1;
+
+        Run(loss_t loss, const hf::failsafe_config_t & config, int8_t reported=-1, float throttle=0.03f)
+        {
+            std::mt19937 rng(7);
+
+            hf::RatePid rate(0.225f, 0.001875f, 0.375f, 1.0625f, 0.005625f);
+            hf::LevelPid level(0.20f);
+            hf::AltitudeHoldPid althold(1.0f, 0.15f, 0.01f, 0.05f);
+
+            // The pilot flies in acro, so the level and altitude-hold controllers run only when the failsafe says
+            level.auxState = 1;
+            althold.auxState = 2;
+            hf::PidController * controllers[3] = {&level, &rate, &althold};
+
+            hf::LinkQuality quality;
+            hf::Failsafe failsafe;
+            failsafe._config = config;
+            hf::RcSmoother smoother;
+
+            hf::state_t state = {};
+            state.armed = true;
+
+            float roll = 15 * M_PI / 180, pitch = 10 * M_PI / 180;
+            float p = 0, q = 0, r = 0;
+            float z = 10, vz = 0;
+            float torque[3] = {};
+
+            float nextFrame = 0;
+            float descentSum = 0;
+            uint32_t descentCount = 0;
+
+            for (float t=0; t<30; t+=DT) {
+
+                float since = t - LOSS_START;
+
+                // Hackflight::checkFailsafe()
+                if (t >= nextFrame) {
+                    nextFrame += FRAME;
+                    if (!loss(t, rng)) {
+                        hf::demands_t demands = {throttle, 0, 0, 0};
+                        smoother.addFrame(demands, t);
+                        quality.addFrame(t);
+                        if (reported >= 0) {
+                            quality.addReported(since > 0 ? reported : 100);
+                        }
+                    }
+                }
+
+                bool linkGood = quality.timeSinceFrame(t) < config.signalTimeout && quality.get() >= config.minLinkQuality;
+
+                if (since > 0 && linkGood && !failsafe._wasGood) {
+                    restored = since;
+                }
+
+                if (since > 0 && quality.get() < minQuality) {
+                    minQuality = quality.get();
+                }
+
+                uint8_t before = failsafe.getStage();
+
+                failsafe.update(t, linkGood, state.armed, throttle < -0.9f);
+
+                uint8_t stage = failsafe.getStage();
+
+                float tilt = sqrtf(roll*roll + pitch*pitch) * 180 / M_PI;
+
+                if (since <= 0) {
+                    tiltAtLoss = tilt;
+                }
+
+                if (entered[stage] < 0) {
+                    entered[stage] = since;
+                    if (stage == hf::FAILSAFE_DESCEND) {
+                        tiltAtDescent = tilt;
+                    }
+                }
+
+                if (stage > maxStage) {
+                    maxStage = stage;
+                }
+
+                if (before != hf::FAILSAFE_OK && stage == hf::FAILSAFE_OK && recovered < 0) {
+                    recovered = since;
+                }
+
+                if (stage == hf::FAILSAFE_DISARM) {
+                    break;
+                }
+
+                // PidTask::doTask()
+                state.eulerAngles[0] = roll;
+                state.eulerAngles[1] = pitch;
+                state.eulerAngles[2] = 0;
+                state.eulerValid = true;
+                state.angularVel[0] = p;
+                state.angularVel[1] = q;
+                state.angularVel[2] = r;
+                state.location[2] = z;
+                state.inertialVel[2] = vz;
+
+                hf::demands_t demands = {};
+                smoother.get(t, demands);
+                failsafe.modifyDemands(demands);
+
+                for (uint8_t k=0; k<3; ++k) {
+                    controllers[k]->updateReceiver(false);
+                    if (controllers[k]->auxState == 0 || failsafe.engages(controllers[k]->gainsId())) {
+                        controllers[k]->modifyDemands(&state, demands);
+                    }
+                }
+
+                if (stage == hf::FAILSAFE_DESCEND) {
+                    descentSum += vz;
+                    ++descentCount;
+                }
+
+                // Motor lag, torque to angular acceleration, thrust to vertical acceleration
+                float cyclic[3] = {demands.roll, demands.pitch, demands.yaw};
+                for (uint8_t k=0; k<3; ++k) {
+                    torque[k] += (DT / 0.02f) * (cyclic[k] - torque[k]);
+                }
+                p += 150 * torque[0] * DT;
+                q += 150 * torque[1] * DT;
+                r += 50 * torque[2] * DT;
+                roll += p * DT;
+                pitch += q * DT;
+
+                float thrust = hf::Filter::constrainMinMax((demands.throttle + 1) / 2, 0, 1);
+                vz += (2 * 9.81f * thrust * cosf(roll) * cosf(pitch) - 9.81f) * DT;
+                z += vz * DT;
+                if (z < 0) {
+                    z = 0;
+                    vz = 0;
+                }
+            }
+
+            meanDescentRate = descentCount ? descentSum / descentCount : 0;
+        }
+
+        static bool near(float actual, float expected)
+        {
+            return actual >= expected - SLACK && actual <= expected + SLACK;
+        }
+
+        // Stages entered at the times the configuration sets, starting when the link went bad
+        bool followsConfig(const hf::failsafe_config_t & config, float bad)
+        {
+            return near(entered[hf::FAILSAFE_HOLD], bad) &&
+                   near(entered[hf::FAILSAFE_LEVEL], bad + config.holdTime) &&
+                   near(entered[hf::FAILSAFE_DESCEND], bad + config.holdTime + config.levelTime) &&
+                   near(entered[hf::FAILSAFE_DISARM], bad + config.holdTime + config.levelTime + config.descentTime);
+        }
+
+        void print(const char * name)
+        {
+            printf("  %-22s max stage %d, min quality %.2f", name, maxStage, minQuality);
+            static const char * stages[5] = {"", "hold", "level", "descend", "disarm"};
+            for (uint8_t k=1; k<5; ++k) {
+                if (entered[k] >= 0) printf(", %s %+.2f s", stages[k], entered[k]);
+            }
+            if (recovered >= 0) printf(", OK %+.2f s", recovered);
+            printf("\n");
+        }
+
+}; // class Run
+
+int main(void)
+{
+    printf("failsafe_test: failsafe stages under simulated packet loss\n");
+
+    hf::failsafe_config_t defaults;
+
+    Run none(noLoss, defaults);
+    none.print("no loss");
+    hftest::check(none.maxStage == hf::FAILSAFE_OK && none.minQuality > 0.99f, "no loss: link quality stays full, no failsafe");
+
+    Run random(random20, defaults);
+    random.print("20% random loss");
+    hftest::check(random.maxStage == hf::FAILSAFE_OK && random.minQuality >= defaults.minLinkQuality,
+            "20%% random loss: link quality drops to %.2f, above the minimum, no failsafe", random.minQuality);
+
+    Run dropout(dropout300ms, defaults);
+    dropout.print("300 ms dropout");
+    hftest::check(dropout.maxStage == hf::FAILSAFE_HOLD && Run::near(dropout.recovered, 0.3f),
+            "300 ms dropout: holds the last demands and resumes when frames come back");
+
+    Run longDropout(dropout3s, defaults);
+    longDropout.print("3 s dropout");
+    // Link quality takes a few frames to climb back over the minimum
+    hftest::check(longDropout.maxStage == hf::FAILSAFE_DESCEND && longDropout.restored < 3.1f &&
+            Run::near(longDropout.recovered, longDropout.restored + defaults.recoveryTime),
+            "3 s dropout: link good again at +%.2f s, leaves the descent %.1f s later", longDropout.restored, defaults.recoveryTime);
+
+    Run lost(lostForGood, defaults);
+    lost.print("lost for good");
+    hftest::check(lost.followsConfig(defaults, defaults.signalTimeout), "lost for good: stages at the default timings");
+    hftest::check(lost.tiltAtDescent < lost.tiltAtLoss && lost.meanDescentRate < -0.1f,
+            "lost for good: levels (tilt %.1f -> %.1f deg) and descends (%.2f m/s)",
+            lost.tiltAtLoss, lost.tiltAtDescent, lost.meanDescentRate);
+
+    hf::failsafe_config_t quick;
+    quick.signalTimeout = 0.1f;
+    quick.holdTime = 0.5f;
+    quick.levelTime = 1;
+    quick.descentTime = 3;
+    Run lostQuick(lostForGood, quick);
+    lostQuick.print("lost, quick timings");
+    hftest::check(lostQuick.followsConfig(quick, quick.signalTimeout), "lost for good: stages at other timings");
+
+    // A reported quality below the minimum makes the link bad on the first frame that reports it
+    Run reported(noLoss, defaults, 10);
+    reported.print("reported quality 10%");
+    hftest::check(reported.followsConfig(defaults, 0), "reported quality 10%%: stages as soon as it's reported");
+
+    Run ground(lostForGood, defaults, -1, -1);
+    ground.print("lost, throttle down");
+    hftest::check(ground.maxStage == hf::FAILSAFE_DISARM && ground.entered[hf::FAILSAFE_HOLD] < 0 &&
+            Run::near(ground.entered[hf::FAILSAFE_DISARM], defaults.signalTimeout),
+            "lost with the throttle down: disarms at the signal timeout");
+
+    // A frame 1 msec after the first, then the regular 11 msec
+    hf::LinkQuality odd;
+    odd.addFrame(0);
+    float minQuality = 1;
+    for (uint32_t k=0; k<500; ++k) {
+        odd.addFrame(0.001f + k * FRAME);
+        if (odd.get() < minQuality) minQuality = odd.get();
+    }
+    hftest::check(minQuality > 0.99f && fabsf(odd.getInterval() - FRAME) < 1e-4f,
+            "short first gap: interval %.1f ms, quality never below %.2f", 1000*odd.getInterval(), minQuality);
+
+    // Frames at twice the rate for the first few, as from a receiver still starting up
+    hf::LinkQuality fast;
+    float t = 0;
+    for (uint32_t k=0; k<8; ++k) {
+        fast.addFrame(t);
+        t += FRAME / 2;
+    }
+    for (uint32_t k=0; k<200; ++k) {
+        fast.addFrame(t);
+        t += FRAME;
+    }
+    hftest::check(fabsf(fast.getInterval() - FRAME) < 1e-4f && fast.get() > 0.95f,
+            "wrong starting rate: interval relearned as %.1f ms, quality back to %.2f", 1000*fast.getInterval(), fast.get());
+
+    return hftest::report("failsafe_test");
+}
@@ -0,0 +1,98 @@
+/*
+   FastMath: accuracy and speed of the approximations against libm
+
+   Built with HF_FASTMATH, so that FastMath uses its approximations.  The
+   error of each one is measured over the flight envelope (every angle,
+   vector norms from 1e-6 to 1e6, sincos arguments out to an hour of
+   integrated heading at 0.1 rad/sec) and checked against the bounds in
+   fastmath.hpp.  Timings are reported but not checked: the approximations
+   are for FPU-less and single-precision MCUs, and a desktop libm is
+   often faster than they are.
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define HF_FASTMATH
+
+#include <math.h>
+
+#include "testing.hpp"
+
+#include "fastmath.hpp"
+
+using hf::FastMath;
+
+int main(void)
+{
+    printf("fastmath_test: approximations vs. libm\n");
+
+    double error = 0;
+    for (double x=1e-6; x<1e6; x*=1.001) {
+        error = fmax(error, fabs(FastMath::invSqrt((float)x) * sqrt(x) - 1));
+    }
+    hftest::check(error < 5e-6, "invSqrt relative error %.2e", error);
+
+    error = 0;
+    static const double norms[3] = {1e-3, 1, 1e3};
+    for (double a=-M_PI; a<M_PI; a+=1e-4) {
+        for (uint8_t k=0; k<3; ++k) {
+            double angle = FastMath::atan2((float)(norms[k] * sin(a)), (float)(norms[k] * cos(a)));
+            error = fmax(error, fabs(remainder(angle - a, 2*M_PI)));
+        }
+    }
+    hftest::check(error < 2e-6, "atan2 error %.2e rad", error);
+
+    error = 0;
+    for (double x=-1; x<=1; x+=1e-5) {
+        error = fmax(error, fabs(FastMath::asin((float)x) - asin(x)));
+    }
+    hftest::check(error < 8e-5, "asin error %.2e rad", error);
+
+    static const double limits[3] = {2*M_PI, 50, 360};
+    for (uint8_t k=0; k<3; ++k) {
+        error = 0;
+        for (double x=-limits[k]; x<limits[k]; x+=1e-3) {
+            float s = 0, c = 0;
+            FastMath::sincos((float)x, s, c);
+            error = fmax(error, fmax(fabs(s - sin((float)x)), fabs(c - cos((float)x))));
+        }
+        double bound = k == 0 ? 5e-7 : 1e-7 * limits[k];
+        hftest::check(error < bound, "sincos error %.2e for |x| < %.0f", error, limits[k]);
+    }
+
+    static const uint32_t CALLS = 10000000;
+
+    volatile float sink = 0;
+
+    printf("  ns per call, libm vs. FastMath:\n");
+
+    double libm = hftest::nsPerCall([&](uint32_t k) { sink = sink + 1 / sqrtf(0.1f + k*1e-7f); }, CALLS);
+    double fast = hftest::nsPerCall([&](uint32_t k) { sink = sink + FastMath::invSqrt(0.1f + k*1e-7f); }, CALLS);
+    printf("    invSqrt %6.2f %6.2f\n", libm, fast);
+
+    libm = hftest::nsPerCall([&](uint32_t k) { sink = sink + atan2f(0.1f + k*1e-7f, 0.7f); }, CALLS);
+    fast = hftest::nsPerCall([&](uint32_t k) { sink = sink + FastMath::atan2(0.1f + k*1e-7f, 0.7f); }, CALLS);
+    printf("    atan2   %6.2f %6.2f\n", libm, fast);
+
+    libm = hftest::nsPerCall([&](uint32_t k) { sink = sink + asinf(0.1f + k*1e-8f); }, CALLS);
+    fast = hftest::nsPerCall([&](uint32_t k) { sink = sink + FastMath::asin(0.1f + k*1e-8f); }, CALLS);
+    printf("    asin    %6.2f %6.2f\n", libm, fast);
+
+    libm = hftest::nsPerCall([&](uint32_t k) { float x = 0.1f + k*1e-7f; sink = sink + sinf(x) + cosf(x); }, CALLS);
+    fast = hftest::nsPerCall([&](uint32_t k) { float s = 0, c = 0; FastMath::sincos(0.1f + k*1e-7f, s, c); sink = sink + s + c; }, CALLS);
+    printf("    sincos  %6.2f %6.2f\n", libm, fast);
+
+    return hftest::report("fastmath_test");
+}
@@ -0,0 +1,250 @@
+/*
+   Gyro filter chain: gain, phase delay, notch tracking and CPU per sample
+
+   Gain and delay are measured by correlating the output of a sine sweep
+   against the input, at 1 kHz sampling.  Delay is what matters for the
+   rate loop, so each low-pass is checked against its analog prototype and
+   the notches are checked to leave the control band nearly untouched.
+   The dynamic notch gets motor noise sweeping from 150 to 300 Hz, and
+   noise just below Nyquist, where it must stop short with stable poles.
+   The RPM filter gets noise at the first three harmonics of four motors
+   whose speeds it knows, which it must remove while passing the motion.
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+
+#include "testing.hpp"
+
+#define private public
+#include "filters/gyrofilter.hpp"
+#undef private
+
+static const float SAMPLE_HZ = 1000;
+
+// Motors reporting whatever RPM we set, as bidirectional DShot would
+class RpmMotor : public hf::Motor {
+
+    public:
+
+        float rpm[4] = {};
+
+        RpmMotor(void)
+            : hf::Motor(4)
+        {
+        }
+
+        virtual void write(uint8_t index, float value) override
+        {
+            (void)index;
+            (void)value;
+        }
+
+        virtual bool getRpm(uint8_t index, float & value) override
+        {
+            value = rpm[index];
+            return true;
+        }
+};
+
+// Control-band frequency at which we measure delay
+static const float SIGNAL_HZ = 20;
+
+// Gain and delay (msec) at hz, from the second half of a 20-second run
+static void response(hf::GyroFilter & filter, float hz, float & gain, float & delay)
+{
+    static const int N = 20000;
+
+    double s = 0, c = 0;
+
+    for (int i=0; i<N; ++i) {
+        double phase = 2 * M_PI * hz * i / SAMPLE_HZ;
+        float values[3] = {(float)sin(phase), 0, 0};
+        filter.apply(values);
+        if (i >= N/2) {
+            s += values[0] * sin(phase);
+            c += values[0] * cos(phase);
+        }
+    }
+
+    gain = 2 * sqrt(s*s + c*c) / (N/2);
+    delay = -atan2(c, s) / (2 * M_PI * hz) * 1000;
+}
+
+int main(void)
+{
+    printf("gyrofilter_test: phase delay and CPU per sample\n");
+
+    float gain = 0, delay = 0;
+
+    {
+        hf::GyroFilter filter(SAMPLE_HZ);
+        filter.addPt1(100);
+        response(filter, SIGNAL_HZ, gain, delay);
+        float analog = atan(SIGNAL_HZ / 100.) / (2 * M_PI * SIGNAL_HZ) * 1000;
+        hftest::check(fabsf(delay - analog) < 0.2f && gain > 0.95f,
+                "PT1 100 Hz at 20 Hz: gain %.3f, delay %.2f ms (analog %.2f ms)", gain, delay, analog);
+    }
+
+    {
+        hf::GyroFilter filter(SAMPLE_HZ);
+        filter.addPt2(100);
+        response(filter, SIGNAL_HZ, gain, delay);
+        float analog = atan2(sqrt(2) * 0.2, 1 - 0.04) / (2 * M_PI * SIGNAL_HZ) * 1000;
+        hftest::check(fabsf(delay - analog) < 0.2f && gain > 0.98f,
+                "PT2 100 Hz at 20 Hz: gain %.3f, delay %.2f ms (analog %.2f ms)", gain, delay, analog);
+    }
+
+    {
+        hf::GyroFilter filter(SAMPLE_HZ);
+        filter.addNotch(200, 3);
+        response(filter, 200, gain, delay);
+        hftest::check(gain < 0.01f, "notch at 200 Hz: gain %.4f at its center", gain);
+        response(filter, SIGNAL_HZ, gain, delay);
+        hftest::check(gain > 0.99f && delay < 0.5f, "notch at 200 Hz: gain %.3f, delay %.2f ms at 20 Hz", gain, delay);
+    }
+
+    {
+        hf::GyroFilter filter(SAMPLE_HZ);
+        filter.useDynamicNotch(80, 400, 3);
+
+        double in = 0, out = 0;
+        double phase = 0;
+
+        for (int i=0; i<20000; ++i) {
+            double noiseHz = 150 + 150 * (i / SAMPLE_HZ) / 20;
+            phase += 2 * M_PI * noiseHz / SAMPLE_HZ;
+            float noise = 0.3f * sin(phase);
+            float values[3] = {noise, noise, noise};
+            filter.apply(values);
+            if (i >= 2000) {
+                in += noise * noise;
+                out += values[0] * values[0];
+            }
+        }
+
+        float ratio = sqrt(in / out);
+        hftest::check(ratio > 4, "dynamic notch tracks motor noise sweeping 150-300 Hz: RMS reduced %.1fx", ratio);
+
+        // With nothing but the 20 Hz signal left, the notch settles at its lowest frequency
+        response(filter, SIGNAL_HZ, gain, delay);
+        hftest::check(gain > 0.99f && delay < 1, "dynamic notch: gain %.3f, delay %.2f ms at 20 Hz", gain, delay);
+    }
+
+    {
+        // Asked for a range past Nyquist, with noise at 490 Hz
+        hf::GyroFilter filter(SAMPLE_HZ);
+        filter.useDynamicNotch(80, SAMPLE_HZ, 3);
+
+        float highest = 0;
+        float largestA2 = 0;
+
+        for (int i=0; i<20000; ++i) {
+            float noise = 0.3f * sin(2 * M_PI * 490 * i / SAMPLE_HZ);
+            float values[3] = {noise, noise, noise};
+            filter.apply(values);
+            for (uint8_t axis=0; axis<3; ++axis) {
+                highest = fmaxf(highest, filter._dynamicNotch.getCenterHz(axis));
+                largestA2 = fmaxf(largestA2, fabsf(filter._dynamicNotch._notch[axis]._a2));
+            }
+        }
+
+        hftest::check(highest <= 0.48f * SAMPLE_HZ && largestA2 < 1,
+                "dynamic notch stops short of Nyquist: highest center %.0f Hz, largest |a2| %.4f", highest, largestA2);
+    }
+
+    {
+        RpmMotor motors;
+
+        hf::GyroFilter noisy(SAMPLE_HZ);
+        noisy.useRpmFilter(&motors, 4);
+
+        double noise[3] = {};
+        double residual[3] = {};
+        double phases[4][3] = {};
+
+        // Motors at 6200-9000 RPM, slightly apart, so every harmonic is between the
+        // filter's 100 Hz floor and Nyquist; 5 Hz motion
+        for (int i=0; i<6000; ++i) {
+
+            double t = i / SAMPLE_HZ;
+            double base = 7000 + 800 * sin(2 * M_PI * 0.5 * t);
+            double motion = 0.5 * sin(2 * M_PI * 5 * t);
+
+            double n[3] = {};
+
+            for (uint8_t m=0; m<4; ++m) {
+                motors.rpm[m] = base * (1 + 0.05 * m);
+                for (uint8_t h=0; h<3; ++h) {
+                    phases[m][h] += 2 * M_PI * motors.rpm[m] / 60 * (h + 1) / SAMPLE_HZ;
+                    for (uint8_t axis=0; axis<3; ++axis) {
+                        n[axis] += 0.3 / (h + 1) * sin(phases[m][h] + axis);
+                    }
+                }
+            }
+
+            float values[3] = {(float)(motion + n[0]), (float)(motion + n[1]), (float)(motion + n[2])};
+            noisy.apply(values);
+
+            // After a second to settle
+            if (i >= 1000) {
+                for (uint8_t axis=0; axis<3; ++axis) {
+                    noise[axis] += n[axis] * n[axis];
+                    residual[axis] += (values[axis] - motion) * (values[axis] - motion);
+                }
+            }
+        }
+
+        float ratio = sqrt((noise[0] + noise[1] + noise[2]) / (residual[0] + residual[1] + residual[2]));
+        hftest::check(ratio > 4, "RPM filter removes three harmonics of four motors: RMS reduced %.1fx", ratio);
+
+        // Motors held at 7000 RPM, with nothing but the 20 Hz signal
+        hf::GyroFilter filter(SAMPLE_HZ);
+        filter.useRpmFilter(&motors, 4);
+        for (uint8_t m=0; m<4; ++m) {
+            motors.rpm[m] = 7000 * (1 + 0.05 * m);
+        }
+        response(filter, SIGNAL_HZ, gain, delay);
+        hftest::check(gain > 0.99f && delay < 2, "RPM filter: gain %.3f, delay %.2f ms at 20 Hz", gain, delay);
+    }
+
+    {
+        float values[3] = {0.1f, 0.2f, 0.3f};
+        volatile float sink = 0;
+
+        hf::GyroFilter lowpass(SAMPLE_HZ);
+        lowpass.addPt1(100);
+        lowpass.addPt2(150);
+        double lowpassNs = hftest::nsPerCall([&](uint32_t) { values[0] += 0.001f; lowpass.apply(values); }, 2000000);
+        sink = values[0];
+
+        hf::GyroFilter full(SAMPLE_HZ);
+        full.useDynamicNotch(80, 400, 3);
+        full.addPt1(100);
+        full.addPt2(150);
+        double fullNs = hftest::nsPerCall([&](uint32_t) { values[0] += 0.001f; full.apply(values); }, 2000000);
+        sink = values[0];
+        (void)sink;
+
+        printf("  three axes per sample: PT1 + PT2 %.1f ns, with dynamic notch %.1f ns; sizeof(GyroFilter) %u bytes\n",
+                lowpassNs, fullNs, (unsigned)sizeof(hf::GyroFilter));
+
+        // A 1 kHz loop has a millisecond for everything; the gyro chain should take a small part of it
+        hftest::check(fullNs < 10000, "full chain takes under 1%% of a 1 kHz loop on this host");
+    }
+
+    return hftest::report("gyrofilter_test");
+}
@@ -0,0 +1,197 @@
+/*
+   Gyro latency: what angular velocity the PID controllers see
+
+   Runs the whole Hackflight loop against a simulated clock and an IMU that
+   delivers a new gyro sample every millisecond, numbering the samples in
+   the gyro's X reading.  A PID controller records how many samples behind
+   state.angularVel is each time it runs.  The estimator is drained just
+   before every PID iteration, so it should never be behind at all.  The
+   IMU also reports a steady 1.1 G of acceleration, which the default
+   estimator must turn into an upward vertical acceleration, and a pressure
+   every 20 msec, which must reach the estimator through the barometer
+   Hackflight registers for every IMU and become its ground reference.
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+
+#include "testing.hpp"
+
+#define private public
+#define protected public
+#include "hackflight.hpp"
+#include "mixers/quadxcf.hpp"
+#include "receivers/mock.hpp"
+#include "motors/mock.hpp"
+#undef protected
+#undef private
+
+void hf::Board::outbuf(char * buf)
+{
+    (void)buf;
+}
+
+static const float GYRO_PERIOD = 0.001f;
+static const float LOOP_PERIOD = 50e-6f;
+static const float BARO_PERIOD = 0.02f;
+
+static const float PRESSURE = 98000;
+
+static float simTime;
+
+class SimBoard : public hf::Board {
+
+    protected:
+
+        virtual float getTime(void) override
+        {
+            return simTime;
+        }
+};
+
+class SimIMU : public hf::IMU {
+
+    public:
+
+        uint32_t sample = 0;
+        uint32_t baroSample = 0;
+
+        virtual bool getGyrometer(float & gx, float & gy, float & gz) override
+        {
+            uint32_t due = (uint32_t)(simTime / GYRO_PERIOD);
+
+            if (due == sample) return false;
+
+            sample = due;
+
+            gx = sample;
+            gy = 0;
+            gz = 0;
+
+            return true;
+        }
+
+        virtual bool getAccelerometer(float & ax, float & ay, float & az) override
+        {
+            ax = 0;
+            ay = 0;
+            az = 1.1f;
+
+            return true;
+        }
+
+        virtual bool getBarometer(float & pressure) override
+        {
+            uint32_t due = (uint32_t)(simTime / BARO_PERIOD);
+
+            if (due == baroSample) return false;
+
+            baroSample = due;
+
+            pressure = PRESSURE;
+
+            return true;
+        }
+
+        virtual bool getQuaternion(float & qw, float & qx, float & qy, float & qz, float time) override
+        {
+            (void)time;
+
+            qw = 1;
+            qx = 0;
+            qy = 0;
+            qz = 0;
+
+            return true;
+        }
+};
+
+class ProbePid : public hf::PidController {
+
+    public:
+
+        SimIMU * imu = NULL;
+
+        uint32_t runs = 0;
+        float maxLag = 0;
+
+    protected:
+
+        virtual void modifyDemands(hf::state_t * state, hf::demands_t & demands) override
+        {
+            (void)demands;
+
+            float lag = imu->sample - state->angularVel[0];
+
+            if (lag > maxLag) maxLag = lag;
+
+            runs++;
+        }
+};
+
+int main(void)
+{
+    printf("gyrolatency_test: gyro samples behind at each PID iteration\n");
+
+    // Start from the default calibration, whatever earlier runs saved
+    remove("hackflight.eeprom");
+
+    static SimBoard board;
+    static SimIMU imu;
+    static hf::MockReceiver receiver;
+    static hf::MixerQuadXCF mixer;
+    static hf::MockMotor motors;
+    static hf::Hackflight h;
+    static ProbePid probe;
+
+    probe.imu = &imu;
+
+    // Armed, so the calibration doesn't learn our ramp as gyro bias
+    h.init(&board, &imu, &receiver, &mixer, &motors, true);
+    h.addPidController(&probe);
+
+    for (simTime=LOOP_PERIOD; simTime<0.5f; simTime+=LOOP_PERIOD) {
+        h.update();
+    }
+
+    hftest::check(probe.runs > 100, "PID controllers ran %u times", probe.runs);
+
+    hftest::check(probe.maxLag == 0, "angular velocity at the PID controllers is never behind the gyro (max %.0f samples)",
+            probe.maxLag);
+
+    float accel = h._defaultEstimator._verticalAccel;
+
+    hftest::check(fabsf(accel - 0.1f * 9.80665f) < 1e-3f, "default estimator gets the accelerometer: vertical acceleration %.3f m/s^2",
+            accel);
+
+    // Disarmed this time, as the barometer sets its ground reference only on the ground
+    static SimIMU baroImu;
+    static hf::Hackflight h2;
+
+    h2.init(&board, &baroImu, &receiver, &mixer, &motors, false);
+
+    for (simTime=LOOP_PERIOD; simTime<0.5f; simTime+=LOOP_PERIOD) {
+        h2.update();
+    }
+
+    hf::ComplementaryEstimator & estimator = h2._defaultEstimator;
+
+    hftest::check(estimator._baroCalibrationCount > 0 && fabsf(estimator._groundPressure - PRESSURE) < 1,
+            "default estimator gets the barometer: ground pressure %.0f Pa from %.0f readings",
+            estimator._groundPressure, estimator._baroCalibrationCount);
+
+    return hftest::report("gyrolatency_test");
+}
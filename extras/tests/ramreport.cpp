@@ -0,0 +1,68 @@
+/*
+   RAM used by the flight code's main objects, from sizeof on this host
+
+   Pointers are 8 bytes here and 4 on our MCUs, so objects holding
+   pointers come out a little larger than they are on the vehicle; the
+   filters and estimators hold none to speak of.
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+
+#include "hackflight.hpp"
+#include "estimators/flowekf.hpp"
+#include "filters/exponential.hpp"
+#include "filters/movingaverage.hpp"
+#include "filters/rpmfilter.hpp"
+#include "motors/dshot.hpp"
+
+void hf::Board::outbuf(char * buf)
+{
+    (void)buf;
+}
+
+#define REPORT(type) printf("  %-28s %6u\n", #type, (unsigned)sizeof(type))
+
+int main(void)
+{
+    printf("ramreport: bytes per object (host build, %u-byte pointers)\n\n", (unsigned)sizeof(void *));
+
+    printf("Filters\n");
+    REPORT(hf::ExponentialFilter);
+    REPORT(hf::Pt1Filter);
+    REPORT(hf::MovingAverage<64>);
+    REPORT(hf::BiquadFilter);
+    REPORT(hf::DynamicNotch);
+    REPORT(hf::RpmFilter);
+    REPORT(hf::GyroFilter);
+    REPORT(hf::RcSmoother);
+
+    printf("\nEstimators\n");
+    REPORT(hf::ComplementaryEstimator);
+    REPORT(hf::FlowEkfEstimator);
+
+    printf("\nCore\n");
+    REPORT(hf::state_t);
+    REPORT(hf::Calibration);
+    REPORT(hf::Parameters);
+    REPORT(hf::LinkQuality);
+    REPORT(hf::Failsafe);
+    REPORT(hf::Arming);
+    REPORT(hf::DShotMotor);
+    REPORT(hf::Hackflight);
+
+    return 0;
+}
@@ -0,0 +1,546 @@
+/*
+   Receiver byte-stream decoders: fuzzing and throughput
+
+   Each decoder gets a long stream of frames with random channel values,
+   as its receiver would send them, with bursts of junk between frames,
+   frames that lose a byte (SBUS, which has no checksum) or have a bit
+   flipped (CRSF and IBUS), and for CRSF the statistics and telemetry
+   frames that share the bus.  Every clean frame must come out with its
+   channels intact, and no damaged frame may come out at all.  DSMX, which
+   has neither a checksum nor a header, must resynchronize on the gap
+   after junk.  Then a megabyte of noise goes to each decoder, which must
+   not produce a non-finite channel, and we time StreamReceiver::handleByte
+   on clean streams, decoding included.
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include <math.h>
+#include <string.h>
+#include <random>
+
+#include "testing.hpp"
+
+#define private public
+#define protected public
+#include "receivers/stream.hpp"
+#include "receivers/decoders/sbus.hpp"
+#include "receivers/decoders/dsmx.hpp"
+#include "receivers/decoders/crsf.hpp"
+#include "receivers/decoders/ibus.hpp"
+#undef protected
+#undef private
+
+void hf::Board::outbuf(char * buf)
+{
+    (void)buf;
+}
+
+static const uint8_t CHANNEL_MAP[6] = {0, 1, 2, 3, 4, 5};
+
+static std::mt19937 rng(1);
+
+static uint32_t random(uint32_t n)
+{
+    return rng() % n;
+}
+
+// Sixteen 11-bit channels, LSB first, as SBUS and CRSF pack them
+static void pack11(const uint16_t * channels, uint8_t * data)
+{
+    uint32_t bits = 0;
+    uint8_t count = 0;
+
+    for (uint8_t k=0; k<16; ++k) {
+        bits |= (uint32_t)channels[k] << count;
+        count += 11;
+        while (count >= 8) {
+            *data++ = bits & 0xFF;
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+}
+
+static uint8_t sbusFrame(const uint16_t * channels, bool failsafe, uint8_t * frame)
+{
+    memset(frame, 0, 25);
+    frame[0] = 0x0F;
+    pack11(channels, &frame[1]);
+    frame[23] = failsafe ? 0x08 : 0;
+    return 25;
+}
+
+// Half of a 2048-resolution frame: seven channel words, with 0xFFFF for slots past channel 16
+static uint8_t dsmxFrame(const uint16_t * channels, uint8_t half, uint8_t * frame)
+{
+    frame[0] = 0;
+    frame[1] = 0xB2;
+    for (uint8_t k=0; k<7; ++k) {
+        uint8_t c = half*7 + k;
+        uint16_t word = c < 16 ? (c << 11) | channels[c] : 0xFFFF;
+        frame[2+2*k] = word >> 8;
+        frame[3+2*k] = word & 0xFF;
+    }
+    return 16;
+}
+
+static uint8_t crc8(uint8_t crc, uint8_t c)
+{
+    crc ^= c;
+    for (uint8_t k=0; k<8; ++k) {
+        crc = crc & 0x80 ? (crc << 1) ^ 0xD5 : crc << 1;
+    }
+    return crc;
+}
+
+static uint8_t crsfFrame(uint8_t type, const uint8_t * payload, uint8_t size, uint8_t * frame)
+{
+    frame[0] = 0xC8;
+    frame[1] = size + 2;
+    frame[2] = type;
+    memcpy(&frame[3], payload, size);
+    uint8_t crc = 0;
+    for (uint8_t k=2; k<3+size; ++k) {
+        crc = crc8(crc, frame[k]);
+    }
+    frame[3+size] = crc;
+    return size + 4;
+}
+
+static uint8_t crsfChannels(const uint16_t * channels, uint8_t * frame)
+{
+    uint8_t payload[22];
+    pack11(channels, payload);
+    return crsfFrame(0x16, payload, 22, frame);
+}
+
+static uint8_t crsfStatistics(uint8_t linkQuality, uint8_t * frame)
+{
+    uint8_t payload[10] = {60, 62, linkQuality, (uint8_t)-3, 1, 2, 3, 70, 99, 5};
+    return crsfFrame(0x14, payload, 10, frame);
+}
+
+// Battery telemetry, which a flight controller sees on the bus but doesn't use
+static uint8_t crsfTelemetry(uint8_t * frame)
+{
+    uint8_t payload[8];
+    for (uint8_t k=0; k<8; ++k) {
+        payload[k] = random(256);
+    }
+    return crsfFrame(0x08, payload, 8, frame);
+}
+
+static uint8_t ibusFrame(const uint16_t * channels, uint8_t * frame)
+{
+    frame[0] = 0x20;
+    frame[1] = 0x40;
+    uint16_t sum = 0xFFFF - 0x20 - 0x40;
+    for (uint8_t k=0; k<14; ++k) {
+        frame[2+2*k] = channels[k] & 0xFF;
+        frame[3+2*k] = channels[k] >> 8;
+        sum -= frame[2+2*k] + frame[3+2*k];
+    }
+    frame[30] = sum & 0xFF;
+    frame[31] = sum >> 8;
+    return 32;
+}
+
+// A serial line into a StreamReceiver, with its own clock in usec
+class Wire {
+
+    public:
+
+        hf::StreamReceiver receiver;
+
+        uint32_t usec = 0;
+        uint32_t byteUsec;
+
+        Wire(hf::RxDecoder * decoder, uint32_t byteUsec_)
+            : receiver(decoder, CHANNEL_MAP)
+        {
+            byteUsec = byteUsec_;
+        }
+
+        void send(const uint8_t * bytes, uint8_t count, int8_t skip=-1)
+        {
+            for (uint8_t k=0; k<count; ++k) {
+                if (k != skip) {
+                    receiver.handleByte(bytes[k], usec);
+                }
+                usec += byteUsec;
+            }
+        }
+
+        void junk(uint8_t count)
+        {
+            for (uint8_t k=0; k<count; ++k) {
+                receiver.handleByte(random(256), usec);
+                usec += byteUsec;
+            }
+        }
+
+        // True if the latest frame has these channels, value -> expected(value)
+        template <class F>
+        bool matches(const uint16_t * channels, uint8_t count, F expected)
+        {
+            receiver.readRawvals();
+            for (uint8_t k=0; k<count; ++k) {
+                if (fabsf(receiver.rawvals[k] - expected(channels[k])) > 1e-5f) return false;
+            }
+            return true;
+        }
+
+}; // class Wire
+
+class Tally {
+
+    public:
+
+        uint32_t clean = 0;
+        uint32_t decoded = 0;
+        uint32_t damaged = 0;
+        uint32_t accepted = 0;
+
+        void cleanFrame(bool ok)
+        {
+            ++clean;
+            if (ok) ++decoded;
+        }
+
+        void damagedFrame(bool got)
+        {
+            ++damaged;
+            if (got) ++accepted;
+        }
+
+        void check(const char * name)
+        {
+            hftest::check(decoded == clean && accepted == 0, "%s: %u/%u clean frames decoded, %u/%u damaged ones accepted",
+                    name, decoded, clean, accepted, damaged);
+        }
+
+}; // class Tally
+
+static float unpack11(uint16_t v)
+{
+    return 2 * (v - 172) / 1639.f - 1;
+}
+
+static void fuzzSbus(void)
+{
+    hf::SbusDecoder decoder;
+    Wire wire(&decoder, 120);
+    Tally tally;
+
+    for (uint32_t n=0; n<20000; ++n) {
+
+        uint16_t channels[16];
+        for (uint8_t k=0; k<16; ++k) {
+            channels[k] = 172 + random(1640);
+        }
+
+        uint8_t frame[25];
+        sbusFrame(channels, false, frame);
+
+        if (random(5) == 0) {
+            wire.junk(random(8));
+        }
+
+        wire.usec += 3000;
+
+        int8_t skip = random(10) == 0 ? random(25) : -1;
+
+        uint32_t sequence = wire.receiver.getSequence();
+        wire.send(frame, 25, skip);
+        bool got = wire.receiver.getSequence() != sequence;
+
+        if (skip < 0) {
+            tally.cleanFrame(got && wire.matches(channels, 16, unpack11));
+        }
+        else {
+            tally.damagedFrame(got);
+        }
+    }
+
+    tally.check("SBUS with junk and dropped bytes");
+
+    // The receiver flags failsafe once it loses the transmitter
+    uint16_t channels[16] = {};
+    for (uint8_t n=0; n<12; ++n) {
+        uint8_t frame[25];
+        sbusFrame(channels, true, frame);
+        wire.usec += 7000;
+        wire.send(frame, 25);
+    }
+
+    hftest::check(wire.receiver.lostSignal(), "SBUS: frames flagged failsafe report a lost signal");
+}
+
+static void fuzzDsmx(void)
+{
+    hf::DsmxDecoder decoder;
+    Wire wire(&decoder, 87);
+
+    uint32_t good = 0;
+    static const uint32_t FRAMES = 10000;
+
+    for (uint32_t n=0; n<FRAMES; ++n) {
+
+        uint16_t channels[16];
+        for (uint8_t k=0; k<16; ++k) {
+            channels[k] = random(2048);
+        }
+
+        for (uint8_t half=0; half<2; ++half) {
+
+            uint8_t frame[16];
+            dsmxFrame(channels, half, frame);
+
+            wire.usec += 11000;
+
+            // Junk costs a frame slot, and the decoder must find the next frame by the gap
+            if (random(10) == 0) {
+                wire.junk(5);
+                wire.usec += 11000;
+            }
+
+            wire.send(frame, 16);
+
+            // A stray byte just after a frame must not shift the next one
+            if (random(10) == 0) {
+                wire.junk(1);
+            }
+        }
+
+        if (wire.matches(channels, 14, [](uint16_t v) { return (v - 1024) / 1000.f; })) {
+            ++good;
+        }
+    }
+
+    hftest::check(good == FRAMES, "DSMX with junk: %u/%u frame pairs decoded", good, FRAMES);
+
+    // The control loop reads the frame where it was decoded, without a copy
+    wire.receiver.readRawvals();
+    hftest::check(wire.receiver.rawvals == wire.receiver._blocks[0] || wire.receiver.rawvals == wire.receiver._blocks[1],
+            "DSMX: channels are read in place from the receiver's double buffer");
+}
+
+static void fuzzCrsf(void)
+{
+    hf::CrsfDecoder decoder;
+    Wire wire(&decoder, 24);
+    Tally tally;
+
+    uint8_t percent = 0;
+    hftest::check(!wire.receiver.linkQuality(percent), "CRSF: no link quality before the first statistics frame");
+
+    uint8_t lastQuality = 0;
+
+    for (uint32_t n=0; n<50000; ++n) {
+
+        uint16_t channels[16];
+        for (uint8_t k=0; k<16; ++k) {
+            channels[k] = 172 + random(1640);
+        }
+
+        uint8_t frame[64];
+        uint8_t size = crsfChannels(channels, frame);
+
+        bool flip = random(10) == 0;
+        if (flip) {
+            frame[3 + random(23)] ^= 1 << random(8);
+        }
+
+        wire.usec += 2000;
+
+        if (random(5) == 0) {
+            wire.junk(6);
+            wire.usec += 600;
+        }
+
+        uint32_t sequence = wire.receiver.getSequence();
+        wire.send(frame, size);
+        bool got = wire.receiver.getSequence() != sequence;
+
+        if (flip) {
+            tally.damagedFrame(got);
+        }
+        else {
+            tally.cleanFrame(got && wire.matches(channels, 16, unpack11));
+        }
+
+        // Statistics and telemetry right behind the channels, with no gap
+        if (random(4) == 0) {
+            if (random(2)) {
+                lastQuality = n % 101;
+                size = crsfStatistics(lastQuality, frame);
+            }
+            else {
+                size = crsfTelemetry(frame);
+            }
+            wire.send(frame, size);
+        }
+    }
+
+    tally.check("CRSF with junk, bit flips and other frame types");
+
+    hf::crsf_link_statistics_t statistics = {};
+    decoder.getLinkStatistics(statistics);
+    bool gotQuality = wire.receiver.linkQuality(percent);
+
+    hftest::check(gotQuality && percent == lastQuality && statistics.uplinkRssi1 == 60 && statistics.uplinkSnr == -3 &&
+            statistics.downlinkLinkQuality == 99, "CRSF: link statistics decoded (uplink quality %u%%)", percent);
+}
+
+static void fuzzIbus(void)
+{
+    hf::IbusDecoder decoder;
+    Wire wire(&decoder, 87);
+    Tally tally;
+
+    for (uint32_t n=0; n<20000; ++n) {
+
+        uint16_t channels[14];
+        for (uint8_t k=0; k<14; ++k) {
+            channels[k] = 1000 + random(1001);
+        }
+
+        uint8_t frame[32];
+        ibusFrame(channels, frame);
+
+        bool flip = random(10) == 0;
+        if (flip) {
+            frame[2 + random(28)] ^= 1 << random(8);
+        }
+
+        wire.usec += 7000;
+
+        if (random(5) == 0) {
+            wire.junk(6);
+            wire.usec += 1000;
+        }
+
+        uint32_t sequence = wire.receiver.getSequence();
+        wire.send(frame, 32);
+        bool got = wire.receiver.getSequence() != sequence;
+
+        if (flip) {
+            tally.damagedFrame(got);
+        }
+        else {
+            tally.cleanFrame(got && wire.matches(channels, 14, [](uint16_t v) { return (v - 1500) / 500.f; }));
+        }
+    }
+
+    tally.check("IBUS with junk and bit flips");
+}
+
+// Noise with random gaps; whatever the decoder makes of it must at least be numbers
+static void noise(const char * name, hf::RxDecoder * decoder, uint32_t byteUsec)
+{
+    Wire wire(decoder, byteUsec);
+
+    bool finite = true;
+    uint32_t sequence = 0;
+
+    for (uint32_t n=0; n<1000000; ++n) {
+
+        if (random(50) == 0) {
+            wire.usec += random(10000);
+        }
+
+        wire.junk(1);
+
+        if (wire.receiver.getSequence() != sequence) {
+            sequence = wire.receiver.getSequence();
+            wire.receiver.readRawvals();
+            for (uint8_t k=0; k<hf::RxDecoder::MAXCHAN; ++k) {
+                if (!isfinite(wire.receiver.rawvals[k])) finite = false;
+            }
+        }
+    }
+
+    hftest::check(finite, "%s: a megabyte of noise gives %u frames, all finite", name, sequence);
+}
+
+// Clean frames back to back at the protocol's frame rate
+static double throughput(hf::RxDecoder * decoder, const uint8_t * frame, uint8_t size, uint32_t byteUsec, uint32_t gapUsec)
+{
+    Wire wire(decoder, byteUsec);
+
+    return hftest::nsPerCall([&](uint32_t k) {
+            if (k % size == 0) wire.usec += gapUsec;
+            wire.receiver.handleByte(frame[k % size], wire.usec);
+            wire.usec += byteUsec;
+            }, 100000 * size);
+}
+
+int main(void)
+{
+    printf("rxdecoder_test: receiver decoders against damaged streams\n");
+
+    fuzzSbus();
+    fuzzDsmx();
+    fuzzCrsf();
+    fuzzIbus();
+
+    hf::SbusDecoder sbus;
+    hf::DsmxDecoder dsmx;
+    hf::CrsfDecoder crsf;
+    hf::IbusDecoder ibus;
+
+    noise("SBUS", &sbus, 120);
+    noise("DSMX", &dsmx, 87);
+    noise("CRSF", &crsf, 24);
+    noise("IBUS", &ibus, 87);
+
+    uint16_t channels[16];
+    for (uint8_t k=0; k<16; ++k) {
+        channels[k] = 1000 + k;
+    }
+
+    uint8_t frame[64];
+    hf::SbusDecoder sbus2;
+    hf::DsmxDecoder dsmx2;
+    hf::CrsfDecoder crsf2;
+    hf::IbusDecoder ibus2;
+
+    double ns[4] = {};
+    uint8_t sizes[4] = {};
+
+    sizes[0] = sbusFrame(channels, false, frame);
+    ns[0] = throughput(&sbus2, frame, sizes[0], 120, 3000);
+    sizes[1] = dsmxFrame(channels, 0, frame);
+    ns[1] = throughput(&dsmx2, frame, sizes[1], 87, 11000);
+    sizes[2] = crsfChannels(channels, frame);
+    ns[2] = throughput(&crsf2, frame, sizes[2], 24, 2000);
+    sizes[3] = ibusFrame(channels, frame);
+    ns[3] = throughput(&ibus2, frame, sizes[3], 87, 7000);
+
+    static const char * names[4] = {"SBUS", "DSMX", "CRSF", "IBUS"};
+
+    double worst = 0;
+    for (uint8_t k=0; k<4; ++k) {
+        printf("  %s: %.1f ns/byte, %.0f ns/frame with decoding\n", names[k], ns[k], ns[k] * sizes[k]);
+        if (ns[k] > worst) worst = ns[k];
+    }
+
+    // CRSF at 420 kbaud, the fastest of them, delivers a byte every 24 usec
+    hftest::check(worst < 1000, "every decoder takes well under a byte time per byte on this host");
+
+    return hftest::report("rxdecoder_test");
+}
@@ -0,0 +1,176 @@
+/*
+   Stick curves: receiver demands against the original expo functions
+
+   Receiver::getDemands() used to shape the sticks with rcFun() and
+   throttleFun(); it now uses StickCurve, set from the parameters.  We
+   sweep every stick channel over [-1,+1] in steps of 1e-4 and compare the
+   demands with the original functions, embedded here, first with the
+   default parameters and then after the GCS changes the expo and rate
+   through SET_PARAMETER.
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include <math.h>
+
+#include "testing.hpp"
+
+#define private public
+#define protected public
+#include "hackflight.hpp"
+#include "mixers/quadxcf.hpp"
+#include "imus/mock.hpp"
+#include "motors/mock.hpp"
+#undef protected
+#undef private
+
+void hf::Board::outbuf(char * buf)
+{
+    (void)buf;
+}
+
+static const uint8_t CHANNEL_MAP[6] = {0, 1, 2, 3, 4, 5};
+
+static const int STEPS = 20000;
+
+class SimBoard : public hf::Board {
+
+    protected:
+
+        virtual float getTime(void) override
+        {
+            return 0;
+        }
+};
+
+class SimReceiver : public hf::Receiver {
+
+    public:
+
+        SimReceiver(void)
+            : hf::Receiver(CHANNEL_MAP)
+        {
+        }
+
+    protected:
+
+        virtual void begin(void) override
+        {
+        }
+
+        virtual bool gotNewFrame(void) override
+        {
+            return true;
+        }
+
+        virtual void readRawvals(void) override
+        {
+        }
+
+        virtual void pause(void) override
+        {
+        }
+
+        virtual void resume(void) override
+        {
+        }
+};
+
+// The original functions, from before StickCurve
+static float rcFun(float x, float e, float r)
+{
+    return (1 + e*(x*x - 1)) * x * r;
+}
+
+static float throttleFun(float x, float expo)
+{
+    float mid = 0.5;
+    float tmp = (x + 1) / 2 - mid;
+    float y = tmp>0 ? 1-mid : (tmp<0 ? mid : 1);
+    return (mid + tmp*(1-expo + expo * (tmp*tmp) / (y*y))) * 2 - 1;
+}
+
+// Cyclic stick to demand: expo on the magnitude, then halved with the sign put back
+static float cyclic(float x, float expo, float rate)
+{
+    float command = rcFun(fabsf(x), expo, rate) / 2;
+
+    return x < 0 ? -command : command;
+}
+
+// Largest difference from the original functions over the sweep, on any channel
+static float sweep(SimReceiver & receiver, float cyclicExpo, float cyclicRate, float throttleExpo)
+{
+    float worst = 0;
+
+    for (int i=0; i<=STEPS; ++i) {
+
+        float x = -1 + 2.f * i / STEPS;
+
+        // Different inputs on each channel, so a mixed-up channel shows
+        receiver.rawvals[CHANNEL_MAP[hf::Receiver::CHANNEL_THROTTLE]] = x;
+        receiver.rawvals[CHANNEL_MAP[hf::Receiver::CHANNEL_ROLL]]     = x;
+        receiver.rawvals[CHANNEL_MAP[hf::Receiver::CHANNEL_PITCH]]    = -x;
+        receiver.rawvals[CHANNEL_MAP[hf::Receiver::CHANNEL_YAW]]      = x * x * x;
+
+        receiver.getDemands(0);
+
+        float errors[4] = {
+            receiver.demands.throttle - throttleFun(x, throttleExpo),
+            receiver.demands.roll     - cyclic(x, cyclicExpo, cyclicRate),
+            receiver.demands.pitch    - cyclic(-x, cyclicExpo, cyclicRate),
+            receiver.demands.yaw      + x * x * x / 2
+        };
+
+        for (uint8_t k=0; k<4; ++k) {
+            worst = fmaxf(worst, fabsf(errors[k]));
+        }
+    }
+
+    return worst;
+}
+
+int main(void)
+{
+    printf("stickcurve_test: receiver demands vs. the original expo functions\n");
+
+    // Start from the default parameters, whatever earlier runs saved
+    remove("hackflight.eeprom");
+
+    static SimBoard board;
+    static hf::MockIMU imu;
+    static SimReceiver receiver;
+    static hf::MixerQuadXCF mixer;
+    static hf::MockMotor motors;
+    static hf::Hackflight h;
+
+    h.init(&board, &imu, &receiver, &mixer, &motors, false);
+
+    float worst = sweep(receiver, 0.65f, 0.90f, 0.20f);
+
+    hftest::check(worst < 1e-6f, "default expo and rate: demands match on all four channels (max difference %.1e)", worst);
+
+    // Parameters 0-2: cyclic expo, cyclic rate, throttle expo
+    h._serialTask.handle_SET_PARAMETER(0, 0.3f);
+    h._serialTask.handle_SET_PARAMETER(1, 1.5f);
+    h._serialTask.handle_SET_PARAMETER(2, 0.5f);
+
+    worst = sweep(receiver, 0.3f, 1.5f, 0.5f);
+
+    hftest::check(worst < 1e-6f, "after SET_PARAMETER: demands follow the new expo and rate (max difference %.1e)", worst);
+
+    return hftest::report("stickcurve_test");
+}
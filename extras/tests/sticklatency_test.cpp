@@ -0,0 +1,192 @@
+/*
+   Stick-to-angular-velocity latency, with and without feed-forward
+
+   A roll axis with a 25 msec motor lag and a gyro one iteration late runs
+   under RatePid at 300 Hz, with the stick arriving in 11 msec frames as
+   from a DSMX receiver and held in between.  Gains are the ones the
+   autotuner finds for this model.  For a 0.5 rad/sec step we measure the
+   time from the stick move to 50% and 90% of the target rate, and for a
+   2 Hz stick sine the lag by cross-correlation.  Feed-forward must cut
+   all three without much overshoot, and with Kf at zero the controller
+   must behave exactly as it did before feed-forward existed.
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include <math.h>
+
+#include "testing.hpp"
+
+#define protected public
+#include "hackflight.hpp"
+#include "pidcontrollers/rate.hpp"
+#undef protected
+
+void hf::Board::outbuf(char * buf)
+{
+    (void)buf;
+}
+
+static const float DT    = 1 / 300.f;
+static const float FRAME = 0.011f;
+
+static const float STEP_TIME = 0.1f;
+static const float TARGET    = 0.5f;
+static const float SINE_HZ   = 2;
+
+static const uint32_t STEP_ITERATIONS = 300;
+static const uint32_t SINE_ITERATIONS = 3000;
+
+class Response {
+
+    public:
+
+        float t50;  // seconds from the stick step to 50% of the target rate
+        float t90;  // ... and to 90%
+        float peak; // as a fraction of the target
+        float lag;  // seconds behind a 2 Hz stick sine
+
+}; // class Response
+
+// Roll axis under the rate controller; stick(t) is sampled once a frame.  Writes the stick and the rate.
+template <class F> static void simulate(hf::RatePid & rate, F stick, uint32_t n, float * cmd, float * out)
+{
+    float motor = 0, w = 0, gyro = 0;
+    float held = 0, nextFrame = 0;
+
+    for (uint32_t i=0; i<n; ++i) {
+
+        float t = i * DT;
+
+        if (t >= nextFrame) {
+            held = stick(t);
+            nextFrame += FRAME;
+        }
+
+        hf::state_t state = {};
+        state.angularVel[0] = gyro;
+
+        hf::demands_t demands = {};
+        demands.roll = held;
+
+        rate.updateReceiver(false);
+        rate.modifyDemands(&state, demands);
+
+        gyro = w;
+        motor += (demands.roll - motor) * DT / 0.025f;
+        w += (40 * motor - w) * DT;
+
+        cmd[i] = stick(t);
+        out[i] = w;
+    }
+}
+
+static Response measure(hf::RatePid & rate, hf::RatePid & rate2)
+{
+    static float cmd[SINE_ITERATIONS], out[SINE_ITERATIONS];
+
+    Response r = {INFINITY, INFINITY, 0, 0};
+
+    simulate(rate, [](float t) { return t >= STEP_TIME ? TARGET : 0; }, STEP_ITERATIONS, cmd, out);
+
+    for (uint32_t i=0; i<STEP_ITERATIONS; ++i) {
+        float t = i * DT - STEP_TIME;
+        if (out[i] > 0.5f * TARGET && isinf(r.t50)) r.t50 = t;
+        if (out[i] > 0.9f * TARGET && isinf(r.t90)) r.t90 = t;
+        if (out[i] / TARGET > r.peak) r.peak = out[i] / TARGET;
+    }
+
+    simulate(rate2, [](float t) { return TARGET * sinf(2 * (float)M_PI * SINE_HZ * t); }, SINE_ITERATIONS, cmd, out);
+
+    // Skip the first two seconds while the integral settles
+    float best = -INFINITY;
+    for (uint32_t lag=0; lag<60; ++lag) {
+        float sum = 0;
+        for (uint32_t i=600; i<SINE_ITERATIONS-60; ++i) {
+            sum += cmd[i] * out[i+lag];
+        }
+        if (sum > best) {
+            best = sum;
+            r.lag = lag * DT;
+        }
+    }
+
+    return r;
+}
+
+static const float GAINS[5] = {0.587f, 0.0044f, 1.87f, 0.66f, 0.0015f};
+
+static Response measure(float Kf, float smoothing)
+{
+    hf::RatePid rate(GAINS[0], GAINS[1], GAINS[2], GAINS[3], GAINS[4]);
+    hf::RatePid rate2(GAINS[0], GAINS[1], GAINS[2], GAINS[3], GAINS[4]);
+
+    if (Kf > 0) {
+        rate.setFeedForward(0, Kf, smoothing);
+        rate2.setFeedForward(0, Kf, smoothing);
+    }
+
+    return measure(rate, rate2);
+}
+
+static void print(const char * name, const Response & r)
+{
+    printf("  %-24s step 50%% %5.1f ms, 90%% %5.1f ms, peak %.2f; %g Hz lag %4.1f ms\n",
+            name, 1000*r.t50, 1000*r.t90, r.peak, SINE_HZ, 1000*r.lag);
+}
+
+int main(void)
+{
+    printf("sticklatency_test: stick to angular velocity, with and without feed-forward\n");
+
+    Response before = measure(0, 1);
+    Response half   = measure(3.75f, 1);
+    Response full   = measure(7.5f, 0.3f);
+
+    print("feedback only", before);
+    print("Kf 3.75", half);
+    print("Kf 7.5, smoothing 0.3", full);
+
+    hftest::check(half.t50 < before.t50 && half.t90 < 0.5f * before.t90 && half.lag < 0.7f * before.lag,
+            "Kf 3.75 cuts step latency and sine lag");
+
+    hftest::check(half.peak < 1.1f, "Kf 3.75 overshoots the step by under 10%% (%.0f%%)", 100*(half.peak-1));
+
+    // ... at the cost of nearly 20% overshoot, which is why Kf 3.75 is the suggested starting point
+    hftest::check(full.lag < half.lag && full.t90 <= half.t90, "smoothed Kf 7.5 cuts them further");
+
+    // The original Pid::compute, without feed-forward or setpoint weights
+    hf::Pid pid;
+    pid.init(GAINS[0], GAINS[1], GAINS[2]);
+    float lastError = 0, errorI = 0, d1 = 0, d2 = 0;
+    float maxDiff = 0;
+    for (uint32_t i=0; i<1000; ++i) {
+        float target = (i / 4) % 7 * 0.1f - 0.3f;
+        float actual = sinf(i * 0.05f);
+        float error = target - actual;
+        errorI = hf::Filter::constrainAbs(errorI + error, 0.4f);
+        float delta = error - lastError;
+        float expected = error * GAINS[0] + errorI * GAINS[1] + (d1 + d2 + delta) * GAINS[2];
+        d2 = d1;
+        d1 = delta;
+        lastError = error;
+        float diff = fabsf(pid.compute(target, actual) - expected);
+        if (diff > maxDiff) maxDiff = diff;
+    }
+    hftest::check(maxDiff < 1e-6f, "with the defaults, Pid matches the controller without feed-forward (max difference %.1e)", maxDiff);
+
+    return hftest::report("sticklatency_test");
+}
@@ -0,0 +1,75 @@
+/*
+   Just enough of the Arduino API to build the flight code on the host
+
+   millis() and micros() come from the host clock.
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <stdarg.h>
+#include <time.h>
+
+#define OUTPUT 1
+#define INPUT  0
+#define HIGH   1
+#define LOW    0
+
+#define SERIAL_8N1 0x06
+
+inline unsigned long micros(void)
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)(ts.tv_sec * 1000000UL + ts.tv_nsec / 1000);
+}
+
+inline unsigned long millis(void)
+{
+    return micros() / 1000;
+}
+
+inline void delay(uint32_t) { }
+inline void delayMicroseconds(uint32_t) { }
+inline void pinMode(int, int) { }
+inline void digitalWrite(int, int) { }
+inline void analogWrite(int, int) { }
+inline void analogWriteFrequency(int, int) { }
+
+inline float radians(float d)
+{
+    return d * 3.14159265f / 180;
+}
+
+struct HardwareSerial {
+
+    void begin(uint32_t) { }
+    void begin(uint32_t, uint32_t) { }
+    int available(void) { return 0; }
+    int read(void) { return -1; }
+    void write(uint8_t) { }
+    void write(const char *, int) { }
+    void print(const char *) { }
+    void println(const char *) { }
+};
+
+static HardwareSerial Serial __attribute__((unused));
+static HardwareSerial Serial1 __attribute__((unused));
+static HardwareSerial Serial2 __attribute__((unused));
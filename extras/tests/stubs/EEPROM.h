@@ -0,0 +1,33 @@
+/*
+   Host stand-in for the Arduino EEPROM library: 4 KB of RAM
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+struct EEPROMClass {
+
+    uint8_t mem[4096];
+
+    void begin(int) { }
+    uint8_t read(int addr) { return mem[addr]; }
+    void write(int addr, uint8_t value) { mem[addr] = value; }
+    bool commit(void) { return true; }
+};
+
+static EEPROMClass EEPROM __attribute__((unused));
@@ -0,0 +1,130 @@
+/*
+   Stand-in for the ESP8266 WiFi library on Linux: the access point is a
+   no-op, and the TCP server and client are POSIX sockets on the loopback
+   interface.  Enough for ESP8266_Receiver and UDP_Receiver to run on the
+   host against the GCS's Python comms; see udp_vehicle.cpp.
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#define WIFI_AP 2
+
+class IPAddress {
+
+    public:
+
+        uint32_t addr = 0;
+
+}; // class IPAddress
+
+class WiFiClass {
+
+    public:
+
+        void mode(int mode) { (void)mode; }
+
+        void softAP(const char * ssid, const char * passwd=NULL, int channel=0, int hidden=0)
+        {
+            (void)ssid;
+            (void)passwd;
+            (void)channel;
+            (void)hidden;
+        }
+
+}; // class WiFiClass
+
+static WiFiClass WiFi;
+
+class WiFiClient {
+
+    public:
+
+        int fd = -1;
+
+        operator bool() const
+        {
+            return fd >= 0;
+        }
+
+        bool connected(void)
+        {
+            char c;
+            return recv(fd, &c, 1, MSG_PEEK|MSG_DONTWAIT) != 0;
+        }
+
+        int available(void)
+        {
+            char buf[256];
+            int n = recv(fd, buf, sizeof(buf), MSG_PEEK|MSG_DONTWAIT);
+            return n > 0 ? n : 0;
+        }
+
+        int read(void)
+        {
+            uint8_t c;
+            return recv(fd, &c, 1, 0) == 1 ? c : -1;
+        }
+
+}; // class WiFiClient
+
+class WiFiServer {
+
+    private:
+
+        int _port;
+        int _fd = -1;
+
+    public:
+
+        WiFiServer(int port)
+        {
+            _port = port;
+        }
+
+        void begin(void)
+        {
+            _fd = socket(AF_INET, SOCK_STREAM, 0);
+            int one = 1;
+            setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+            sockaddr_in address = {};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(_port);
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+            bind(_fd, (sockaddr *)&address, sizeof(address));
+            listen(_fd, 1);
+            fcntl(_fd, F_SETFL, O_NONBLOCK);
+        }
+
+        WiFiClient available(void)
+        {
+            WiFiClient client;
+            client.fd = accept(_fd, NULL, NULL);
+            return client;
+        }
+
+}; // class WiFiServer
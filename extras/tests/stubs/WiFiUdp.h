@@ -0,0 +1,162 @@
+/*
+   Stand-in for WiFiUDP on Linux, as a POSIX datagram socket on the
+   loopback interface.  Loopback never loses or reorders anything, so
+   received datagrams can be made to: UDP_LOSS percent of them are
+   dropped, and UDP_REORDER percent are held back 15 msec, behind newer
+   ones (both environment variables, default zero).
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <time.h>
+#include <deque>
+#include <vector>
+
+#include "ESP8266WiFi.h"
+
+class WiFiUDP {
+
+    private:
+
+        static constexpr double REORDER_DELAY = 0.015;
+
+        int _fd = -1;
+
+        sockaddr_in _remote = {};
+        sockaddr_in _destination = {};
+
+        std::vector<uint8_t> _in;
+        std::vector<uint8_t> _out;
+        size_t _position = 0;
+
+        // Datagrams held back, with when to let them through
+        std::deque<std::pair<std::vector<uint8_t>, double>> _held;
+
+        int _loss = 0;
+        int _reorder = 0;
+
+        static double now(void)
+        {
+            timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return ts.tv_sec + ts.tv_nsec * 1e-9;
+        }
+
+    public:
+
+        void begin(uint16_t port)
+        {
+            _fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+            sockaddr_in address = {};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(port);
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+            bind(_fd, (sockaddr *)&address, sizeof(address));
+            fcntl(_fd, F_SETFL, O_NONBLOCK);
+
+            if (getenv("UDP_LOSS")) _loss = atoi(getenv("UDP_LOSS"));
+            if (getenv("UDP_REORDER")) _reorder = atoi(getenv("UDP_REORDER"));
+        }
+
+        int parsePacket(void)
+        {
+            if (!_held.empty() && now() > _held.front().second) {
+                _in = _held.front().first;
+                _held.pop_front();
+                _position = 0;
+                return _in.size();
+            }
+
+            while (true) {
+
+                uint8_t buf[512];
+                sockaddr_in from;
+                socklen_t length = sizeof(from);
+
+                int n = recvfrom(_fd, buf, sizeof(buf), 0, (sockaddr *)&from, &length);
+
+                if (n <= 0) return 0;
+
+                if (rand() % 100 < _loss) continue;
+
+                std::vector<uint8_t> datagram(buf, buf + n);
+
+                if (rand() % 100 < _reorder) {
+                    _held.push_back(std::make_pair(datagram, now() + REORDER_DELAY));
+                    continue;
+                }
+
+                _in = datagram;
+                _remote = from;
+                _position = 0;
+
+                return n;
+            }
+        }
+
+        int read(uint8_t * buf, size_t length)
+        {
+            size_t n = _in.size() - _position < length ? _in.size() - _position : length;
+            memcpy(buf, &_in[_position], n);
+            _position += n;
+            return n;
+        }
+
+        IPAddress remoteIP(void)
+        {
+            IPAddress ip;
+            ip.addr = _remote.sin_addr.s_addr;
+            return ip;
+        }
+
+        uint16_t remotePort(void)
+        {
+            return ntohs(_remote.sin_port);
+        }
+
+        int beginPacket(IPAddress ip, uint16_t port)
+        {
+            _destination = {};
+            _destination.sin_family = AF_INET;
+            _destination.sin_addr.s_addr = ip.addr;
+            _destination.sin_port = htons(port);
+            _out.clear();
+            return 1;
+        }
+
+        size_t write(uint8_t c)
+        {
+            _out.push_back(c);
+            return 1;
+        }
+
+        size_t write(const uint8_t * bytes, size_t count)
+        {
+            for (size_t k=0; k<count; ++k) {
+                _out.push_back(bytes[k]);
+            }
+            return count;
+        }
+
+        int endPacket(void)
+        {
+            return sendto(_fd, _out.data(), _out.size(), 0, (sockaddr *)&_destination, sizeof(_destination)) > 0;
+        }
+
+}; // class WiFiUDP
@@ -0,0 +1,67 @@
+/*
+   Minimal support for the host tests: pass/fail checks and timing
+
+   Each test is a plain program that prints what it measured, checks it
+   against a bound with check(), and returns report() from main(), so
+   that make stops at the first failure.
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <chrono>
+
+namespace hftest {
+
+    static int _checks = 0;
+    static int _failures = 0;
+
+    static void check(bool ok, const char * fmt, ...)
+    {
+        va_list ap;
+        va_start(ap, fmt);
+        printf("  [%s] ", ok ? " OK " : "FAIL");
+        vprintf(fmt, ap);
+        printf("\n");
+        va_end(ap);
+
+        ++_checks;
+        if (!ok) ++_failures;
+    }
+
+    static int report(const char * name)
+    {
+        printf("%s: %d/%d checks passed\n", name, _checks-_failures, _checks);
+
+        return _failures ? 1 : 0;
+    }
+
+    // Wall-clock time per call of fn, in nanoseconds
+    template <class F>
+    static double nsPerCall(F fn, uint32_t calls)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for (uint32_t k=0; k<calls; ++k) {
+            fn(k);
+        }
+
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / calls;
+    }
+
+} // namespace hftest
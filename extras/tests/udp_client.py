@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+'''
+GCS side of the loopback stand-in in udp_vehicle.cpp
+
+Sends stick frames at 100 Hz for the given number of seconds, through the
+GCS's UdpComms (or, with "tcp", a plain TCP socket to ESP8266_Receiver),
+with the send time in channels 5 and 6 and the frame count in roll.  Over
+UDP it also polls attitude the way the GCS does, chaining each request off
+the last reply, and reports the round-trip times.  Before starting, it
+sends the telemetry port a message cut short and a motor command, which the
+vehicle doesn't handle over WiFi; neither may cost a stick frame or an
+attitude reply.
+
+    ./udp_vehicle udp 10 &  python3 udp_client.py udp 10
+
+This file is part of Hackflight.
+
+Hackflight is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+This code is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this code.  If not, see <http:#www.gnu.org/licenses/>.
+'''
+
+import math
+import os
+import socket
+import sys
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.join(HERE, '..', 'gcs', 'python'))
+sys.path.insert(0, os.path.join(HERE, '..', 'parser', 'output', 'python'))
+
+import msppg
+import udpcomms
+
+FRAME_SEC = 0.01
+
+class Gcs(msppg.Parser):
+
+    def __init__(self):
+
+        msppg.Parser.__init__(self)
+
+        self.comms = None
+        self.sent = None
+        self.rtts = []
+
+    def request(self):
+
+        self.sent = time.monotonic()
+        self.comms.send_request(msppg.serialize_ATTITUDE_RADIANS_Request())
+
+    def handle_ATTITUDE_RADIANS(self, roll, pitch, yaw):
+
+        if self.sent is not None:
+            self.rtts.append((time.monotonic() - self.sent) * 1000)
+
+        self.request()
+
+def stamp():
+
+    t = time.monotonic()
+
+    return float(math.floor(t)), t - math.floor(t)
+
+def main():
+
+    mode = sys.argv[1] if len(sys.argv) > 1 else 'udp'
+    duration = float(sys.argv[2]) if len(sys.argv) > 2 else 10
+
+    gcs = None
+
+    if mode == 'udp':
+
+        gcs = Gcs()
+        comms = udpcomms.UdpComms(gcs, host='127.0.0.1')
+        gcs.comms = comms
+        comms.start()
+
+        # Half a request, then a message that only the USB serial link handles
+        comms._send_telemetry(msppg.serialize_ATTITUDE_RADIANS_Request()[:3])
+        comms._send_telemetry(msppg.serialize_SET_MOTOR_NORMAL(0, 0, 0, 0))
+
+        gcs.request()
+
+        send = comms.send_rc
+
+    else:
+
+        # Nagle left on, as in the GCS and the Android app
+        sock = socket.create_connection(('127.0.0.1', 80))
+        send = lambda *c: sock.send(msppg.serialize_SET_RC_NORMAL(*c))
+
+    count = 0
+    start = time.monotonic()
+
+    while time.monotonic() - start < duration:
+        whole, fraction = stamp()
+        send(0, count/1e4, 0, 0, whole, fraction)
+        count += 1
+        time.sleep(FRAME_SEC - (time.monotonic() - start) % FRAME_SEC)
+
+    # Tell the vehicle we're done, a few times in case one is lost
+    for k in range(5):
+        try:
+            whole, fraction = stamp()
+            send(-2, 0, 0, 0, whole, fraction)
+            time.sleep(FRAME_SEC)
+        except OSError:
+            break
+
+    report = '%s client: %d frames sent' % (mode.upper(), count)
+
+    if gcs is not None:
+        rtts = sorted(gcs.rtts)
+        n = len(rtts)
+        if n > 0:
+            report += ', %d attitude replies, round trip ms p50 %.3f p99 %.3f max %.3f' % (n, rtts[n//2], rtts[int(n*.99)], rtts[-1])
+        else:
+            report += ', no attitude replies'
+
+    print(report)
+
+main()
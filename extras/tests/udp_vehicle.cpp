@@ -0,0 +1,143 @@
+/*
+   Loopback stand-in for a WiFi vehicle, for measuring stick latency
+
+   Runs UDP_Receiver (or, with "tcp", the older ESP8266_Receiver) on the
+   host over the socket stand-ins in stubs, polling it at about 5 kHz like
+   a flight loop, and answers udp_client.py, which drives it through the
+   GCS's own UdpComms.  The client puts its send time in channels 5 and 6
+   of every stick frame, and a throttle of -2 when it's done; we print the
+   latency of the frames we used, how many we used, whether any older
+   frame was used after a newer one, and how many the receiver dropped as
+   stale.  To try a bad link, set UDP_LOSS and UDP_REORDER (see
+   stubs/WiFiUdp.h).
+
+     ./udp_vehicle udp 10 &  python3 udp_client.py udp 10
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+
+#define private public
+#define protected public
+#include "receivers/arduino/udp.hpp"
+#include "receivers/arduino/esp8266.hpp"
+#undef protected
+#undef private
+
+void hf::Board::outbuf(char * buf)
+{
+    (void)buf;
+}
+
+static const uint8_t CHANNEL_MAP[6] = {0, 1, 2, 3, 4, 5};
+
+static double now(void)
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+class TcpReceiver : public hf::ESP8266_Receiver {
+
+    public:
+
+        TcpReceiver(void)
+            : hf::ESP8266_Receiver(CHANNEL_MAP, 1, "hackflight")
+        {
+        }
+
+        void pause(void)
+        {
+        }
+
+        void resume(void)
+        {
+        }
+
+}; // class TcpReceiver
+
+int main(int argc, char ** argv)
+{
+    bool tcp = argc > 1 && !strcmp(argv[1], "tcp");
+    double duration = argc > 2 ? atof(argv[2]) : 10;
+
+    hf::UDP_Receiver udp(CHANNEL_MAP, 1, "hackflight");
+    TcpReceiver tcpReceiver;
+
+    hf::Receiver * receiver = tcp ? (hf::Receiver *)&tcpReceiver : (hf::Receiver *)&udp;
+
+    // Level, so that attitude requests have something to report
+    hf::state_t state = {};
+    hf::Attitude::setQuaternion(state, 1, 0, 0, 0);
+    receiver->_vehicleState = &state;
+
+    receiver->begin();
+
+    std::vector<double> latencies;
+    uint32_t outOfOrder = 0;
+    float lastStamp = -1;
+
+    double start = now();
+
+    while (now() - start < duration + 5) {
+
+        if (receiver->gotNewFrame()) {
+
+            receiver->readRawvals();
+
+            // Client is done
+            if (receiver->rawvals[0] < -1.5f) break;
+
+            // Whole and fractional seconds, to keep float precision
+            double sent = (double)receiver->rawvals[4] + (double)receiver->rawvals[5];
+            latencies.push_back((now() - sent) * 1000);
+
+            // Roll carries the client's frame count
+            if (receiver->rawvals[1] < lastStamp) {
+                ++outOfOrder;
+            }
+            lastStamp = receiver->rawvals[1];
+        }
+
+        usleep(200);
+    }
+
+    size_t n = latencies.size();
+
+    if (n == 0) {
+        printf("no frames\n");
+        return 1;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+
+    double mean = 0;
+    for (double l : latencies) mean += l;
+    mean /= n;
+
+    printf("%s vehicle: %zu frames used, latency ms mean %.3f p50 %.3f p99 %.3f max %.3f, "
+            "out-of-order used %u, dropped as stale %u\n",
+            tcp ? "TCP" : "UDP", n, mean, latencies[n/2], latencies[(size_t)(n*0.99)], latencies[n-1],
+            outOfOrder, tcp ? 0 : udp.getDroppedFrames());
+
+    return 0;
+}
@@ -0,0 +1,180 @@
+/*
+   Arming logic
+
+   Rather than re-checking every arming condition on every receiver frame,
+   we keep a set of flags for whatever is blocking arming, and change them
+   only when a condition changes: the arming switch flipping, the throttle
+   going up or down, the vehicle tilting past the arming limit or back, or
+   the failsafe tripping.  The vehicle arms when the switch is on and
+   nothing is blocking; the flags go to the GCS, so a vehicle that won't
+   arm can say why.  Arming from the GCS needs the same, switch included.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <math.h>
+
+#include "datatypes.hpp"
+
+namespace hf {
+
+    // Reasons the vehicle can't arm, as reported over MSP
+    enum {
+        ARMING_BLOCKED_RECEIVER = 0x01, // no receiver frame yet
+        ARMING_BLOCKED_SWITCH   = 0x02, // arming switch hasn't been off since startup
+        ARMING_BLOCKED_THROTTLE = 0x04, // throttle isn't down
+        ARMING_BLOCKED_ANGLE    = 0x08, // tilted past the arming limit
+        ARMING_BLOCKED_FAILSAFE = 0x10  // failsafe tripped; reboot to clear
+    };
+
+    class Arming {
+
+        friend class Hackflight;
+        friend class SerialTask;
+
+        private:
+
+            // Roll and pitch limit for arming, in radians
+            static constexpr float MAX_ANGLE = 25 * M_PI / 180;
+
+            state_t * _state = NULL;
+
+            uint8_t _blocks = ARMING_BLOCKED_RECEIVER | ARMING_BLOCKED_SWITCH | ARMING_BLOCKED_THROTTLE;
+
+            bool _gotFrame = false;
+            bool _switchOn = false;
+            bool _throttleDown = false;
+            bool _level = true;
+
+            void init(state_t * state)
+            {
+                _state = state;
+            }
+
+            void setBlocked(uint8_t flag, bool blocked)
+            {
+                _blocks = blocked ? _blocks | flag : _blocks & ~flag;
+            }
+
+            void checkArm(void)
+            {
+                if (_switchOn && !_blocks) {
+                    _state->armed = true;
+                }
+            }
+
+            // Events -------------------------------------------------------------------------
+
+            void switchChanged(bool on)
+            {
+                _switchOn = on;
+
+                if (on) {
+                    checkArm();
+                }
+                else {
+                    _state->armed = false;
+                    setBlocked(ARMING_BLOCKED_SWITCH, false);
+                }
+            }
+
+            void throttleChanged(bool down)
+            {
+                _throttleDown = down;
+
+                setBlocked(ARMING_BLOCKED_THROTTLE, !down);
+
+                checkArm();
+            }
+
+            void levelChanged(bool level)
+            {
+                _level = level;
+
+                setBlocked(ARMING_BLOCKED_ANGLE, !level);
+
+                checkArm();
+            }
+
+            void failsafe(void)
+            {
+                _state->armed = false;
+
+                setBlocked(ARMING_BLOCKED_FAILSAFE, true);
+            }
+
+            // Called on each receiver frame; does nothing unless something changed
+            void update(bool switchOn, bool throttleDown)
+            {
+                // The first frame tells us where things start; a switch that starts on has to go off first
+                if (!_gotFrame) {
+                    _gotFrame = true;
+                    _switchOn = switchOn;
+                    _throttleDown = throttleDown;
+                    setBlocked(ARMING_BLOCKED_RECEIVER, false);
+                    setBlocked(ARMING_BLOCKED_SWITCH, switchOn);
+                    setBlocked(ARMING_BLOCKED_THROTTLE, !throttleDown);
+                    return;
+                }
+
+                if (switchOn != _switchOn) {
+                    switchChanged(switchOn);
+                }
+
+                if (throttleDown != _throttleDown) {
+                    throttleChanged(throttleDown);
+                }
+            }
+
+            // Only matters while disarmed
+            void updateAngles(const float * euler)
+            {
+                bool level = fabsf(euler[AXIS_ROLL]) < MAX_ANGLE && fabsf(euler[AXIS_PITCH]) < MAX_ANGLE;
+
+                if (level != _level) {
+                    levelChanged(level);
+                }
+            }
+
+            // From the GCS.  The receiver's arming switch has the last word: the GCS
+            // can disarm at any time, but can arm only when the switch could, i.e.
+            // with a receiver bound, its switch on and nothing blocking.  So all
+            // it can do is re-arm after disarming the vehicle itself, and turning
+            // the switch off disarms whatever armed it.
+            void request(bool arm)
+            {
+                if (arm) {
+                    checkArm();
+                }
+                else {
+                    _state->armed = false;
+                }
+            }
+
+        public:
+
+            // ARMING_BLOCKED_ flags
+            uint8_t getBlocks(void)
+            {
+                return _blocks;
+            }
+
+    };  // class Arming
+
+} // namespace hf
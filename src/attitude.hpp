@@ -0,0 +1,92 @@
+/*
+   Attitude representation helpers
+
+   The quaternion is the primary attitude in the vehicle state, with the
+   rotation matrix kept in step with it.  Euler angles are only computed when
+   someone asks for them, and are then memoized until the quaternion changes.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <math.h>
+
+#include "datatypes.hpp"
+#include "fastmath.hpp"
+
+namespace hf {
+
+    class Attitude {
+
+        public:
+
+            // Multiplies only; no trig
+            static void setQuaternion(state_t & state, float qw, float qx, float qy, float qz)
+            {
+                state.quaternion[0] = qw;
+                state.quaternion[1] = qx;
+                state.quaternion[2] = qy;
+                state.quaternion[3] = qz;
+
+                float (*R)[3] = state.rotationMatrix;
+
+                R[0][0] = 1 - 2*(qy*qy + qz*qz);
+                R[0][1] = 2*(qx*qy - qw*qz);
+                R[0][2] = 2*(qx*qz + qw*qy);
+
+                R[1][0] = 2*(qx*qy + qw*qz);
+                R[1][1] = 1 - 2*(qx*qx + qz*qz);
+                R[1][2] = 2*(qy*qz - qw*qx);
+
+                R[2][0] = 2*(qx*qz - qw*qy);
+                R[2][1] = 2*(qy*qz + qw*qx);
+                R[2][2] = 1 - 2*(qx*qx + qy*qy);
+
+                state.eulerValid = false;
+            }
+
+            // Roll, pitch, yaw in radians, following the conventions in imu.hpp
+            static void computeEulerAngles(float qw, float qx, float qy, float qz, float euler[3])
+            {
+                euler[0] = FastMath::atan2(2.0f*(qw*qx+qy*qz), qw*qw-qx*qx-qy*qy+qz*qz);
+                euler[1] = FastMath::asin(2.0f*(qx*qz-qw*qy));
+                euler[2] = FastMath::atan2(2.0f*(qx*qy+qw*qz), qw*qw+qx*qx-qy*qy-qz*qz);
+            }
+
+            // Heading is in [0,2*pi]
+            static const float * getEulerAngles(state_t & state)
+            {
+                if (!state.eulerValid) {
+
+                    const float * q = state.quaternion;
+
+                    computeEulerAngles(q[0], q[1], q[2], q[3], state.eulerAngles);
+
+                    if (state.eulerAngles[2] < 0) {
+                        state.eulerAngles[2] += 2*M_PI;
+                    }
+
+                    state.eulerValid = true;
+                }
+
+                return state.eulerAngles;
+            }
+
+    };  // class Attitude
+
+} // namespace hf
@@ -23,6 +23,10 @@
 #include <stdarg.h>
 #include <stdint.h>
 
+#ifdef __linux__
+#include <stdio.h>
+#endif
+
 namespace hf {
 
     class Board {
@@ -32,6 +36,8 @@ namespace hf {
         friend class TimerTask;
         friend class SerialTask;
         friend class PidTask;
+        friend class EstimatorTask;
+        friend class Storage;
 
         protected:
 
@@ -43,6 +49,31 @@ namespace hf {
             virtual uint8_t serialReadByte(void)  { return 1; }
             virtual void    serialWriteByte(uint8_t c) { (void)c; }
 
+            //--------------------------------------- Non-volatile storage ---------------------------------------------
+#ifdef __linux__
+            // Simulators and other Linux builds keep their storage in a file in the working directory
+            virtual bool storageRead(uint16_t address, uint8_t * data, uint16_t size)
+            {
+                FILE * fp = fopen("hackflight.eeprom", "rb");
+                if (!fp) return false;
+                bool ok = fseek(fp, address, SEEK_SET) == 0 && fread(data, 1, size, fp) == size;
+                fclose(fp);
+                return ok;
+            }
+
+            virtual bool storageWrite(uint16_t address, const uint8_t * data, uint16_t size)
+            {
+                FILE * fp = fopen("hackflight.eeprom", "r+b");
+                if (!fp) fp = fopen("hackflight.eeprom", "w+b");
+                if (!fp) return false;
+                bool ok = fseek(fp, address, SEEK_SET) == 0 && fwrite(data, 1, size, fp) == size;
+                return fclose(fp) == 0 && ok;
+            }
+#else
+            virtual bool storageRead(uint16_t address, uint8_t * data, uint16_t size) { (void)address; (void)data; (void)size; return false; }
+            virtual bool storageWrite(uint16_t address, const uint8_t * data, uint16_t size) { (void)address; (void)data; (void)size; return false; }
+#endif
+
             //----------------------------------------- Safety -----------------------------------------------------------
             virtual void showArmedStatus(bool armed) { (void)armed; }
             virtual void flashLed(bool shouldflash) { (void)shouldflash; }
@@ -0,0 +1,80 @@
+/*
+   Superclass for Arduino-based flight controllers whose core provides
+   EEPROM.h, keeping calibration and parameters there
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#pragma once
+
+#include <EEPROM.h>
+
+#include "boards/realboards/arduino.hpp"
+
+namespace hf {
+
+    class EepromBoard : public ArduinoBoard {
+
+        private:
+
+            // Bytes of EEPROM (or emulated EEPROM) we use
+            static const uint16_t STORAGE_SIZE = 512;
+
+        protected:
+
+            virtual bool storageRead(uint16_t address, uint8_t * data, uint16_t size) override
+            {
+                if (address + size > STORAGE_SIZE) return false;
+
+                for (uint16_t k=0; k<size; ++k) {
+                    data[k] = EEPROM.read(address + k);
+                }
+
+                return true;
+            }
+
+            virtual bool storageWrite(uint16_t address, const uint8_t * data, uint16_t size) override
+            {
+                if (address + size > STORAGE_SIZE) return false;
+
+                // Skip unchanged bytes to save EEPROM wear
+                for (uint16_t k=0; k<size; ++k) {
+                    if (EEPROM.read(address + k) != data[k]) {
+                        EEPROM.write(address + k, data[k]);
+                    }
+                }
+
+#if defined(ESP32) || defined(ESP8266)
+                return EEPROM.commit();
+#else
+                return true;
+#endif
+            }
+
+        public:
+
+            EepromBoard(uint8_t ledPin, bool ledInverted=false)
+                : ArduinoBoard(ledPin, ledInverted)
+            {
+#if defined(ESP32) || defined(ESP8266)
+                EEPROM.begin(STORAGE_SIZE);
+#endif
+            }
+
+    }; // class EepromBoard
+
+} // namespace hf
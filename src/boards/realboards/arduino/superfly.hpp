@@ -23,7 +23,7 @@
 #pragma once
 
 #include <Wire.h>
-#include "boards/realboards/arduino.hpp"
+#include "boards/realboards/arduino/eeprom.hpp"
 #include "imus/usfs.hpp"
 
 namespace hf {
@@ -60,12 +60,12 @@ namespace hf {
 
     SuperflyMotor superflyMotors;
 
-    class SuperFly : public ArduinoBoard {
+    class SuperFly : public EepromBoard {
 
         public:
 
             SuperFly(void) 
-                : ArduinoBoard(15)
+                : EepromBoard(15)
             {
                 // Start I^2C
                 Wire.begin(0,2); // SDA (0), SCL (2) on ESP8266
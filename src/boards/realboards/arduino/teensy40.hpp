@@ -21,16 +21,16 @@
 #pragma once
 
 #include <Wire.h>
-#include "boards/realboards/arduino.hpp"
+#include "boards/realboards/arduino/eeprom.hpp"
 
 namespace hf {
 
-    class Teensy40 : public ArduinoBoard {
+    class Teensy40 : public EepromBoard {
 
          public:
 
             Teensy40(void) 
-                : ArduinoBoard(13)
+                : EepromBoard(13)
             {
                 // Start I^2C
                 //Wire.begin(TWI_PINS_6_7);
@@ -0,0 +1,407 @@
+/*
+   Background sensor calibration
+
+   While the vehicle is disarmed, gyro bias is re-estimated whenever gyro
+   and accelerometer have both been still for a window of samples (gyro
+   alone on IMUs that don't report raw acceleration), and accelerometer and magnetometer
+   offsets and scales are fit to an axis-aligned ellipsoid by recursive
+   least squares as the vehicle is handled.  Everything is O(1) in memory
+   and time per sample; the least-squares update only runs on samples whose
+   direction differs enough from the previous one to add information.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+#include "board.hpp"
+#include "datatypes.hpp"
+#include "storage.hpp"
+
+namespace hf {
+
+    // Welford's running mean and variance on each axis, over consecutive windows of samples
+    class WindowStatistics {
+
+        private:
+
+            static const uint16_t WINDOW = 100;
+
+            uint16_t _count = 0;
+            float _mean[3] = {};
+            float _m2[3] = {};
+
+        public:
+
+            // Returns true when v completes a window, whose statistics then hold until the next update
+            bool update(const float v[3])
+            {
+                if (_count == WINDOW) {
+                    _count = 0;
+                    for (uint8_t k=0; k<3; ++k) {
+                        _mean[k] = 0;
+                        _m2[k] = 0;
+                    }
+                }
+
+                _count++;
+
+                for (uint8_t k=0; k<3; ++k) {
+                    float delta = v[k] - _mean[k];
+                    _mean[k] += delta / _count;
+                    _m2[k] += delta * (v[k] - _mean[k]);
+                }
+
+                return _count == WINDOW;
+            }
+
+            float mean(uint8_t axis)
+            {
+                return _mean[axis];
+            }
+
+            float variance(uint8_t axis)
+            {
+                return _m2[axis] / (WINDOW - 1);
+            }
+
+            bool varianceBelow(float maxVariance)
+            {
+                return variance(0) <= maxVariance && variance(1) <= maxVariance && variance(2) <= maxVariance;
+            }
+
+    };  // class WindowStatistics
+
+    class GyroBiasCalibrator {
+
+        private:
+
+            // Per-axis variance (rad/sec)^2 and mean rate (rad/sec) below which we consider ourselves still.
+            // A MEMS gyro's bias is well under the rate limit, while a slow steady turn is not.
+            static constexpr float MAX_STILL_VARIANCE = 4e-4f;
+            static constexpr float MAX_BIAS = 0.02f;
+
+            // Weight of each still window after the first
+            static constexpr float BIAS_ALPHA = 0.2f;
+
+            WindowStatistics _window;
+
+            bool _still = false;
+            bool _haveBias = false;
+
+        public:
+
+            // Returns true when a still window has updated the bias; accelStill vetoes windows
+            // in which the vehicle was moving without turning
+            bool update(const float g[3], float bias[3], bool accelStill=true)
+            {
+                if (!_window.update(g)) return false;
+
+                _still = accelStill && _window.varianceBelow(MAX_STILL_VARIANCE);
+                for (uint8_t k=0; k<3; ++k) {
+                    if (fabsf(_window.mean(k)) > MAX_BIAS) {
+                        _still = false;
+                    }
+                }
+
+                if (_still) {
+                    float alpha = _haveBias ? BIAS_ALPHA : 1;
+                    for (uint8_t k=0; k<3; ++k) {
+                        bias[k] += alpha * (_window.mean(k) - bias[k]);
+                    }
+                    _haveBias = true;
+                }
+
+                return _still;
+            }
+
+            // As of the most recent complete window
+            bool isStill(void)
+            {
+                return _still;
+            }
+
+    };  // class GyroBiasCalibrator
+
+    class EllipsoidCalibrator {
+
+        private:
+
+            // Fits a x^2 + b y^2 + c z^2 + d x + e y + f z = 1
+            static const uint8_t NPARAMS = 6;
+
+            // Accept a sample only if it points at least this far (about 15 degrees) from the previous one
+            static constexpr float MAX_DIRECTION_COS = 0.966f;
+
+            // Don't trust a fit until we've seen this many samples, spread over at least this much
+            // of each axis of the unit sphere
+            static const uint8_t MIN_SAMPLES = 12;
+            static constexpr float MIN_SPREAD = 1.0f;
+
+            static constexpr float INITIAL_COVARIANCE = 1e4f;
+
+            float _theta[NPARAMS] = {};
+            float _P[NPARAMS][NPARAMS] = {};
+
+            // Inputs are divided by the magnitude of the first sample, so the fit is well conditioned
+            // whatever the units
+            float _unit = 0;
+
+            float _lastDirection[3] = {};
+            float _minDirection[3] = {};
+            float _maxDirection[3] = {};
+
+            uint16_t _samples = 0;
+
+        public:
+
+            EllipsoidCalibrator(void)
+            {
+                for (uint8_t i=0; i<NPARAMS; ++i) {
+                    _P[i][i] = INITIAL_COVARIANCE;
+                }
+            }
+
+            // Returns true if the sample was used
+            bool update(const float v[3])
+            {
+                float norm = sqrtf(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+                if (norm == 0) return false;
+
+                float direction[3] = { v[0] / norm, v[1] / norm, v[2] / norm };
+
+                if (_samples > 0) {
+                    float cos = direction[0]*_lastDirection[0] + direction[1]*_lastDirection[1] + direction[2]*_lastDirection[2];
+                    if (cos > MAX_DIRECTION_COS) return false;
+                }
+                else {
+                    _unit = norm;
+                    for (uint8_t k=0; k<3; ++k) {
+                        _minDirection[k] = direction[k];
+                        _maxDirection[k] = direction[k];
+                    }
+                }
+
+                for (uint8_t k=0; k<3; ++k) {
+                    _lastDirection[k] = direction[k];
+                    _minDirection[k] = direction[k] < _minDirection[k] ? direction[k] : _minDirection[k];
+                    _maxDirection[k] = direction[k] > _maxDirection[k] ? direction[k] : _maxDirection[k];
+                }
+
+                float x = v[0] / _unit, y = v[1] / _unit, z = v[2] / _unit;
+                float phi[NPARAMS] = { x*x, y*y, z*z, x, y, z };
+
+                // Recursive least squares with unit target
+                float Pphi[NPARAMS];
+                float denom = 1;
+                float error = 1;
+                for (uint8_t i=0; i<NPARAMS; ++i) {
+                    Pphi[i] = 0;
+                    for (uint8_t j=0; j<NPARAMS; ++j) {
+                        Pphi[i] += _P[i][j] * phi[j];
+                    }
+                    denom += phi[i] * Pphi[i];
+                    error -= phi[i] * _theta[i];
+                }
+
+                for (uint8_t i=0; i<NPARAMS; ++i) {
+                    _theta[i] += Pphi[i] / denom * error;
+                }
+
+                for (uint8_t i=0; i<NPARAMS; ++i) {
+                    for (uint8_t j=i; j<NPARAMS; ++j) {
+                        _P[i][j] -= Pphi[i] * Pphi[j] / denom;
+                        _P[j][i] = _P[i][j];
+                    }
+                }
+
+                _samples++;
+
+                return true;
+            }
+
+            // Offsets are in input units; scales map each axis onto the given radius, or onto the mean
+            // radius if that is zero.  Returns false until the fit is trustworthy.
+            bool fit(float offset[3], float scale[3], float radius)
+            {
+                if (_samples < MIN_SAMPLES) return false;
+
+                for (uint8_t k=0; k<3; ++k) {
+                    if (_maxDirection[k] - _minDirection[k] < MIN_SPREAD) return false;
+                    if (_theta[k] <= 0) return false;
+                }
+
+                float g = 1;
+                for (uint8_t k=0; k<3; ++k) {
+                    g += _theta[k+3] * _theta[k+3] / (4 * _theta[k]);
+                }
+
+                float radii[3];
+                float meanRadius = 0;
+                for (uint8_t k=0; k<3; ++k) {
+                    radii[k] = sqrtf(g / _theta[k]) * _unit;
+                    meanRadius += radii[k] / 3;
+                }
+
+                float target = radius > 0 ? radius : meanRadius;
+
+                for (uint8_t k=0; k<3; ++k) {
+
+                    float o = -_theta[k+3] / (2 * _theta[k]) * _unit;
+
+                    // Reject fits no real sensor would produce
+                    if (radii[k] < target / 2 || radii[k] > target * 2 || fabsf(o) > radii[k]) return false;
+                }
+
+                for (uint8_t k=0; k<3; ++k) {
+                    offset[k] = -_theta[k+3] / (2 * _theta[k]) * _unit;
+                    scale[k] = target / radii[k];
+                }
+
+                return true;
+            }
+
+    };  // class EllipsoidCalibrator
+
+    class Calibration {
+
+        friend class Hackflight;
+        friend class Gyrometer;
+        friend class Accelerometer;
+        friend class Magnetometer;
+
+        private:
+
+            static const uint16_t STORAGE_ADDRESS = 0;
+            static const uint16_t STORAGE_MAGIC   = 0x4643; // "CF"
+            static const uint8_t  STORAGE_VERSION = 1;
+
+            // Per-axis variance (Gs^2) below which the accelerometer is still: about 0.01 G of noise
+            static constexpr float MAX_ACCEL_STILL_VARIANCE = 1e-4f;
+
+            calibration_t _values;
+
+            GyroBiasCalibrator  _gyroCalibrator;
+            EllipsoidCalibrator _accelCalibrator;
+            EllipsoidCalibrator _magCalibrator;
+
+            // Accelerometer stillness, as of its most recent complete window; until we have
+            // one, e.g. on IMUs that don't report raw acceleration, the gyro decides alone
+            WindowStatistics _accelWindow;
+            bool _accelStill = true;
+
+            // Set by Hackflight; we only learn while disarmed
+            bool _armed = false;
+
+            // Something was learned since the last save
+            bool _dirty = false;
+
+            void gyrometer(float & x, float & y, float & z)
+            {
+                if (!_armed) {
+                    float g[3] = {x, y, z};
+                    _dirty |= _gyroCalibrator.update(g, _values.gyroBias, _accelStill);
+                }
+
+                applyGyrometer(_values, x, y, z);
+            }
+
+            void accelerometer(float & x, float & y, float & z)
+            {
+                float a[3] = {x, y, z};
+
+                if (!_armed && _accelWindow.update(a)) {
+                    _accelStill = _accelWindow.varianceBelow(MAX_ACCEL_STILL_VARIANCE);
+                }
+
+                // Only a still vehicle measures gravity alone
+                if (!_armed && _gyroCalibrator.isStill()) {
+                    if (_accelCalibrator.update(a)) {
+                        _dirty |= _accelCalibrator.fit(_values.accelOffset, _values.accelScale, 1);
+                    }
+                }
+
+                applyEllipsoid(_values.accelOffset, _values.accelScale, x, y, z);
+            }
+
+            void magnetometer(float & x, float & y, float & z)
+            {
+                // Motor currents distort the field, so we learn on the ground
+                if (!_armed) {
+                    float m[3] = {x, y, z};
+                    if (_magCalibrator.update(m)) {
+                        _dirty |= _magCalibrator.fit(_values.magOffset, _values.magScale, 0);
+                    }
+                }
+
+                applyEllipsoid(_values.magOffset, _values.magScale, x, y, z);
+            }
+
+            static void applyEllipsoid(const float offset[3], const float scale[3], float & x, float & y, float & z)
+            {
+                x = (x - offset[0]) * scale[0];
+                y = (y - offset[1]) * scale[1];
+                z = (z - offset[2]) * scale[2];
+            }
+
+            void load(Board * board)
+            {
+                Storage::load(board, STORAGE_ADDRESS, STORAGE_MAGIC, STORAGE_VERSION, &_values, sizeof(_values));
+            }
+
+            void save(Board * board)
+            {
+                if (_dirty && Storage::save(board, STORAGE_ADDRESS, STORAGE_MAGIC, STORAGE_VERSION, &_values, sizeof(_values))) {
+                    _dirty = false;
+                }
+            }
+
+        public:
+
+            // Storage after us should start here
+            static constexpr uint16_t STORAGE_END = STORAGE_ADDRESS + Storage::footprint(sizeof(calibration_t));
+
+            Calibration(void)
+            {
+                for (uint8_t k=0; k<3; ++k) {
+                    _values.gyroBias[k] = 0;
+                    _values.accelOffset[k] = 0;
+                    _values.accelScale[k] = 1;
+                    _values.magOffset[k] = 0;
+                    _values.magScale[k] = 1;
+                }
+            }
+
+            // For IMUs that fuse raw readings themselves
+            static void applyGyrometer(const calibration_t & values, float & x, float & y, float & z)
+            {
+                x -= values.gyroBias[0];
+                y -= values.gyroBias[1];
+                z -= values.gyroBias[2];
+            }
+
+            static void applyAccelerometer(const calibration_t & values, float & x, float & y, float & z)
+            {
+                applyEllipsoid(values.accelOffset, values.accelScale, x, y, z);
+            }
+
+    };  // class Calibration
+
+} // namespace hf
@@ -20,6 +20,8 @@
 
 #pragma once
 
+#include <stdint.h>
+
 namespace hf {
 
     enum {
@@ -43,7 +45,16 @@ namespace hf {
         bool failsafe;
 
         float location[3];
-        float rotation[3]; 
+
+        // Primary attitude (w, x, y, z) and the body-to-earth rotation matrix it implies.
+        // Set both with Attitude::setQuaternion().
+        float quaternion[4];
+        float rotationMatrix[3][3];
+
+        // Memoized Euler angles: read them with Attitude::getEulerAngles()
+        float eulerAngles[3];
+        bool  eulerValid;
+
         float angularVel[3]; 
         float bodyAccel[3]; 
         float bodyVel[3]; 
@@ -51,4 +62,74 @@ namespace hf {
 
     } state_t;
 
+    // Kinds of measurement a sensor can hand to the state estimator
+    enum {
+        MEASUREMENT_GYROMETER,     // rad/sec: roll, pitch, yaw
+        MEASUREMENT_ATTITUDE,      // quaternion: w, x, y, z
+        MEASUREMENT_ACCELEROMETER, // Gs: x, y, z
+        MEASUREMENT_MAGNETOMETER,  // microteslas: x, y, z
+        MEASUREMENT_BAROMETER,     // pascals
+        MEASUREMENT_RANGEFINDER,   // meters
+        MEASUREMENT_OPTICALFLOW    // pixel counts x, y; seconds since previous reading
+    };
+
+    typedef struct {
+
+        uint8_t type;
+        float   time;
+        float   values[4];
+
+    } measurement_t;
+
+    // Sensor corrections in the IMU's own frame: corrected = (raw - offset) * scale for accel and mag,
+    // raw - bias for gyro
+    typedef struct {
+
+        float gyroBias[3];      // rad/sec
+        float accelOffset[3];   // Gs
+        float accelScale[3];
+        float magOffset[3];     // microteslas
+        float magScale[3];
+
+    } calibration_t;
+
+    // Tunable parameters, stored in non-volatile memory and settable over MSP
+    typedef struct {
+
+        // Receiver
+        float cyclicExpo;
+        float cyclicRate;
+        float throttleExpo;
+
+        // PID gains, in the order of each controller's constructor arguments
+        float rateGains[5];      // Kp, Ki, Kd, Kp_yaw, Ki_yaw
+        float levelGains[2];     // roll Kp, pitch Kp
+        float altHoldGains[4];   // Kp_pos, Kp_vel, Ki_vel, Kd_vel
+        float flowHoldGains[2];  // Kp, Ki
+
+        // Bit (1 << GAINS_xxx) is set once the GCS or an autotuner has set that controller's gains.
+        // Until then the gains above are just a copy of the ones the sketch passed in, for the GCS to read.
+        uint8_t gcsGains;
+
+    } parameters_t;
+
+    // Which set of gains in parameters_t a PID controller uses
+    enum {
+        GAINS_NONE,
+        GAINS_RATE,
+        GAINS_LEVEL,
+        GAINS_ALTHOLD,
+        GAINS_FLOWHOLD
+    };
+
+    typedef struct {
+
+        uint32_t nanResets;
+        uint32_t divergenceResets;
+
+        float covarianceTrace;
+        float innovationRatio;
+
+    } estimator_health_t;
+
 } // namespace hf
@@ -0,0 +1,157 @@
+/*
+   Abstract class for state estimators
+
+   Each sensor queues its own timestamped measurements; at a fixed rate the
+   estimator predicts the state forward and then merges those queues, fusing
+   the measurements in timestamp order.  The estimator is the only code that
+   writes the estimated parts of the state.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <math.h>
+
+#include "attitude.hpp"
+#include "datatypes.hpp"
+#include "sensor.hpp"
+
+namespace hf {
+
+    class StateEstimator {
+
+        friend class Hackflight;
+        friend class EstimatorTask;
+
+        private:
+
+            static const uint8_t MAX_SENSORS = 16;
+
+            Sensor * _sensors[MAX_SENSORS];
+            uint8_t _sensorCount = 0;
+
+            float _previousTime = 0;
+
+            void addSensor(Sensor * sensor)
+            {
+                if (_sensorCount < MAX_SENSORS) {
+                    _sensors[_sensorCount++] = sensor;
+                }
+            }
+
+            // Returns the sensor whose queued measurement is oldest, or NULL when all queues are empty
+            Sensor * oldestSensor(void)
+            {
+                Sensor * oldest = NULL;
+                float oldestTime = 0;
+
+                for (uint8_t k=0; k<_sensorCount; ++k) {
+                    const measurement_t * m = _sensors[k]->_measurements.peek();
+                    if (m && (!oldest || m->time < oldestTime)) {
+                        oldest = _sensors[k];
+                        oldestTime = m->time;
+                    }
+                }
+
+                return oldest;
+            }
+
+            void fuse(state_t & state, const measurement_t & measurement)
+            {
+                switch (measurement.type) {
+
+                    case MEASUREMENT_GYROMETER:
+                        fuseGyrometer(state, measurement);
+                        break;
+
+                    case MEASUREMENT_ATTITUDE:
+                        fuseAttitude(state, measurement);
+                        break;
+
+                    case MEASUREMENT_ACCELEROMETER:
+                        fuseAccelerometer(state, measurement);
+                        break;
+
+                    case MEASUREMENT_MAGNETOMETER:
+                        fuseMagnetometer(state, measurement);
+                        break;
+
+                    case MEASUREMENT_BAROMETER:
+                        fuseBarometer(state, measurement);
+                        break;
+
+                    case MEASUREMENT_RANGEFINDER:
+                        fuseRangefinder(state, measurement);
+                        break;
+
+                    case MEASUREMENT_OPTICALFLOW:
+                        fuseOpticalFlow(state, measurement);
+                        break;
+                }
+            }
+
+        protected:
+
+            // Time the state has been predicted to; measurements stamped earlier than this arrived late
+            float _time = 0;
+
+            // Runs once per update, before the queued measurements are fused
+            virtual void predict(state_t & state, float dt) { (void)state; (void)dt; }
+
+            // Gyrometer and attitude come from the IMU already fused, so by default we just pass them through
+            virtual void fuseGyrometer(state_t & state, const measurement_t & m)
+            {
+                for (uint8_t k=0; k<3; ++k) {
+                    state.angularVel[k] = m.values[k];
+                }
+            }
+
+            virtual void fuseAttitude(state_t & state, const measurement_t & m)
+            {
+                Attitude::setQuaternion(state, m.values[0], m.values[1], m.values[2], m.values[3]);
+            }
+
+            // The other sensors are used by estimator subclasses as they see fit
+            virtual void fuseAccelerometer(state_t & state, const measurement_t & m) { (void)state; (void)m; }
+            virtual void fuseMagnetometer(state_t & state, const measurement_t & m) { (void)state; (void)m; }
+            virtual void fuseBarometer(state_t & state, const measurement_t & m) { (void)state; (void)m; }
+            virtual void fuseRangefinder(state_t & state, const measurement_t & m) { (void)state; (void)m; }
+            virtual void fuseOpticalFlow(state_t & state, const measurement_t & m) { (void)state; (void)m; }
+
+            // Override this if your estimator can report its health over MSP
+            virtual const estimator_health_t * getHealth(void) { return NULL; }
+
+            void update(state_t & state, float time)
+            {
+                float dt = _previousTime > 0 ? time - _previousTime : 0;
+                _previousTime = time;
+                _time = time;
+
+                predict(state, dt);
+
+                // Sensors run at different rates and latencies, so merge their queues oldest-first
+                for (Sensor * sensor = oldestSensor(); sensor; sensor = oldestSensor()) {
+                    fuse(state, *sensor->_measurements.peek());
+                    sensor->_measurements.pop();
+                }
+            }
+
+    };  // class StateEstimator
+
+} // namespace hf
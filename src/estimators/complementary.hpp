@@ -0,0 +1,260 @@
+/*
+   Complementary-filter state estimator
+
+   Altitude and climb rate come from integrating the accelerometer, corrected
+   by the rangefinder while it is in range and by the barometer otherwise;
+   horizontal velocity comes from low-pass-filtered
+   optical flow scaled by altitude.  A short altitude history lets delayed
+   rangefinder readings be compared against the altitude we had when they
+   were actually sampled.
+
+   Hackflight adds an accelerometer along with the gyrometer, but it only
+   reports on IMUs that implement getAccelerometer(); on the others the
+   vertical acceleration stays zero, and the climb rate comes from the
+   altitude corrections alone.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <math.h>
+
+#include "estimator.hpp"
+#include "filters/exponential.hpp"
+#include "filters/movingaverage.hpp"
+
+namespace hf {
+
+    class ComplementaryEstimator : public StateEstimator {
+
+        private:
+
+            static constexpr float GRAVITY = 9.80665f;
+
+            // Fraction of the altitude error removed on each absolute-altitude reading, and the
+            // corresponding weight for correcting climb rate
+            static constexpr float ALTITUDE_GAIN   = 0.3f;
+            static constexpr float VARIOMETER_GAIN = 0.1f;
+
+            // The barometer is much noisier than the rangefinder, so we trust it less
+            static constexpr float BARO_ALTITUDE_GAIN   = 0.05f;
+            static constexpr float BARO_VARIOMETER_GAIN = 0.01f;
+
+            // Rangefinder readings outside this band (meters) are treated as out of range
+            static constexpr float RANGEFINDER_MIN = 0.01f;
+            static constexpr float RANGEFINDER_MAX = 4.0f;
+
+            // Fall back on the barometer when the rangefinder has been out of range this long
+            static constexpr float RANGEFINDER_TIMEOUT = 0.2f;
+
+            // Ground pressure is averaged over this many readings after power-up, then tracked with
+            // an exponential filter of the same length until arming
+            static constexpr float BARO_CALIBRATION_SAMPLES = 50;
+
+            // Weight of each rangefinder reading in the barometer-to-ground offset
+            static constexpr float BARO_OFFSET_ALPHA = 0.02f;
+
+            // Ignore gaps longer than this (startup, blocked loop) when integrating
+            static constexpr float MAX_DT = 0.1f;
+
+            static const uint8_t FLOW_LPF_SIZE = 64;
+
+            // At the 500Hz estimator rate this covers about 64 msec of sensor latency
+            static const uint8_t HISTORY_SIZE = 32;
+
+            // Earth-frame vertical acceleration, gravity removed, in meters/sec^2
+            float _verticalAccel = 0;
+
+            // Times of previous absolute-altitude corrections from each source
+            float _rangefinderTime = 0;
+            float _baroTime = 0;
+
+            // Pascals; zero until the first barometer reading
+            float _groundPressure = 0;
+            float _baroCalibrationCount = 0;
+
+            // Rangefinder altitude minus barometer altitude, learned while both are available,
+            // so that switching from one to the other does not step the altitude
+            ExponentialFilter _baroOffset = ExponentialFilter(BARO_OFFSET_ALPHA);
+
+            // Most recent barometer altitude above the ground reference
+            float _baroAltitude = 0;
+
+            // Hypsometric formula for the standard atmosphere, giving meters above the reference
+            static float pressureToAltitude(float pressure, float referencePressure)
+            {
+                return 44330.f * (1 - powf(pressure / referencePressure, 0.190295f));
+            }
+
+            void calibrateGroundPressure(float pressure)
+            {
+                if (_baroCalibrationCount < BARO_CALIBRATION_SAMPLES) {
+                    _baroCalibrationCount++;
+                }
+
+                // Running mean at first, then an exponential filter to follow the weather
+                _groundPressure += (pressure - _groundPressure) / _baroCalibrationCount;
+            }
+
+            bool rangefinderInRange(float time)
+            {
+                return _rangefinderTime > 0 && time - _rangefinderTime < RANGEFINDER_TIMEOUT;
+            }
+
+            // Ring buffer of predicted altitudes and the times they were predicted for
+            float _historyTime[HISTORY_SIZE] = {};
+            float _historyAltitude[HISTORY_SIZE] = {};
+            uint8_t _historyNewest = 0;
+            uint8_t _historyCount = 0;
+
+            void addHistory(float time, float altitude)
+            {
+                _historyNewest = (_historyNewest + 1) % HISTORY_SIZE;
+                _historyTime[_historyNewest] = time;
+                _historyAltitude[_historyNewest] = altitude;
+                if (_historyCount < HISTORY_SIZE) {
+                    _historyCount++;
+                }
+            }
+
+            // Predicted altitude at the given time, clamped to the oldest entry we still have
+            float altitudeAt(float time, float currentAltitude)
+            {
+                if (time >= _time) {
+                    return currentAltitude;
+                }
+
+                float altitude = currentAltitude;
+
+                for (uint8_t k=0; k<_historyCount; ++k) {
+                    uint8_t i = (_historyNewest + HISTORY_SIZE - k) % HISTORY_SIZE;
+                    altitude = _historyAltitude[i];
+                    if (_historyTime[i] <= time) {
+                        break;
+                    }
+                }
+
+                return altitude;
+            }
+
+            MovingAverage<FLOW_LPF_SIZE> _flowLpfX;
+            MovingAverage<FLOW_LPF_SIZE> _flowLpfY;
+
+        protected:
+
+            virtual void predict(state_t & state, float dt) override
+            {
+                if (dt <= 0 || dt > MAX_DT) return;
+
+                state.inertialVel[2] += _verticalAccel * dt;
+                state.location[2]    += state.inertialVel[2] * dt;
+
+                addHistory(_time, state.location[2]);
+            }
+
+            virtual void fuseAccelerometer(state_t & state, const measurement_t & m) override
+            {
+                const float * R = state.rotationMatrix[2];
+
+                // Third row of body-to-earth rotation.  Pitch is positive nose-down in our accelerometer
+                // convention (see imu.hpp), which flips the sign of the x term.
+                float az = -R[0] * m.values[0] + R[1] * m.values[1] + R[2] * m.values[2];
+
+                _verticalAccel = (az - 1) * GRAVITY;
+            }
+
+            virtual void fuseRangefinder(state_t & state, const measurement_t & m) override
+            {
+                float distance = m.values[0];
+
+                if (distance < RANGEFINDER_MIN || distance > RANGEFINDER_MAX) return;
+
+                // Compensate for effect of pitch, roll on rangefinder reading
+                float altitude = distance * state.rotationMatrix[2][2];
+
+                correctAltitude(state, altitude, m.time, _rangefinderTime, ALTITUDE_GAIN, VARIOMETER_GAIN);
+
+                if (_baroCalibrationCount > 0) {
+                    _baroOffset.update(altitude - _baroAltitude);
+                }
+            }
+
+            virtual void fuseBarometer(state_t & state, const measurement_t & m) override
+            {
+                float pressure = m.values[0];
+
+                if (pressure <= 0) return;
+
+                // On the ground, keep refining the reference pressure, which defines zero altitude
+                if (!state.armed) {
+                    calibrateGroundPressure(pressure);
+                }
+
+                // Armed at power-up: no reference yet, so we can't use the barometer
+                if (_baroCalibrationCount == 0) return;
+
+                _baroAltitude = pressureToAltitude(pressure, _groundPressure);
+
+                // The rangefinder is the better altitude source whenever it has a reading
+                if (rangefinderInRange(m.time)) return;
+
+                correctAltitude(state, _baroAltitude + _baroOffset.get(), m.time, _baroTime, BARO_ALTITUDE_GAIN, BARO_VARIOMETER_GAIN);
+            }
+
+            virtual void fuseOpticalFlow(state_t & state, const measurement_t & m) override
+            {
+                float dpixelx = m.values[0];
+                float dpixely = m.values[1];
+                float dt      = m.values[2];
+
+                // Scale readings by altitude, then low-pass filter them to get velocity
+                state.inertialVel[0] = _flowLpfY.update(dpixely  * state.location[2] * dt);
+                state.inertialVel[1] = _flowLpfX.update(-dpixelx * state.location[2] * dt);
+
+                // Integrate velocity to get position
+                state.location[0] += state.inertialVel[0];
+                state.location[1] += state.inertialVel[1];
+            }
+
+            // Pulls the integrated altitude and climb rate toward an absolute altitude reading taken
+            // at the given time.  The error is measured against the altitude we predicted for that
+            // time, then applied to the current state and to the history alike.  Each altitude
+            // source keeps its own previous-correction time for the climb-rate term.
+            void correctAltitude(state_t & state, float altitude, float time, float & previousTime, float altitudeGain, float variometerGain)
+            {
+                float error = altitude - altitudeAt(time, state.location[2]);
+
+                float correction = altitudeGain * error;
+
+                state.location[2] += correction;
+
+                for (uint8_t k=0; k<HISTORY_SIZE; ++k) {
+                    _historyAltitude[k] += correction;
+                }
+
+                float dt = time - previousTime;
+                if (dt > 0 && dt < MAX_DT) {
+                    state.inertialVel[2] += variometerGain * error / dt;
+                }
+
+                previousTime = time;
+            }
+
+    };  // class ComplementaryEstimator
+
+} // namespace hf
@@ -0,0 +1,471 @@
+/*
+   State estimator fusing optical flow with an Extended Kalman Filter.
+   Altitude and climb rate come from the complementary filter.
+
+   State estimation adapted from:
+
+    https://github.com/bitcraze/crazyflie-firmware/blob/master/src/modules/src/estimator_kalman.c
+
+    Copyright (c) 2018 Simon D. Levy
+
+    This file is part of Hackflight.
+
+    Hackflight is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Hackflight is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cmath>
+#include <math.h>
+
+#include "estimators/complementary.hpp"
+#include "fastmath.hpp"
+#include "filters.hpp"
+
+namespace hf {
+
+    class FlowEkfEstimator : public ComplementaryEstimator {
+
+        private:
+
+            static constexpr float FLOW_SCALE    = 100.f;
+
+            // The bounds on the covariance, these shouldn't be hit, but sometimes are... why?
+            static constexpr float MAX_COVARIANCE = 100.f;
+            static constexpr float MIN_COVARIANCE = 1e-6f;
+            static constexpr float MAX_POSITION   = 100.f; //meters
+            static constexpr float MAX_VELOCITY   = 10.f;  //meters per second
+
+            // The quad's attitude as a rotation matrix (used by the prediction, updated by the finalization)
+            float R[3][3] = {{1,0,0},{0,1,0},{0,0,1}};
+
+            // The quad's state, stored as a column vector
+            typedef enum
+            {
+                STATE_X,  // Position
+                STATE_Y, 
+                STATE_Z, 
+                STATE_PX, // Velocity
+                STATE_PY, 
+                STATE_PZ, 
+                STATE_D0, // Attitude error
+                STATE_D1, 
+                STATE_D2, 
+                STATE_DIM
+            } stateIdx_t;
+
+            float S[STATE_DIM] = {0.f};
+
+            float _omegax_b = 0;
+            float _omegay_b = 0;
+            float _dx_g = 0;
+            float _dy_g = 0;
+            float _z_g = 0;
+            float _predictedNX = 0;
+            float _predictedNY = 0;
+            float _measuredNX = 0;
+            float _measuredNY = 0;
+
+            float q[4] = {1,0,0,0};
+
+            // The state covariance, kept symmetric
+            float P[STATE_DIM][STATE_DIM] = {{0}};
+
+            static constexpr float STDDEV = 0.25f;
+
+            // ~~~ Camera constants ~~~
+            // The angle of aperture is guessed from the raw data register and thankfully look to be symmetric
+            float Npix = 30.0;                      // [pixels] (same in x and y)
+            float thetapix = Filter::deg2rad(4.2f);
+
+            // ~~~ Health monitoring ~~~
+            // The normalized innovation squared (error^2 / (HPH' + R)) averages 1 for a consistent
+            // filter; we track its running average and treat a large value as divergence.
+            static constexpr float INNOVATION_ALPHA     = 0.05f;
+            static constexpr float MAX_INNOVATION_RATIO = 25.f;
+
+            // Caps a single sample's contribution, so that one outlier can't trigger a reset
+            static constexpr float MAX_INNOVATION_SAMPLE = 100.f;
+
+            // Standard deviations used to re-initialize a sub-block after a soft reset
+            static constexpr float RESET_STDDEV_POSITION = 1.f;
+            static constexpr float RESET_STDDEV_VELOCITY = 0.01f;
+            static constexpr float RESET_STDDEV_ATTITUDE = 0.01f;
+
+            estimator_health_t _health = {};
+
+            // Position, velocity, and attitude each occupy a 3x3 block of the state
+            static uint8_t blockStart(uint8_t i)
+            {
+                return i - i % 3;
+            }
+
+            // Zeroes the states of the block containing index i, re-initializes its variances, and
+            // decorrelates it from the rest of the state.  O(N) instead of a full reset.
+            void resetBlock(uint8_t i)
+            {
+                static const float stddevs[3] = {RESET_STDDEV_POSITION, RESET_STDDEV_VELOCITY, RESET_STDDEV_ATTITUDE};
+
+                uint8_t start = blockStart(i);
+                float variance = stddevs[start/3] * stddevs[start/3];
+
+                for (uint8_t j=start; j<start+3; ++j) {
+                    S[j] = 0;
+                    for (uint8_t k=0; k<STATE_DIM; ++k) {
+                        P[j][k] = 0;
+                        P[k][j] = 0;
+                    }
+                    P[j][j] = variance;
+                }
+            }
+
+            void reset(void)
+            {
+                resetBlock(STATE_X);
+                resetBlock(STATE_PX);
+                resetBlock(STATE_D0);
+                _health.innovationRatio = 1;
+            }
+
+            // A covariance entry obeys P_ij^2 <= P_ii P_jj only while P is positive semi-definite;
+            // the slack keeps round-off on a fully correlated pair from counting as a violation
+            static constexpr float CORRELATION_SLACK = 1.01f;
+
+            static bool correlationValid(float pij, float pii, float pjj)
+            {
+                return pij * pij <= CORRELATION_SLACK * pii * pjj;
+            }
+
+            // Checks the state and the covariance diagonal in O(N), soft-resetting any block that has
+            // gone NaN or saturated.  The diagonal only bounds the off-diagonals while P stays positive
+            // semi-definite, which is what a diverging filter loses, so we also check the three
+            // correlations inside each block; correlations across blocks are held to MAX_COVARIANCE
+            // by setCovarianceBounded().  Also updates the trace.
+            void checkHealth(void)
+            {
+                float trace = 0;
+
+                for (uint8_t start=0; start<STATE_DIM; start+=3) {
+
+                    bool nan = false;
+                    bool saturated = false;
+
+                    for (uint8_t j=start; j<start+3; ++j) {
+                        nan = nan || std::isnan(S[j]) || std::isnan(P[j][j]);
+                        saturated = saturated || P[j][j] >= MAX_COVARIANCE;
+                    }
+
+                    for (uint8_t j=start; j<start+2; ++j) {
+                        for (uint8_t k=j+1; k<start+3; ++k) {
+                            saturated = saturated || !correlationValid(P[j][k], P[j][j], P[k][k]);
+                        }
+                    }
+
+                    if (nan) {
+                        _health.nanResets++;
+                        resetBlock(start);
+                    }
+                    else if (saturated) {
+                        _health.divergenceResets++;
+                        resetBlock(start);
+                    }
+
+                    trace += P[start][start] + P[start+1][start+1] + P[start+2][start+2];
+                }
+
+                _health.covarianceTrace = trace;
+            }
+
+            // Returns false, after soft-resetting the blocks seen by the measurement, if the
+            // innovation is NaN or the running innovation ratio shows that the filter has diverged.
+            bool checkInnovation(const uint8_t idx[], uint8_t n, float error, float HPHR)
+            {
+                float ratio = error * error / HPHR;
+
+                bool nan = std::isnan(ratio) || !(HPHR > 0);
+
+                if (!nan) {
+                    ratio = Filter::constrainMinMax(ratio, 0, MAX_INNOVATION_SAMPLE);
+                    _health.innovationRatio += INNOVATION_ALPHA * (ratio - _health.innovationRatio);
+                    if (_health.innovationRatio < MAX_INNOVATION_RATIO) {
+                        return true;
+                    }
+                }
+
+                if (nan) {
+                    _health.nanResets++;
+                }
+                else {
+                    _health.divergenceResets++;
+                }
+
+                for (uint8_t k=0; k<n; ++k) {
+                    resetBlock(idx[k]);
+                }
+
+                _health.innovationRatio = 1;
+
+                return false;
+            }
+
+            // Stores p at (i,j) and (j,i), keeping the value bounded
+            void setCovarianceBounded(uint8_t i, uint8_t j, float p)
+            {
+                if (std::isnan(p) || p > MAX_COVARIANCE) {
+                    p = MAX_COVARIANCE;
+                } else if ( i==j && p < MIN_COVARIANCE ) {
+                    p = MIN_COVARIANCE;
+                }
+                P[i][j] = p;
+                P[j][i] = p;
+            }
+
+            void stateEstimatorFinalize(void)
+            {
+                // Incorporate the attitude error (Kalman filter state) with the attitude
+                float v0 = S[STATE_D0];
+                float v1 = S[STATE_D1];
+                float v2 = S[STATE_D2];
+
+                // Move attitude error into attitude if any of the angle errors are large enough
+                if ((fabsf(v0) > 0.1e-3f || fabsf(v1) > 0.1e-3f || fabsf(v2) > 0.1e-3f) && (fabsf(v0) < 10 && fabsf(v1) < 10 && fabsf(v2) < 10)) {
+
+                    float angle = FastMath::sqrt(v0*v0 + v1*v1 + v2*v2);
+                    float sa = 0, ca = 0;
+                    FastMath::sincos(angle / 2.0f, sa, ca);
+                    sa /= angle;
+                    float dq[4] = {ca, sa * v0, sa * v1, sa * v2};
+
+                    // rotate the quad's attitude by the delta quaternion vector computed above
+                    float tmpq0 = dq[0] * q[0] - dq[1] * q[1] - dq[2] * q[2] - dq[3] * q[3];
+                    float tmpq1 = dq[1] * q[0] + dq[0] * q[1] + dq[3] * q[2] - dq[2] * q[3];
+                    float tmpq2 = dq[2] * q[0] - dq[3] * q[1] + dq[0] * q[2] + dq[1] * q[3];
+                    float tmpq3 = dq[3] * q[0] + dq[2] * q[1] - dq[1] * q[2] + dq[0] * q[3];
+
+                    // normalize and store the result
+                    float norm = FastMath::invSqrt(tmpq0 * tmpq0 + tmpq1 * tmpq1 + tmpq2 * tmpq2 + tmpq3 * tmpq3);
+                    q[0] = tmpq0 * norm;
+                    q[1] = tmpq1 * norm;
+                    q[2] = tmpq2 * norm;
+                    q[3] = tmpq3 * norm;
+
+                    /** Rotate the covariance, since we've rotated the body
+                     *
+                     * This comes from a second order approximation to:
+                     * Sigma_post = exps(-d) Sigma_pre exps(-d)'
+                     *            ~ (I + [[-d]] + [[-d]]^2 / 2) Sigma_pre (I + [[-d]] + [[-d]]^2 / 2)'
+                     * where d is the attitude error expressed as Rodriges parameters, ie. d = tan(|v|/2)*v/|v|
+                     *
+                     * As derived in "Covariance Correction Step for Kalman Filtering with an Attitude"
+                     * http://arc.aiaa.org/doi/abs/10.2514/1.G000848
+                     */
+
+                    float d0 = v0/2; // the attitude error vector (v0,v1,v2) is small,
+                    float d1 = v1/2; // so we use a first order approximation to d0 = tan(|v0|/2)*v0/|v0|
+                    float d2 = v2/2;
+
+                    // The rotation is the identity outside of its 3x3 attitude block
+                    float A[3][3] = {
+                        { 1 - d1*d1/2 - d2*d2/2,   d2 + d0*d1/2,            -d1 + d0*d2/2 },
+                        { -d2 + d0*d1/2,           1 - d0*d0/2 - d2*d2/2,   d0 + d1*d2/2  },
+                        { d1 + d0*d2/2,            -d0 + d1*d2/2,           1 - d0*d0/2 - d1*d1/2 }
+                    };
+
+                    rotateAttitudeCovariance(A);
+                }
+
+                // convert the new attitude to a rotation matrix, such that we can rotate body-frame velocity and acc
+                R[0][0] = q[0] * q[0] + q[1] * q[1] - q[2] * q[2] - q[3] * q[3];
+                R[0][1] = 2 * q[1] * q[2] - 2 * q[0] * q[3];
+                R[0][2] = 2 * q[1] * q[3] + 2 * q[0] * q[2];
+
+                R[1][0] = 2 * q[1] * q[2] + 2 * q[0] * q[3];
+                R[1][1] = q[0] * q[0] - q[1] * q[1] + q[2] * q[2] - q[3] * q[3];
+                R[1][2] = 2 * q[2] * q[3] - 2 * q[0] * q[1];
+
+                R[2][0] = 2 * q[1] * q[3] - 2 * q[0] * q[2];
+                R[2][1] = 2 * q[2] * q[3] + 2 * q[0] * q[1];
+                R[2][2] = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
+
+                // reset the attitude error
+                S[STATE_D0] = 0;
+                S[STATE_D1] = 0;
+                S[STATE_D2] = 0;
+
+                // constrain the states
+                for (int i=0; i<3; i++)
+                {
+                    if (S[STATE_X+i] < -MAX_POSITION) { S[STATE_X+i] = -MAX_POSITION; }
+                    else if (S[STATE_X+i] > MAX_POSITION) { S[STATE_X+i] = MAX_POSITION; }
+
+                    if (S[STATE_PX+i] < -MAX_VELOCITY) { S[STATE_PX+i] = -MAX_VELOCITY; }
+                    else if (S[STATE_PX+i] > MAX_VELOCITY) { S[STATE_PX+i] = MAX_VELOCITY; }
+                }
+
+                // ensure the covariance values stay bounded; symmetry is maintained by construction
+                for (uint8_t i=0; i<STATE_DIM; i++) {
+                    for (uint8_t j=i; j<STATE_DIM; j++) {
+                        setCovarianceBounded(i, j, P[i][j]);
+                    }
+                }
+            }
+
+            // Computes P = A P A' for a matrix A that is the identity except for the 3x3 attitude block.
+            // Only the attitude rows and columns of P change, so we skip the rest.
+            void rotateAttitudeCovariance(const float A[3][3])
+            {
+                // Position/velocity vs. attitude cross-covariance: P_xd = P_xd A'
+                for (uint8_t i=0; i<STATE_D0; ++i) {
+                    float p[3] = {P[i][STATE_D0], P[i][STATE_D1], P[i][STATE_D2]};
+                    for (uint8_t r=0; r<3; ++r) {
+                        float v = A[r][0]*p[0] + A[r][1]*p[1] + A[r][2]*p[2];
+                        P[i][STATE_D0+r] = v;
+                        P[STATE_D0+r][i] = v;
+                    }
+                }
+
+                // Attitude block: P_dd = A P_dd A'
+                float AP[3][3];
+                for (uint8_t r=0; r<3; ++r) {
+                    for (uint8_t c=0; c<3; ++c) {
+                        AP[r][c] = A[r][0]*P[STATE_D0][STATE_D0+c] + A[r][1]*P[STATE_D1][STATE_D0+c] + A[r][2]*P[STATE_D2][STATE_D0+c];
+                    }
+                }
+                for (uint8_t r=0; r<3; ++r) {
+                    for (uint8_t c=r; c<3; ++c) {
+                        float v = AP[r][0]*A[c][0] + AP[r][1]*A[c][1] + AP[r][2]*A[c][2];
+                        P[STATE_D0+r][STATE_D0+c] = v;
+                        P[STATE_D0+c][STATE_D0+r] = v;
+                    }
+                }
+            }
+
+            // Scalar measurement update for a sparse measurement row H, given as its nonzero
+            // entries h[0..n-1] at state indices idx[0..n-1]
+            void stateEstimatorScalarUpdate(const uint8_t idx[], const float h[], uint8_t n, float error, float stdMeasNoise)
+            {
+                // ====== INNOVATION COVARIANCE ======
+
+                // PH' only needs the columns of P where H is nonzero
+                float PHt[STATE_DIM] = {0};
+                for (uint8_t i=0; i<STATE_DIM; i++) {
+                    for (uint8_t k=0; k<n; k++) {
+                        PHt[i] += P[i][idx[k]] * h[k];
+                    }
+                }
+
+                float R = stdMeasNoise*stdMeasNoise;
+                float HPHR = R; // HPH' + R
+                for (uint8_t k=0; k<n; k++) {
+                    HPHR += h[k] * PHt[idx[k]];
+                }
+
+                if (!checkInnovation(idx, n, error, HPHR)) return;
+
+                // ====== MEASUREMENT UPDATE ======
+                // Calculate the Kalman gain and perform the state update
+                float K[STATE_DIM];
+                for (uint8_t i=0; i<STATE_DIM; i++) {
+                    K[i] = PHt[i]/HPHR; // kalman gain = (PH' (HPH' + R )^-1)
+                    S[i] += K[i] * error; // state update
+                }
+
+                // ====== COVARIANCE UPDATE ======
+                // Joseph form (I - KH) P (I - KH)' + KRK', expanded into rank-1 outer products:
+                // P - K (PH')' - (PH') K' + K (HPH' + R) K'.  We compute the upper triangle only,
+                // and ensure boundedness as we mirror it.
+                // TODO: Why would it hit these bounds? Needs to be investigated.
+                for (uint8_t i=0; i<STATE_DIM; i++) {
+                    for (uint8_t j=i; j<STATE_DIM; j++) {
+                        float p = P[i][j] - K[i]*PHt[j] - PHt[i]*K[j] + K[i]*HPHR*K[j];
+                        setCovarianceBounded(i, j, p);
+                    }
+                }
+
+                checkHealth();
+            }
+
+
+        protected:
+
+            virtual void fuseOpticalFlow(state_t & state, const measurement_t & m) override
+            {
+                float dpixelx = m.values[0];
+                float dpixely = m.values[1];
+                float deltaTime = m.values[2];
+
+                S[STATE_Z] = state.location[2];
+                S[STATE_PZ] = state.inertialVel[2];
+
+                //~~~ Body rates ~~~
+                // TODO check if this is feasible or if some filtering has to be done
+                _omegax_b = state.angularVel[0];
+                _omegay_b = state.angularVel[1];
+
+                _dx_g = S[STATE_PX];
+                _dy_g = S[STATE_PY];
+
+                // Saturate elevation in prediction and correction to avoid singularities
+                _z_g = S[STATE_Z] < 0.1f ?  0.1f : S[STATE_Z];
+
+                // ~~~ X velocity prediction and update ~~~
+                // predicts the number of accumulated pixels in the x-direction
+                float omegaFactor = 1.25f;
+                _predictedNX = (deltaTime * Npix / thetapix ) * ((_dx_g * R[2][2] / _z_g) - omegaFactor * _omegay_b);
+                _measuredNX = dpixelx * FLOW_SCALE;
+
+                // derive measurement equation with respect to dx (and z?)
+                const uint8_t idxx[2] = {STATE_Z, STATE_PX};
+                float hx[2] = {
+                    (Npix * deltaTime / thetapix) * ((R[2][2] * _dx_g) / (-_z_g * _z_g)),
+                    (Npix * deltaTime / thetapix) * (R[2][2] / _z_g)
+                };
+
+                //First update
+                stateEstimatorScalarUpdate(idxx, hx, 2, _measuredNX-_predictedNX, STDDEV);
+
+                // ~~~ Y velocity prediction and update ~~~
+                _predictedNY = (deltaTime * Npix / thetapix ) * ((_dy_g * R[2][2] / _z_g) + omegaFactor * _omegax_b);
+                _measuredNY = dpixely * FLOW_SCALE;
+
+                // derive measurement equation with respect to dy (and z?)
+                const uint8_t idxy[2] = {STATE_Z, STATE_PY};
+                float hy[2] = {
+                    (Npix * deltaTime / thetapix) * ((R[2][2] * _dy_g) / (-_z_g * _z_g)),
+                    (Npix * deltaTime / thetapix) * (R[2][2] / _z_g)
+                };
+
+                // Second update
+                stateEstimatorScalarUpdate(idxy, hy, 2, _measuredNY-_predictedNY, STDDEV);
+
+                stateEstimatorFinalize();
+
+                state.inertialVel[0] = S[STATE_PX];
+                state.inertialVel[1] = S[STATE_PY];
+            }
+
+            virtual const estimator_health_t * getHealth(void) override
+            {
+                return &_health;
+            }
+
+        public:
+
+            FlowEkfEstimator(void)
+            {
+                reset();
+            }
+
+    };  // class FlowEkfEstimator
+
+} // namespace hf
@@ -0,0 +1,175 @@
+/*
+   Staged failsafe
+
+   When the receiver link goes bad while armed, rather than cutting the
+   motors at once we go through stages, each lasting a configurable time:
+
+     HOLD:    keep flying on the last good demands, so that a short dropout
+              goes unnoticed
+     LEVEL:   zero the cyclic and yaw demands and switch in the LevelPid,
+              keeping the last throttle
+     DESCEND: also switch in the AltitudeHoldPid and demand a slow descent
+     DISARM:  cut the motors; the vehicle can't be armed again until reboot
+
+   A link that comes back during HOLD resumes normal flight at once; after
+   that, it has to stay good for a while first.  Losing the link with the
+   throttle down skips straight to DISARM, since we're probably on the
+   ground.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "datatypes.hpp"
+
+namespace hf {
+
+    enum {
+        FAILSAFE_OK,
+        FAILSAFE_HOLD,
+        FAILSAFE_LEVEL,
+        FAILSAFE_DESCEND,
+        FAILSAFE_DISARM
+    };
+
+    typedef struct {
+
+        // The link is bad when there's been no frame for signalTimeout seconds, when link quality
+        // (see LinkQuality) falls below minLinkQuality, or when the receiver says it has lost the signal
+        float signalTimeout = 0.25f;
+        float minLinkQuality = 0.3f;
+
+        // Seconds in each stage before going on to the next
+        float holdTime    = 1.0f;
+        float levelTime   = 2.0f;
+        float descentTime = 10.0f;
+
+        // Throttle demand while descending.  With an AltitudeHoldPid this works like the throttle stick
+        // in altitude hold (-0.2 is 0.5 m/s down); without one, set it a little under hover throttle.
+        float descentThrottle = -0.2f;
+
+        // Seconds of good link needed to leave LEVEL or DESCEND
+        float recoveryTime = 1.0f;
+
+    } failsafe_config_t;
+
+    class Failsafe {
+
+        friend class Hackflight;
+        friend class PidTask;
+
+        private:
+
+            failsafe_config_t _config;
+
+            uint8_t _stage = FAILSAFE_OK;
+            float _stageTime = 0;
+
+            // When the link last went from bad to good
+            float _goodTime = 0;
+            bool _wasGood = true;
+
+            // Last demands before the link went bad
+            demands_t _held = {};
+
+            void setStage(uint8_t stage, float time)
+            {
+                _stage = stage;
+                _stageTime = time;
+            }
+
+            // Called by Hackflight on every loop
+            void update(float time, bool linkGood, bool armed, bool throttleIsDown)
+            {
+                if (linkGood && !_wasGood) {
+                    _goodTime = time;
+                }
+                _wasGood = linkGood;
+
+                if (!armed) {
+                    setStage(FAILSAFE_OK, time);
+                    return;
+                }
+
+                float elapsed = time - _stageTime;
+
+                switch (_stage) {
+
+                    case FAILSAFE_OK:
+                        if (!linkGood) {
+                            setStage(throttleIsDown ? FAILSAFE_DISARM : FAILSAFE_HOLD, time);
+                        }
+                        break;
+
+                    case FAILSAFE_HOLD:
+                        if (linkGood) {
+                            setStage(FAILSAFE_OK, time);
+                        }
+                        else if (elapsed > _config.holdTime) {
+                            setStage(FAILSAFE_LEVEL, time);
+                        }
+                        break;
+
+                    case FAILSAFE_LEVEL:
+                    case FAILSAFE_DESCEND:
+                        if (linkGood && time - _goodTime > _config.recoveryTime) {
+                            setStage(FAILSAFE_OK, time);
+                        }
+                        else if (elapsed > (_stage == FAILSAFE_LEVEL ? _config.levelTime : _config.descentTime)) {
+                            setStage(_stage + 1, time);
+                        }
+                        break;
+                }
+            }
+
+            // Called by PidTask on every iteration, before the PID controllers
+            void modifyDemands(demands_t & demands)
+            {
+                if (_stage == FAILSAFE_OK) {
+                    _held = demands;
+                    return;
+                }
+
+                if (_stage == FAILSAFE_HOLD) {
+                    demands = _held;
+                    return;
+                }
+
+                demands.throttle = _stage == FAILSAFE_LEVEL ? _held.throttle : _config.descentThrottle;
+                demands.roll = 0;
+                demands.pitch = 0;
+                demands.yaw = 0;
+            }
+
+            // Whether the current stage switches in the PID controller using these gains, whatever the aux switch says
+            bool engages(uint8_t gainsId)
+            {
+                return (gainsId == GAINS_LEVEL   && _stage >= FAILSAFE_LEVEL) ||
+                       (gainsId == GAINS_ALTHOLD && _stage >= FAILSAFE_DESCEND);
+            }
+
+        public:
+
+            uint8_t getStage(void)
+            {
+                return _stage;
+            }
+
+    };  // class Failsafe
+
+} // namespace hf
@@ -0,0 +1,151 @@
+/*
+   Fast approximations to the libm functions used by the attitude filters
+
+   Define HF_FASTMATH before including any Hackflight header to use the
+   approximations; otherwise these just call libm.  Error bounds are for the
+   approximations:
+
+     invSqrt: relative error below 5e-6 (two Newton steps)
+     atan2:   below 2e-6 rad
+     asin:    below 8e-5 rad
+     sincos:  below 5e-7 for |x| < 2*pi, growing to about 1e-7 * |x| beyond
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace hf {
+
+    class FastMath {
+
+        private:
+
+            static constexpr float PI      = 3.14159265f;
+            static constexpr float HALF_PI = 1.57079633f;
+
+        public:
+
+            // x must be positive
+            static float invSqrt(float x)
+            {
+#ifdef HF_FASTMATH
+                uint32_t i;
+                float y;
+
+                memcpy(&i, &x, sizeof(i));
+                i = 0x5f375a86 - (i >> 1);
+                memcpy(&y, &i, sizeof(y));
+
+                float halfx = 0.5f * x;
+                y *= 1.5f - halfx * y * y;
+                y *= 1.5f - halfx * y * y;
+
+                return y;
+#else
+                return 1 / sqrtf(x);
+#endif
+            }
+
+            // x must be non-negative
+            static float sqrt(float x)
+            {
+#ifdef HF_FASTMATH
+                return x > 0 ? x * invSqrt(x) : 0;
+#else
+                return sqrtf(x);
+#endif
+            }
+
+            static float atan2(float y, float x)
+            {
+#ifdef HF_FASTMATH
+                float ax = fabsf(x);
+                float ay = fabsf(y);
+
+                float mx = ax > ay ? ax : ay;
+                float mn = ax > ay ? ay : ax;
+
+                if (mx == 0) {
+                    return 0;
+                }
+
+                // Odd minimax polynomial for atan on [0,1]
+                float z = mn / mx;
+                float z2 = z * z;
+                float a = z * (0.99997726f + z2 * (-0.33262347f + z2 * (0.19354346f + z2 * (-0.11643287f + z2 * (0.05265332f - z2 * 0.01172120f)))));
+
+                // Back out to the octant we started in
+                if (ay > ax) a = HALF_PI - a;
+                if (x < 0)   a = PI - a;
+                if (y < 0)   a = -a;
+
+                return a;
+#else
+                return atan2f(y, x);
+#endif
+            }
+
+            // x is clamped to [-1,+1]
+            static float asin(float x)
+            {
+#ifdef HF_FASTMATH
+                float ax = fabsf(x);
+
+                if (ax >= 1) {
+                    return x > 0 ? HALF_PI : -HALF_PI;
+                }
+
+                // Abramowitz and Stegun 4.4.45
+                float a = HALF_PI - sqrt(1 - ax) * (1.5707288f + ax * (-0.2121144f + ax * (0.0742610f - ax * 0.0187293f)));
+
+                return x < 0 ? -a : a;
+#else
+                return asinf(x < -1 ? -1 : (x > 1 ? 1 : x));
+#endif
+            }
+
+            static void sincos(float x, float & s, float & c)
+            {
+#ifdef HF_FASTMATH
+                // Reduce to [-pi/4,+pi/4] and the quadrant we came from
+                int32_t k = (int32_t)floorf(x / HALF_PI + 0.5f);
+                float r = x - k * HALF_PI;
+                float r2 = r * r;
+
+                float sr = r * (1 + r2 * (-1.f/6 + r2 * (1.f/120 - r2 * (1.f/5040))));
+                float cr = 1 + r2 * (-0.5f + r2 * (1.f/24 + r2 * (-1.f/720 + r2 * (1.f/40320))));
+
+                switch (k & 3) {
+                    case 0: s =  sr; c =  cr; break;
+                    case 1: s =  cr; c = -sr; break;
+                    case 2: s = -sr; c = -cr; break;
+                    default: s = -cr; c =  sr; break;
+                }
+#else
+                s = sinf(x);
+                c = cosf(x);
+#endif
+            }
+
+    };  // class FastMath
+
+} // namespace hf
@@ -23,6 +23,8 @@
 #include <math.h>
 #include <stdint.h>
 
+#include "fastmath.hpp"
+
 #ifndef M_PI
 static const float M_PI = 3.141593;
 #endif
@@ -63,43 +65,6 @@ namespace hf {
 
     }; // class Filter
 
-    class LowPassFilter {
-
-        private:
-
-            float _history[256] = {0};
-            uint8_t _historySize = {0};
-            uint8_t _historyIdx = {0};
-            float _sum = {0};
-
-        public:
-
-            LowPassFilter(uint16_t historySize)
-            {
-                _historySize = historySize;
-            }
-
-            void init(void)
-            {
-                for (uint8_t k=0; k<_historySize; ++k) {
-                    _history[k] = 0;
-                }
-                _historyIdx = 0;
-                _sum = 0;
-            }
-
-            float update(float value)
-            {
-                uint8_t indexplus1 = (_historyIdx + 1) % _historySize;
-                _history[_historyIdx] = value;
-                _sum += _history[_historyIdx];
-                _sum -= _history[indexplus1];
-                _historyIdx = indexplus1;
-                return _sum / _historySize;
-            }
-
-    }; // class LowPassFilter
-
     class QuaternionFilter {
 
         public:
@@ -173,17 +138,17 @@ namespace hf {
                 float q4q4 = q4 * q4;
 
                 // Normalise accelerometer measurement
-                norm = sqrtf(ax * ax + ay * ay + az * az);
+                norm = ax * ax + ay * ay + az * az;
                 if (norm == 0.0f) return; // handle NaN
-                norm = 1.0f/norm;
+                norm = FastMath::invSqrt(norm);
                 ax *= norm;
                 ay *= norm;
                 az *= norm;
 
                 // Normalise magnetometer measurement
-                norm = sqrtf(mx * mx + my * my + mz * mz);
+                norm = mx * mx + my * my + mz * mz;
                 if (norm == 0.0f) return; // handle NaN
-                norm = 1.0f/norm;
+                norm = FastMath::invSqrt(norm);
                 mx *= norm;
                 my *= norm;
                 mz *= norm;
@@ -195,7 +160,7 @@ namespace hf {
                 _2q2mx = 2.0f * q2 * mx;
                 hx = mx * q1q1 - _2q1my * q4 + _2q1mz * q3 + mx * q2q2 + _2q2 * my * q3 + _2q2 * mz * q4 - mx * q3q3 - mx * q4q4;
                 hy = _2q1mx * q4 + my * q1q1 - _2q1mz * q2 + _2q2mx * q3 - my * q2q2 + my * q3q3 + _2q3 * mz * q4 - my * q4q4;
-                _2bx = sqrtf(hx * hx + hy * hy);
+                _2bx = FastMath::sqrt(hx * hx + hy * hy);
                 _2bz = -_2q1mx * q3 + _2q1my * q2 + mz * q1q1 + _2q2mx * q4 - mz * q2q2 + _2q3 * my * q4 - mz * q3q3 + mz * q4q4;
                 _4bx = 2.0f * _2bx;
                 _4bz = 2.0f * _2bz;
@@ -225,8 +190,7 @@ namespace hf {
                     _2bx * q2 * (_2bx * (q1q3 + q2q4) + _2bz * (0.5f - q2q2 - q3q3) - mz);
 
                 // Normalize step magnitude
-                norm = sqrtf(s1 * s1 + s2 * s2 + s3 * s3 + s4 * s4);    
-                norm = 1.0f/norm;
+                norm = FastMath::invSqrt(s1 * s1 + s2 * s2 + s3 * s3 + s4 * s4);
                 s1 *= norm;
                 s2 *= norm;
                 s3 *= norm;
@@ -243,8 +207,11 @@ namespace hf {
                 q2 += qDot2 * deltat;
                 q3 += qDot3 * deltat;
                 q4 += qDot4 * deltat;
-                norm = sqrtf(q1 * q1 + q2 * q2 + q3 * q3 + q4 * q4);    // normalise quaternion
-                norm = 1.0f/norm;
+                norm = FastMath::invSqrt(q1 * q1 + q2 * q2 + q3 * q3 + q4 * q4);    // normalise quaternion
+                q1 *= norm;
+                q2 *= norm;
+                q3 *= norm;
+                q4 *= norm;
             }
     }; // class MadgwickQuaternionFilter9DOF 
 
@@ -254,35 +221,32 @@ namespace hf {
 
             float _zeta = 0;
 
-        public:
+            // Gyro bias error
+            float _gbiasx = 0;
+            float _gbiasy = 0;
+            float _gbiasz = 0;
 
-            MadgwickQuaternionFilter6DOF(float beta, float zeta) 
-                : MadgwickQuaternionFilter(beta) 
-            { 
-                _zeta = zeta;
+            void normalize(void)
+            {
+                float norm = FastMath::invSqrt(q1 * q1 + q2 * q2 + q3 * q3 + q4 * q4);
+                q1 *= norm;
+                q2 *= norm;
+                q3 *= norm;
+                q4 *= norm;
             }
 
-            // Adapted from https://github.com/kriswiner/MPU6050/blob/master/quaternionFilter.ino
-            void update(float ax, float ay, float az, float gx, float gy, float gz, float deltat)
+            // Normalized gradient of the accelerometer objective function; returns false on a zero reading
+            bool accelGradient(float ax, float ay, float az, float & hatDot1, float & hatDot2, float & hatDot3, float & hatDot4)
             {
-                static float gbiasx, gbiasy, gbiasz;        // gyro bias error
-
-                // Auxiliary variables to avoid repeated arithmetic
-                float _halfq1 = 0.5f * q1;
-                float _halfq2 = 0.5f * q2;
-                float _halfq3 = 0.5f * q3;
-                float _halfq4 = 0.5f * q4;
                 float _2q1 = 2.0f * q1;
                 float _2q2 = 2.0f * q2;
                 float _2q3 = 2.0f * q3;
                 float _2q4 = 2.0f * q4;
-                //float _2q1q3 = 2.0f * q1 * q3;
-                //float _2q3q4 = 2.0f * q3 * q4;
 
                 // Normalise accelerometer measurement
-                float norm = sqrt(ax * ax + ay * ay + az * az);
-                if (norm == 0.0f) return; // handle NaN
-                norm = 1.0f/norm;
+                float norm = ax * ax + ay * ay + az * az;
+                if (norm == 0.0f) return false; // handle NaN
+                norm = FastMath::invSqrt(norm);
                 ax *= norm;
                 ay *= norm;
                 az *= norm;
@@ -299,17 +263,92 @@ namespace hf {
                 float J_33 = 2.0f * J_11or24;
 
                 // Compute the gradient (matrix multiplication)
-                float hatDot1 = J_14or21 * f2 - J_11or24 * f1;
-                float hatDot2 = J_12or23 * f1 + J_13or22 * f2 - J_32 * f3;
-                float hatDot3 = J_12or23 * f2 - J_33 *f3 - J_13or22 * f1;
-                float hatDot4 = J_14or21 * f1 + J_11or24 * f2;
-
-                // Normalize the gradient
-                norm = sqrt(hatDot1 * hatDot1 + hatDot2 * hatDot2 + hatDot3 * hatDot3 + hatDot4 * hatDot4);
-                hatDot1 /= norm;
-                hatDot2 /= norm;
-                hatDot3 /= norm;
-                hatDot4 /= norm;
+                hatDot1 = J_14or21 * f2 - J_11or24 * f1;
+                hatDot2 = J_12or23 * f1 + J_13or22 * f2 - J_32 * f3;
+                hatDot3 = J_12or23 * f2 - J_33 *f3 - J_13or22 * f1;
+                hatDot4 = J_14or21 * f1 + J_11or24 * f2;
+
+                // Normalize the gradient, which vanishes when we already agree exactly with the accelerometer
+                norm = hatDot1 * hatDot1 + hatDot2 * hatDot2 + hatDot3 * hatDot3 + hatDot4 * hatDot4;
+                norm = norm > 0 ? FastMath::invSqrt(norm) : 0;
+                hatDot1 *= norm;
+                hatDot2 *= norm;
+                hatDot3 *= norm;
+                hatDot4 *= norm;
+
+                return true;
+            }
+
+        public:
+
+            MadgwickQuaternionFilter6DOF(float beta, float zeta) 
+                : MadgwickQuaternionFilter(beta) 
+            { 
+                _zeta = zeta;
+            }
+
+            // Cheap half of the filter, for every gyro sample: rotates the quaternion by the bias-corrected
+            // rotation over deltat, using a second-order small-angle delta quaternion (no trig)
+            void integrateGyro(float gx, float gy, float gz, float deltat)
+            {
+                float hx = 0.5f * (gx - _gbiasx) * deltat;
+                float hy = 0.5f * (gy - _gbiasy) * deltat;
+                float hz = 0.5f * (gz - _gbiasz) * deltat;
+
+                float hw = 1 - 0.5f * (hx * hx + hy * hy + hz * hz);
+
+                float p1 = q1, p2 = q2, p3 = q3, p4 = q4;
+
+                q1 = p1 * hw - p2 * hx - p3 * hy - p4 * hz;
+                q2 = p1 * hx + p2 * hw + p3 * hz - p4 * hy;
+                q3 = p1 * hy - p2 * hz + p3 * hw + p4 * hx;
+                q4 = p1 * hz + p2 * hy - p3 * hx + p4 * hw;
+
+                normalize();
+            }
+
+            // Expensive half, run at a lower rate: one gradient-descent step toward the accelerometer's
+            // gravity direction, and a gyro-bias update, both scaled by the time since the previous correction
+            void correctAccel(float ax, float ay, float az, float deltat)
+            {
+                float hatDot1, hatDot2, hatDot3, hatDot4;
+
+                if (!accelGradient(ax, ay, az, hatDot1, hatDot2, hatDot3, hatDot4)) return;
+
+                float _2q1 = 2.0f * q1;
+                float _2q2 = 2.0f * q2;
+                float _2q3 = 2.0f * q3;
+                float _2q4 = 2.0f * q4;
+
+                // Compute and accumulate estimated gyroscope biases
+                _gbiasx += (_2q1 * hatDot2 - _2q2 * hatDot1 - _2q3 * hatDot4 + _2q4 * hatDot3) * deltat * _zeta;
+                _gbiasy += (_2q1 * hatDot3 + _2q2 * hatDot4 - _2q3 * hatDot1 - _2q4 * hatDot2) * deltat * _zeta;
+                _gbiasz += (_2q1 * hatDot4 - _2q2 * hatDot3 + _2q3 * hatDot2 - _2q4 * hatDot1) * deltat * _zeta;
+
+                q1 -= _beta * hatDot1 * deltat;
+                q2 -= _beta * hatDot2 * deltat;
+                q3 -= _beta * hatDot3 * deltat;
+                q4 -= _beta * hatDot4 * deltat;
+
+                normalize();
+            }
+
+            // Adapted from https://github.com/kriswiner/MPU6050/blob/master/quaternionFilter.ino
+            void update(float ax, float ay, float az, float gx, float gy, float gz, float deltat)
+            {
+                float hatDot1, hatDot2, hatDot3, hatDot4;
+
+                if (!accelGradient(ax, ay, az, hatDot1, hatDot2, hatDot3, hatDot4)) return;
+
+                // Auxiliary variables to avoid repeated arithmetic
+                float _halfq1 = 0.5f * q1;
+                float _halfq2 = 0.5f * q2;
+                float _halfq3 = 0.5f * q3;
+                float _halfq4 = 0.5f * q4;
+                float _2q1 = 2.0f * q1;
+                float _2q2 = 2.0f * q2;
+                float _2q3 = 2.0f * q3;
+                float _2q4 = 2.0f * q4;
 
                 // Compute estimated gyroscope biases
                 float gerrx = _2q1 * hatDot2 - _2q2 * hatDot1 - _2q3 * hatDot4 + _2q4 * hatDot3;
@@ -317,12 +356,12 @@ namespace hf {
                 float gerrz = _2q1 * hatDot4 - _2q2 * hatDot3 + _2q3 * hatDot2 - _2q4 * hatDot1;
 
                 // Compute and remove gyroscope biases
-                gbiasx += gerrx * deltat * _zeta;
-                gbiasy += gerry * deltat * _zeta;
-                gbiasz += gerrz * deltat * _zeta;
-                gx -= gbiasx;
-                gy -= gbiasy;
-                gz -= gbiasz;
+                _gbiasx += gerrx * deltat * _zeta;
+                _gbiasy += gerry * deltat * _zeta;
+                _gbiasz += gerrz * deltat * _zeta;
+                gx -= _gbiasx;
+                gy -= _gbiasy;
+                gz -= _gbiasz;
 
                 // Compute the quaternion derivative
                 float qDot1 = -_halfq2 * gx - _halfq3 * gy - _halfq4 * gz;
@@ -336,13 +375,7 @@ namespace hf {
                 q3 += (qDot3 -(_beta * hatDot3)) * deltat;
                 q4 += (qDot4 -(_beta * hatDot4)) * deltat;
 
-                // Normalize the quaternion
-                norm = sqrt(q1 * q1 + q2 * q2 + q3 * q3 + q4 * q4);    // normalise quaternion
-                norm = 1.0f/norm;
-                q1 *= norm;
-                q2 *= norm;
-                q3 *= norm;
-                q4 *= norm;
+                normalize();
             }
 
     }; // class MadgwickQuaternionFilter6DOF
@@ -389,17 +422,17 @@ namespace hf {
                 float q4q4 = q4 * q4;   
 
                 // Normalise accelerometer measurement
-                norm = sqrtf(ax * ax + ay * ay + az * az);
+                norm = ax * ax + ay * ay + az * az;
                 if (norm == 0.0f) return; // handle NaN
-                norm = 1.0f / norm;        // use reciprocal for division
+                norm = FastMath::invSqrt(norm);
                 ax *= norm;
                 ay *= norm;
                 az *= norm;
 
                 // Normalise magnetometer measurement
-                norm = sqrtf(mx * mx + my * my + mz * mz);
+                norm = mx * mx + my * my + mz * mz;
                 if (norm == 0.0f) return; // handle NaN
-                norm = 1.0f / norm;        // use reciprocal for division
+                norm = FastMath::invSqrt(norm);
                 mx *= norm;
                 my *= norm;
                 mz *= norm;
@@ -407,7 +440,7 @@ namespace hf {
                 // Reference direction of Earth's magnetic field
                 hx = 2.0f * mx * (0.5f - q3q3 - q4q4) + 2.0f * my * (q2q3 - q1q4) + 2.0f * mz * (q2q4 + q1q3);
                 hy = 2.0f * mx * (q2q3 + q1q4) + 2.0f * my * (0.5f - q2q2 - q4q4) + 2.0f * mz * (q3q4 - q1q2);
-                bx = sqrtf((hx * hx) + (hy * hy));
+                bx = FastMath::sqrt((hx * hx) + (hy * hy));
                 bz = 2.0f * mx * (q2q4 - q1q3) + 2.0f * my * (q3q4 + q1q2) + 2.0f * mz * (0.5f - q2q2 - q3q3);
 
                 // Estimated direction of gravity and magnetic field
@@ -450,8 +483,7 @@ namespace hf {
                 q4 = pc + (q1 * gz + pa * gy - pb * gx) * (0.5f * deltat);
 
                 // Normalise quaternion
-                norm = sqrtf(q1 * q1 + q2 * q2 + q3 * q3 + q4 * q4);
-                norm = 1.0f / norm;
+                norm = FastMath::invSqrt(q1 * q1 + q2 * q2 + q3 * q3 + q4 * q4);
                 q1 *= norm;
                 q2 *= norm;
                 q3 *= norm;
@@ -0,0 +1,129 @@
+/*
+   Biquad filter for per-sample signal conditioning
+
+   Transposed direct form II: five multiplies per sample and two floats of
+   state.  Coefficients can be changed on the fly (e.g. by a notch tracker)
+   without resetting the state.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <math.h>
+
+#include "fastmath.hpp"
+
+namespace hf {
+
+    class BiquadFilter {
+
+        private:
+
+            static constexpr float TWO_PI = 6.28318531f;
+
+            // Butterworth
+            static constexpr float PT2_Q = 0.70710678f;
+
+            // Pass-through until initialized
+            float _b0 = 1;
+            float _b1 = 0;
+            float _b2 = 0;
+            float _a1 = 0;
+            float _a2 = 0;
+
+            float _z1 = 0;
+            float _z2 = 0;
+
+            // Normalizes by a0 = 1 + alpha
+            void setCoefficients(float b0, float b1, float b2, float a1, float a2, float alpha)
+            {
+                float a0inv = 1 / (1 + alpha);
+
+                _b0 = b0 * a0inv;
+                _b1 = b1 * a0inv;
+                _b2 = b2 * a0inv;
+                _a1 = a1 * a0inv;
+                _a2 = a2 * a0inv;
+            }
+
+        public:
+
+            // First-order low-pass, as a biquad with no second-order terms
+            void initPt1(float cutoffHz, float sampleHz)
+            {
+                float rc = 1 / (TWO_PI * cutoffHz);
+                float k = 1 / (1 + rc * sampleHz);
+
+                _b0 = k;
+                _b1 = 0;
+                _b2 = 0;
+                _a1 = k - 1;
+                _a2 = 0;
+            }
+
+            // Second-order Butterworth low-pass
+            void initPt2(float cutoffHz, float sampleHz)
+            {
+                float sn = 0, cs = 0;
+                FastMath::sincos(TWO_PI * cutoffHz / sampleHz, sn, cs);
+
+                float alpha = sn / (2 * PT2_Q);
+
+                setCoefficients((1 - cs) / 2, 1 - cs, (1 - cs) / 2, -2 * cs, 1 - alpha, alpha);
+            }
+
+            // Band-stop centered on centerHz; higher Q gives a narrower notch
+            void initNotch(float centerHz, float q, float sampleHz)
+            {
+                float sn = 0, cs = 0;
+                FastMath::sincos(TWO_PI * centerHz / sampleHz, sn, cs);
+
+                float alpha = sn / (2 * q);
+
+                setCoefficients(1, -2 * cs, 1, -2 * cs, 1 - alpha, alpha);
+            }
+
+            // Shares one retune across filters of the same frequency, keeping our own state
+            void copyCoefficients(const BiquadFilter & other)
+            {
+                _b0 = other._b0;
+                _b1 = other._b1;
+                _b2 = other._b2;
+                _a1 = other._a1;
+                _a2 = other._a2;
+            }
+
+            void reset(void)
+            {
+                _z1 = 0;
+                _z2 = 0;
+            }
+
+            float apply(float x)
+            {
+                float y = _b0 * x + _z1;
+
+                _z1 = _b1 * x - _a1 * y + _z2;
+                _z2 = _b2 * x - _a2 * y;
+
+                return y;
+            }
+
+    };  // class BiquadFilter
+
+} // namespace hf
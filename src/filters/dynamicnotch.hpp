@@ -0,0 +1,177 @@
+/*
+   Dynamic notch filter that follows the strongest motor-noise peak
+
+   Each axis runs a damped sliding DFT over the bins covering the tracked
+   frequency range, which costs a handful of multiplies per bin per sample
+   and needs no FFT buffers.  Once per window the peak bin is located,
+   refined by parabolic interpolation, and the notch is retuned toward it
+   without resetting the notch state.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+#include "fastmath.hpp"
+#include "filters/biquad.hpp"
+
+namespace hf {
+
+    class DynamicNotch {
+
+        private:
+
+            static constexpr float TWO_PI = 6.28318531f;
+
+            // Window length in samples; bins are sampleHz / SDFT_SIZE apart
+            static const uint8_t SDFT_SIZE = 32;
+            static const uint8_t BIN_COUNT = SDFT_SIZE / 2 + 1;
+
+            // Keeps the sliding DFT stable in single precision
+            static constexpr float DAMPING = 0.9999f;
+
+            // Highest center, as a fraction of the sample rate; a notch at Nyquist is unstable
+            static constexpr float MAX_FRACTION = 0.48f;
+
+            // Fraction of the way the notch moves toward each new peak estimate
+            static constexpr float CENTER_SMOOTHING = 0.3f;
+
+            float _sampleHz = 0;
+            float _minHz = 0;
+            float _maxHz = 0;
+            float _q = 0;
+
+            uint8_t _minBin = 1;
+            uint8_t _maxBin = 1;
+
+            float _twiddleRe[BIN_COUNT] = {};
+            float _twiddleIm[BIN_COUNT] = {};
+
+            // DAMPING^SDFT_SIZE, for removing the sample leaving the window
+            float _dampingN = 0;
+
+            float _window[3][SDFT_SIZE] = {};
+            uint8_t _windowIdx = 0;
+
+            float _re[3][BIN_COUNT] = {};
+            float _im[3][BIN_COUNT] = {};
+
+            float _centerHz[3] = {};
+
+            BiquadFilter _notch[3];
+
+            float power(uint8_t axis, uint8_t bin)
+            {
+                return _re[axis][bin] * _re[axis][bin] + _im[axis][bin] * _im[axis][bin];
+            }
+
+            void retune(uint8_t axis)
+            {
+                uint8_t peak = _minBin;
+                for (uint8_t k=_minBin+1; k<=_maxBin; ++k) {
+                    if (power(axis, k) > power(axis, peak)) {
+                        peak = k;
+                    }
+                }
+
+                // Parabolic interpolation between the neighboring bins
+                float offset = 0;
+                if (peak > _minBin && peak < _maxBin) {
+                    float ym = sqrtf(power(axis, peak-1));
+                    float y0 = sqrtf(power(axis, peak));
+                    float yp = sqrtf(power(axis, peak+1));
+                    float denom = ym - 2 * y0 + yp;
+                    if (denom < 0) {
+                        offset = 0.5f * (ym - yp) / denom;
+                    }
+                }
+
+                float peakHz = (peak + offset) * _sampleHz / SDFT_SIZE;
+                peakHz = peakHz < _minHz ? _minHz : (peakHz > _maxHz ? _maxHz : peakHz);
+
+                _centerHz[axis] += CENTER_SMOOTHING * (peakHz - _centerHz[axis]);
+
+                _notch[axis].initNotch(_centerHz[axis], _q, _sampleHz);
+            }
+
+        public:
+
+            void init(float sampleHz, float minHz, float maxHz, float q)
+            {
+                _sampleHz = sampleHz;
+                _minHz = minHz;
+                _maxHz = maxHz < MAX_FRACTION * sampleHz ? maxHz : MAX_FRACTION * sampleHz;
+                _q = q;
+
+                float binHz = sampleHz / SDFT_SIZE;
+                float minBin = floorf(_minHz / binHz);
+                float maxBin = ceilf(_maxHz / binHz);
+                _minBin = minBin < 1 ? 1 : (uint8_t)minBin;
+                _maxBin = maxBin > SDFT_SIZE / 2 - 1 ? SDFT_SIZE / 2 - 1 : (uint8_t)maxBin;
+
+                for (uint8_t k=0; k<BIN_COUNT; ++k) {
+                    FastMath::sincos(TWO_PI * k / SDFT_SIZE, _twiddleIm[k], _twiddleRe[k]);
+                }
+
+                _dampingN = powf(DAMPING, SDFT_SIZE);
+
+                // Start in the middle of the range until we've seen a full window
+                for (uint8_t axis=0; axis<3; ++axis) {
+                    _centerHz[axis] = (_minHz + _maxHz) / 2;
+                    _notch[axis].initNotch(_centerHz[axis], _q, _sampleHz);
+                }
+            }
+
+            void apply(float values[3])
+            {
+                for (uint8_t axis=0; axis<3; ++axis) {
+
+                    float x = values[axis];
+
+                    float delta = x - _dampingN * _window[axis][_windowIdx];
+                    _window[axis][_windowIdx] = x;
+
+                    for (uint8_t k=_minBin; k<=_maxBin; ++k) {
+                        float re = DAMPING * _re[axis][k] + delta;
+                        float im = DAMPING * _im[axis][k];
+                        _re[axis][k] = re * _twiddleRe[k] - im * _twiddleIm[k];
+                        _im[axis][k] = re * _twiddleIm[k] + im * _twiddleRe[k];
+                    }
+
+                    values[axis] = _notch[axis].apply(x);
+                }
+
+                _windowIdx = (_windowIdx + 1) % SDFT_SIZE;
+
+                if (_windowIdx == 0) {
+                    for (uint8_t axis=0; axis<3; ++axis) {
+                        retune(axis);
+                    }
+                }
+            }
+
+            float getCenterHz(uint8_t axis)
+            {
+                return _centerHz[axis];
+            }
+
+    };  // class DynamicNotch
+
+} // namespace hf
@@ -0,0 +1,104 @@
+/*
+   Single-state exponential smoothing filters
+
+   ExponentialFilter takes its smoothing factor directly.  Pt1Filter is the
+   same filter specified by a cutoff frequency, with the factor worked out
+   from the time step of each update, so it stays correct when samples
+   arrive irregularly.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+namespace hf {
+
+    class ExponentialFilter {
+
+        private:
+
+            float _alpha = 1;
+            float _value = 0;
+
+        public:
+
+            // alpha in (0,1]: the weight given to each new value
+            ExponentialFilter(float alpha)
+            {
+                _alpha = alpha;
+            }
+
+            void reset(float value=0)
+            {
+                _value = value;
+            }
+
+            float update(float value)
+            {
+                _value += _alpha * (value - _value);
+
+                return _value;
+            }
+
+            float get(void)
+            {
+                return _value;
+            }
+
+    };  // class ExponentialFilter
+
+    class Pt1Filter {
+
+        private:
+
+            static constexpr float TWO_PI = 6.28318531f;
+
+            float _rc = 0;
+            float _value = 0;
+
+        public:
+
+            // Passes values through until given a cutoff
+            Pt1Filter(void)
+            {
+            }
+
+            Pt1Filter(float cutoffHz)
+            {
+                setCutoff(cutoffHz);
+            }
+
+            void setCutoff(float cutoffHz)
+            {
+                _rc = 1 / (TWO_PI * cutoffHz);
+            }
+
+            void reset(float value=0)
+            {
+                _value = value;
+            }
+
+            float update(float value, float dt)
+            {
+                _value += dt / (dt + _rc) * (value - _value);
+
+                return _value;
+            }
+
+    };  // class Pt1Filter
+
+} // namespace hf
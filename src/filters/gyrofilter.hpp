@@ -0,0 +1,124 @@
+/*
+   Gyrometer filter chain: optional RPM notches and dynamic notch followed
+   by up to four biquad stages (PT1/PT2 low-pass or static notch), applied
+   in the order they were added.  Everything is sized at compile time.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "filters/biquad.hpp"
+#include "filters/dynamicnotch.hpp"
+#include "filters/rpmfilter.hpp"
+
+namespace hf {
+
+    class GyroFilter {
+
+        private:
+
+            static const uint8_t MAX_STAGES = 4;
+
+            float _sampleHz = 0;
+
+            BiquadFilter _stages[MAX_STAGES][3];
+            uint8_t _stageCount = 0;
+
+            RpmFilter _rpmFilter;
+            bool _useRpmFilter = false;
+
+            DynamicNotch _dynamicNotch;
+            bool _useDynamicNotch = false;
+
+            BiquadFilter * addStage(void)
+            {
+                return _stageCount < MAX_STAGES ? _stages[_stageCount++] : NULL;
+            }
+
+        public:
+
+            // sampleHz is the rate at which the IMU delivers gyro readings
+            GyroFilter(float sampleHz)
+            {
+                _sampleHz = sampleHz;
+            }
+
+            void addPt1(float cutoffHz)
+            {
+                BiquadFilter * stage = addStage();
+                if (!stage) return;
+                for (uint8_t k=0; k<3; ++k) {
+                    stage[k].initPt1(cutoffHz, _sampleHz);
+                }
+            }
+
+            void addPt2(float cutoffHz)
+            {
+                BiquadFilter * stage = addStage();
+                if (!stage) return;
+                for (uint8_t k=0; k<3; ++k) {
+                    stage[k].initPt2(cutoffHz, _sampleHz);
+                }
+            }
+
+            void addNotch(float centerHz, float q)
+            {
+                BiquadFilter * stage = addStage();
+                if (!stage) return;
+                for (uint8_t k=0; k<3; ++k) {
+                    stage[k].initNotch(centerHz, q, _sampleHz);
+                }
+            }
+
+            void useDynamicNotch(float minHz, float maxHz, float q)
+            {
+                _dynamicNotch.init(_sampleHz, minHz, maxHz, q);
+                _useDynamicNotch = true;
+            }
+
+            // Needs motors with RPM telemetry, e.g. bidirectional DShot
+            void useRpmFilter(Motor * motors, uint8_t motorCount, uint8_t harmonics=3, float minHz=100, float q=5)
+            {
+                _rpmFilter.init(_sampleHz, motors, motorCount, harmonics, minHz, q);
+                _useRpmFilter = true;
+            }
+
+            void apply(float values[3])
+            {
+                // Motor noise we know about comes out first, so the dynamic notch can go after what's left
+                if (_useRpmFilter) {
+                    _rpmFilter.apply(values);
+                }
+
+                // The tracker needs to see the noise before the low-pass stages attenuate it
+                if (_useDynamicNotch) {
+                    _dynamicNotch.apply(values);
+                }
+
+                for (uint8_t j=0; j<_stageCount; ++j) {
+                    for (uint8_t k=0; k<3; ++k) {
+                        values[k] = _stages[j][k].apply(values[k]);
+                    }
+                }
+            }
+
+    };  // class GyroFilter
+
+} // namespace hf
@@ -0,0 +1,77 @@
+/*
+   Moving-average (boxcar) filter with a compile-time window
+
+   Storage is exactly the window, and each update is O(1).  The running sum
+   uses Kahan compensation, so it doesn't drift away from the true window
+   sum over long flights.  (This relies on the compiler not reassociating
+   floating-point math, i.e. no -ffast-math.)
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace hf {
+
+    template <uint16_t N>
+    class MovingAverage {
+
+        private:
+
+            float _history[N] = {};
+            uint16_t _index = 0;
+
+            float _sum = 0;
+            float _compensation = 0;
+
+            void accumulate(float value)
+            {
+                float y = value - _compensation;
+                float t = _sum + y;
+                _compensation = (t - _sum) - y;
+                _sum = t;
+            }
+
+        public:
+
+            void reset(void)
+            {
+                for (uint16_t k=0; k<N; ++k) {
+                    _history[k] = 0;
+                }
+                _index = 0;
+                _sum = 0;
+                _compensation = 0;
+            }
+
+            // Until the window fills, the missing samples count as zero
+            float update(float value)
+            {
+                accumulate(value);
+                accumulate(-_history[_index]);
+
+                _history[_index] = value;
+                _index = (_index + 1) % N;
+
+                return _sum / N;
+            }
+
+    };  // class MovingAverage
+
+} // namespace hf
@@ -0,0 +1,195 @@
+/*
+   Smoothing of receiver demands between frames
+
+   Receivers deliver a new frame every 5-22 msec, while the PID controllers run
+   at a few hundred Hz, so without smoothing they see a staircase.  This turns
+   the staircase into a setpoint that changes at every PID iteration, using
+   the frame interval actually measured:
+
+     LINEAR:      ramps from the current output to each new frame over one
+                  frame interval; about half a frame of delay
+     PT1:         one-pole low-pass with a time constant of one frame
+                  interval; smoothest, about one frame of delay
+     FEEDFORWARD: starts from each new frame and extrapolates along the
+                  slope between the last two, over the time actually
+                  between them, for up to one frame interval; no delay,
+                  and a steady derivative for feed-forward
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "datatypes.hpp"
+#include "filters/exponential.hpp"
+
+namespace hf {
+
+    enum {
+        RC_SMOOTHING_NONE,
+        RC_SMOOTHING_LINEAR,
+        RC_SMOOTHING_PT1,
+        RC_SMOOTHING_FEEDFORWARD
+    };
+
+    class RcSmoother {
+
+        private:
+
+            // Throttle, roll, pitch, yaw
+            static const uint8_t CHANNELS = 4;
+
+            // Frame intervals outside this range (seconds) are glitches or lost frames, not the frame rate
+            static constexpr float MIN_INTERVAL = 0.002f;
+            static constexpr float MAX_INTERVAL = 0.05f;
+
+            // Weight of each new frame interval in the running estimate
+            static constexpr float INTERVAL_ALPHA = 0.1f;
+
+            // Typical frame interval, to start from
+            static constexpr float INITIAL_INTERVAL = 0.011f;
+
+            static constexpr float TWO_PI = 6.28318531f;
+
+            uint8_t _mode = RC_SMOOTHING_NONE;
+
+            // Running estimate of the frame interval
+            ExponentialFilter _interval = ExponentialFilter(INTERVAL_ALPHA);
+
+            float _frameTime = 0;
+            float _outputTime = 0;
+
+            // Latest frame, and where each mode starts from and heads
+            float _frame[CHANNELS] = {};
+            float _start[CHANNELS] = {};
+            float _slope[CHANNELS] = {};
+            float _output[CHANNELS] = {};
+
+            // For PT1 mode, with a time constant of one frame interval
+            Pt1Filter _pt1[CHANNELS];
+
+            static void toArray(const demands_t & demands, float values[CHANNELS])
+            {
+                values[0] = demands.throttle;
+                values[1] = demands.roll;
+                values[2] = demands.pitch;
+                values[3] = demands.yaw;
+            }
+
+            static void fromArray(const float values[CHANNELS], demands_t & demands)
+            {
+                demands.throttle = values[0];
+                demands.roll     = values[1];
+                demands.pitch    = values[2];
+                demands.yaw      = values[3];
+            }
+
+        public:
+
+            RcSmoother(void)
+            {
+                _interval.reset(INITIAL_INTERVAL);
+
+                for (uint8_t k=0; k<CHANNELS; ++k) {
+                    _pt1[k].setCutoff(1 / (TWO_PI * INITIAL_INTERVAL));
+                }
+            }
+
+            void setMode(uint8_t mode)
+            {
+                _mode = mode;
+
+                // PT1 picks up from wherever the previous mode left the output
+                for (uint8_t k=0; k<CHANNELS; ++k) {
+                    _pt1[k].reset(_output[k]);
+                }
+            }
+
+            // Call on each new receiver frame
+            void addFrame(const demands_t & demands, float time)
+            {
+                float interval = time - _frameTime;
+
+                if (interval > MIN_INTERVAL && interval < MAX_INTERVAL) {
+                    _interval.update(interval);
+                }
+
+                // The stick moved between the last two frames over the gap between them, not over the
+                // average gap; clamped, so that a glitch or a lost frame can't make the slope blow up
+                float gap = interval < MIN_INTERVAL ? MIN_INTERVAL : (interval > MAX_INTERVAL ? MAX_INTERVAL : interval);
+
+                float frame[CHANNELS];
+                toArray(demands, frame);
+
+                for (uint8_t k=0; k<CHANNELS; ++k) {
+                    if (_mode == RC_SMOOTHING_FEEDFORWARD) {
+                        _start[k] = frame[k];
+                        _slope[k] = (frame[k] - _frame[k]) / gap;
+                    }
+                    else {
+                        _start[k] = _output[k];
+                        _slope[k] = (frame[k] - _output[k]) / _interval.get();
+                    }
+                    _frame[k] = frame[k];
+                    _pt1[k].setCutoff(1 / (TWO_PI * _interval.get()));
+                }
+
+                _frameTime = time;
+            }
+
+            // Call at each PID iteration
+            void get(float time, demands_t & demands)
+            {
+                // Time into the current frame, held after one interval so that a late frame can't make us run away
+                float t = time - _frameTime;
+                if (t > _interval.get()) t = _interval.get();
+
+                float dt = time - _outputTime;
+                _outputTime = time;
+
+                for (uint8_t k=0; k<CHANNELS; ++k) {
+
+                    switch (_mode) {
+
+                        case RC_SMOOTHING_LINEAR:
+                        case RC_SMOOTHING_FEEDFORWARD:
+                            _output[k] = _start[k] + _slope[k] * t;
+                            break;
+
+                        case RC_SMOOTHING_PT1:
+                            if (dt > 0) {
+                                _output[k] = _pt1[k].update(_frame[k], dt);
+                            }
+                            break;
+
+                        default:
+                            _output[k] = _frame[k];
+                    }
+                }
+
+                fromArray(_output, demands);
+            }
+
+            // Measured frame interval in seconds
+            float getInterval(void)
+            {
+                return _interval.get();
+            }
+
+    };  // class RcSmoother
+
+} // namespace hf
@@ -0,0 +1,152 @@
+/*
+   Bank of gyro notches that follow the motors' RPM
+
+   Motor noise sits at each motor's rotation frequency and its harmonics,
+   which the ESCs tell us directly with bidirectional DShot, so there's
+   nothing to search for: each motor gets one notch per harmonic on each
+   axis, centered where the telemetry says.  The motor frequencies are
+   smoothed a little at every sample, and one motor-harmonic's notches are
+   retuned per sample in turn, so the cost per sample stays at one sin/cos
+   however many notches there are.  A notch below minHz, or too close to
+   the Nyquist frequency, is skipped rather than left where it was, and a
+   motor without telemetry leaves its notches out.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "motor.hpp"
+#include "filters/biquad.hpp"
+
+namespace hf {
+
+    class RpmFilter {
+
+        private:
+
+            static constexpr float TWO_PI = 6.28318531f;
+
+            static const uint8_t MAX_MOTORS = 8;
+            static const uint8_t MAX_HARMONICS = 3;
+
+            // Cutoff for smoothing the motor frequencies
+            static constexpr float SMOOTHING_HZ = 150;
+
+            // Highest notch, as a fraction of the sample rate
+            static constexpr float MAX_FRACTION = 0.48f;
+
+            Motor * _motors = NULL;
+            uint8_t _motorCount = 0;
+            uint8_t _harmonics = 0;
+
+            float _sampleHz = 0;
+            float _minHz = 0;
+            float _q = 0;
+            float _smoothing = 0;
+
+            float _motorHz[MAX_MOTORS] = {};
+            bool _motorValid[MAX_MOTORS] = {};
+
+            BiquadFilter _notches[MAX_MOTORS][MAX_HARMONICS][3];
+            bool _active[MAX_MOTORS][MAX_HARMONICS] = {};
+
+            // Next motor and harmonic to retune
+            uint8_t _motor = 0;
+            uint8_t _harmonic = 0;
+
+            void retune(uint8_t m, uint8_t h)
+            {
+                float hz = _motorHz[m] * (h + 1);
+
+                bool wasActive = _active[m][h];
+
+                _active[m][h] = _motorValid[m] && hz >= _minHz && hz <= MAX_FRACTION * _sampleHz;
+
+                if (!_active[m][h]) return;
+
+                // Whatever a skipped notch remembers is stale
+                if (!wasActive) {
+                    for (uint8_t k=0; k<3; ++k) {
+                        _notches[m][h][k].reset();
+                    }
+                }
+
+                _notches[m][h][0].initNotch(hz, _q, _sampleHz);
+                _notches[m][h][1].copyCoefficients(_notches[m][h][0]);
+                _notches[m][h][2].copyCoefficients(_notches[m][h][0]);
+            }
+
+        public:
+
+            /**
+              * sampleHz:  rate at which the IMU delivers gyro readings
+              * motors:    motors reporting RPM through Motor::getRpm()
+              * harmonics: notches per motor, starting at the rotation frequency
+              */
+            void init(float sampleHz, Motor * motors, uint8_t motorCount, uint8_t harmonics, float minHz, float q)
+            {
+                _sampleHz = sampleHz;
+                _motors = motors;
+                _motorCount = motorCount < MAX_MOTORS ? motorCount : MAX_MOTORS;
+                _harmonics = harmonics < MAX_HARMONICS ? harmonics : MAX_HARMONICS;
+                _minHz = minHz;
+                _q = q;
+
+                float dt = 1 / sampleHz;
+                _smoothing = dt / (dt + 1 / (TWO_PI * SMOOTHING_HZ));
+            }
+
+            void apply(float values[3])
+            {
+                for (uint8_t m=0; m<_motorCount; ++m) {
+                    float rpm = 0;
+                    _motorValid[m] = _motors->getRpm(m, rpm);
+                    if (_motorValid[m]) {
+                        _motorHz[m] += _smoothing * (rpm / 60 - _motorHz[m]);
+                    }
+                }
+
+                if (_motorCount == 0 || _harmonics == 0) return;
+
+                retune(_motor, _harmonic);
+
+                if (++_harmonic == _harmonics) {
+                    _harmonic = 0;
+                    _motor = (_motor + 1) % _motorCount;
+                }
+
+                for (uint8_t m=0; m<_motorCount; ++m) {
+                    for (uint8_t h=0; h<_harmonics; ++h) {
+                        if (!_active[m][h]) continue;
+                        for (uint8_t k=0; k<3; ++k) {
+                            values[k] = _notches[m][h][k].apply(values[k]);
+                        }
+                    }
+                }
+            }
+
+            float getMotorHz(uint8_t index)
+            {
+                return _motorHz[index];
+            }
+
+    };  // class RpmFilter
+
+} // namespace hf
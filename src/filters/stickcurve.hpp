@@ -0,0 +1,64 @@
+/*
+   Stick curves
+
+   Both the expo/rate curve for roll and pitch and the throttle curve are odd
+   cubics, x * (a + b * x^2), so we precompute the two coefficients whenever
+   the parameters change instead of evaluating the original formulas on every
+   frame.  This is exact, takes no divisions or branches, and is cheaper
+   than a lookup table with interpolation.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace hf {
+
+    class StickCurve {
+
+        private:
+
+            float _a = 1;
+            float _b = 0;
+
+        public:
+
+            // Cubic expo: full-stick value scale, with expo in [0,1] moving weight from the linear term to the cubic
+            void setExpo(float expo, float scale=1)
+            {
+                _a = (1 - expo) * scale;
+                _b = expo * scale;
+            }
+
+            float get(float x) const
+            {
+                return x * (_a + _b * x*x);
+            }
+
+            // Several channels through the same curve at once; in and out may be the same array
+            void get(const float * in, float * out, uint8_t count) const
+            {
+                for (uint8_t k=0; k<count; ++k) {
+                    out[k] = get(in[k]);
+                }
+            }
+
+    };  // class StickCurve
+
+} // namespace hf
@@ -25,6 +25,12 @@
 #include "imu.hpp"
 #include "board.hpp"
 #include "receiver.hpp"
+#include "attitude.hpp"
+#include "calibration.hpp"
+#include "parameters.hpp"
+#include "linkquality.hpp"
+#include "failsafe.hpp"
+#include "arming.hpp"
 #include "datatypes.hpp"
 #include "pidcontroller.hpp"
 #include "motor.hpp"
@@ -32,7 +38,11 @@
 #include "sensors/surfacemount.hpp"
 #include "timertasks/pidtask.hpp"
 #include "timertasks/serialtask.hpp"
+#include "timertasks/estimatortask.hpp"
+#include "estimators/complementary.hpp"
 #include "sensors/surfacemount/gyrometer.hpp"
+#include "sensors/surfacemount/accelerometer.hpp"
+#include "sensors/surfacemount/barometer.hpp"
 #include "sensors/surfacemount/quaternion.hpp"
 #include "loggingfunctions.hpp"
 #include "update_scheduler.hpp"
@@ -43,8 +53,6 @@ namespace hf {
 
         private:
 
-            static constexpr float MAX_ARMING_ANGLE_DEGREES = 25.0f;
-
             // Supports periodic ad-hoc debugging
             Debugger _debugger;
 
@@ -52,8 +60,19 @@ namespace hf {
             Sensor * _sensors[256] = {NULL};
             uint8_t _sensor_count = 0;
 
+            // Sensor calibration, learned in the background while disarmed
+            Calibration _calibration;
+            bool _wasArmed = false;
+
+            // Tunable parameters, settable from the GCS
+            Parameters _parameters;
+
             // Safety
-            bool _safeToArm = false;
+            Arming _arming;
+            LinkQuality _linkQuality;
+
+            // Armed status last shown on the LED
+            bool _armedShown = false;
 
             // Support for headless mode
             float _yawInitial = 0;
@@ -68,14 +87,18 @@ namespace hf {
             // Serial timer task for GCS
             SerialTask _serialTask;
 
+            // Fuses sensor measurements into the vehicle state at a fixed rate
+            ComplementaryEstimator _defaultEstimator;
+            StateEstimator * _estimator = &_defaultEstimator;
+            EstimatorTask _estimatorTask;
+
              // Mandatory sensors on the board
             Gyrometer _gyrometer;
             Quaternion _quaternion; // not really a sensor, but we treat it like one!
 
-            bool safeAngle(uint8_t axis)
-            {
-                return fabs(_state.rotation[axis]) < Filter::deg2rad(MAX_ARMING_ANGLE_DEGREES);
-            }
+            // For altitude estimation; never ready on IMUs that don't report raw acceleration or pressure
+            Accelerometer _accelerometer;
+            Barometer _barometer;
 
             Board    * _board    = NULL;
             Receiver * _receiver = NULL;
@@ -86,6 +109,19 @@ namespace hf {
             // Vehicle state
             state_t _state;
 
+            void checkCalibration(void)
+            {
+                _calibration._armed = _state.armed;
+
+                // Save what we learned before the flight once it's over, so we don't wear out the storage.
+                // A failsafe disarm may mean a crash, so after one nothing more is saved until reboot.
+                if (_wasArmed && !_state.armed && !_state.failsafe) {
+                    _calibration.save(_board);
+                }
+
+                _wasArmed = _state.armed;
+            }
+
             void checkSensors(void)
             {
                 for (uint8_t k=0; k<_sensor_count; ++k) {
@@ -93,7 +129,7 @@ namespace hf {
                     float time = _board->getTime();
                     if (sensor->ready(time)) {
                         printTaskTime(k+2, true);
-                        sensor->modifyState(_state, time);
+                        sensor->poll(time);
                         printTaskTime(k+2, false);
                         _update_scheduler.task_completed(k+2);
                     }
@@ -103,6 +139,10 @@ namespace hf {
             void add_sensor(Sensor * sensor)
             {
                 _sensors[_sensor_count++] = sensor;
+
+                _update_scheduler.add_task();
+
+                _estimator->addSensor(sensor);
             }
 
             void add_sensor(SurfaceMountSensor * sensor, IMU * imu) 
@@ -110,6 +150,7 @@ namespace hf {
                 add_sensor(sensor);
 
                 sensor->imu = imu;
+                sensor->calibration = &_calibration;
             }
 
             void add_sensor(SurfaceMountSensor* sensor, IMU* imu, unsigned int sensor_frequency)
@@ -135,64 +176,105 @@ namespace hf {
 
                 // Initialize state
                 memset(&_state, 0, sizeof(state_t));
+                Attitude::setQuaternion(_state, 1, 0, 0, 0);
+
+                // Start from the parameters saved last time, if any
+                _parameters.load(board);
 
                 // Initialize the receiver
+                _receiver->_parameters = &_parameters._values;
+                _receiver->_vehicleState = &_state;
+                _receiver->updateCurves();
                 _receiver->begin();
 
                 // Setup failsafe
                 _state.failsafe = false;
 
-                _update_scheduler.init(2, 1520, _receiver);
+                _arming.init(&_state);
+
+                // Sensor tasks are added along with the sensors
+                _update_scheduler.init(0, 1520, _receiver);
 
                 // Initialize timer task for PID controllers
-                _pidTask.init(_board, _receiver, _mixer, &_state, &_update_scheduler);
+                _pidTask.init(_board, _receiver, _mixer, &_state, &_parameters, &_update_scheduler);
             }
 
-            void checkReceiver(void)
+            void checkFailsafe(bool gotFrame)
             {
-                // Sync failsafe to receiver
-                if (_receiver->lostSignal() && _state.armed) {
-                    _mixer->cut();
-                    _state.armed = false;
-                    Debugger::printf("Disarmed\n");
+                float time = _board->getTime();
+
+                if (gotFrame) {
+                    _linkQuality.addFrame(time);
+                    uint8_t percent = 0;
+                    if (_receiver->linkQuality(percent)) {
+                        _linkQuality.addReported(percent);
+                    }
+                }
+
+                Failsafe & failsafe = _pidTask._failsafe;
+
+                bool linkGood = !_receiver->lostSignal() && 
+                                _linkQuality.timeSinceFrame(time) < failsafe._config.signalTimeout &&
+                                _linkQuality.get() >= failsafe._config.minLinkQuality;
+
+                failsafe.update(time, linkGood, _state.armed, _receiver->throttleIsDown());
+
+                if (failsafe._stage == FAILSAFE_DISARM) {
+                    _arming.failsafe();
                     _state.failsafe = true;
-                    _board->showArmedStatus(false);
-                    return;
                 }
+            }
 
+            void checkReceiver(void)
+            {
                 // Check whether receiver data is available
-                if (!_receiver->getDemands(_state.rotation[AXIS_YAW] - _yawInitial)) return;
+                // Only headless mode needs the yaw angle
+                float yawOffset = _receiver->headless ? Attitude::getEulerAngles(_state)[AXIS_YAW] - _yawInitial : 0;
+                bool gotFrame = _receiver->getDemands(yawOffset);
 
-                // Disarm
-                if (_state.armed && !_receiver->getAux1State()) {
-                    _state.armed = false;
-                    Debugger::printf("Disarmed\n");
-                } 
+                // Sync failsafe to receiver
+                checkFailsafe(gotFrame);
 
-                // Avoid arming if aux1 switch down on startup
-                if (!_safeToArm) {
-                    _safeToArm = !_receiver->getAux1State();
-                }
+                if (!gotFrame) return;
 
-                // Arm (after lots of safety checks!)
-                if (_safeToArm && !_state.armed && _receiver->throttleIsDown() && _receiver->getAux1State() && 
-                        !_state.failsafe && safeAngle(AXIS_ROLL) && safeAngle(AXIS_PITCH)) {
-                    _state.armed = true;
-                    Debugger::printf("Armed\n");
-                    _yawInitial = _state.rotation[AXIS_YAW]; // grab yaw for headless mode
-                }
+                _pidTask._rcSmoother.addFrame(_receiver->demands, _board->getTime());
+
+                bool throttleDown = _receiver->throttleIsDown();
 
                 // Cut motors on throttle-down
-                if (_state.armed && _receiver->throttleIsDown()) {
+                if (_state.armed && throttleDown && !_arming._throttleDown) {
                     _mixer->cut();
                 }
 
-                // Set LED based on arming status
-                _board->showArmedStatus(_state.armed);
+                // The angle limit only matters while disarmed
+                if (!_state.armed) {
+                    _arming.updateAngles(Attitude::getEulerAngles(_state));
+                }
+
+                _arming.update(_receiver->getAux1State() != 0, throttleDown);
 
                 printTaskTime(1000, false);
             } // checkReceiver
 
+            // Arming can change from the receiver, the failsafe or the GCS
+            void checkArming(void)
+            {
+                if (_state.armed == _armedShown) return;
+
+                _armedShown = _state.armed;
+
+                if (_state.armed) {
+                    Debugger::printf("Armed\n");
+                    _yawInitial = Attitude::getEulerAngles(_state)[AXIS_YAW]; // grab yaw for headless mode
+                }
+                else {
+                    _mixer->cut();
+                    Debugger::printf("Disarmed\n");
+                }
+
+                _board->showArmedStatus(_state.armed);
+            }
+
         public:
 
             void init(Board * board, IMU * imu, Receiver * receiver, Mixer * mixer, Motor * motors, bool armed=false)
@@ -202,18 +284,28 @@ namespace hf {
 
                 // Store pointers to IMU, mixer
                 _imu   = imu;
+
+                // Start from the calibration saved last time, if any
+                _calibration.load(board);
+                imu->_calibration = &_calibration._values;
                 _mixer = mixer;
 
                 // Initialize serial timer task
-                _serialTask.init(board, &_state, receiver, mixer, &_update_scheduler);
+                _serialTask.init(board, &_state, receiver, mixer, &_parameters, &_pidTask, &_arming, &_update_scheduler);
+
+                // Initialize state-estimator timer task
+                _estimatorTask.init(board, _estimator, &_state);
+                _serialTask.useEstimatorHealth(_estimator->getHealth());
 
                 // Support safety override by simulator
                 _state.armed = armed;
 
                 // Support for mandatory sensors
                 // frequencies from usfs.hpp
-                add_sensor(&_quaternion, imu, 66);
+                add_sensor(&_quaternion, imu, 330);
                 add_sensor(&_gyrometer, imu, 330);
+                add_sensor(&_accelerometer, imu);
+                add_sensor(&_barometer, imu, 50);
 
                 // Start the IMU
                 imu->begin();
@@ -228,9 +320,67 @@ namespace hf {
                 add_sensor(sensor);
             }
 
+            // Other surface-mount sensors (e.g. magnetometer) read from the IMU passed to init()
+            void addSensor(SurfaceMountSensor * sensor) 
+            {
+                add_sensor(sensor, _imu);
+            }
+
+            // Replaces the default complementary-filter estimator; call after init()
+            void useEstimator(StateEstimator * estimator)
+            {
+                _estimator = estimator;
+
+                // The new estimator consumes the queues of any sensors already added
+                for (uint8_t k=0; k<_sensor_count; ++k) {
+                    _estimator->addSensor(_sensors[k]);
+                }
+
+                _estimatorTask.init(_board, _estimator, &_state);
+                _serialTask.useEstimatorHealth(_estimator->getHealth());
+            }
+
+            // Filters every gyro reading before the estimator sees it
+            void useGyroFilter(GyroFilter * filter)
+            {
+                _gyrometer._filter = filter;
+            }
+
+            // RC_SMOOTHING_NONE (the default), RC_SMOOTHING_LINEAR, RC_SMOOTHING_PT1 or RC_SMOOTHING_FEEDFORWARD
+            void useRcSmoothing(uint8_t mode)
+            {
+                _pidTask._rcSmoother.setMode(mode);
+            }
+
+            // Replaces the default failsafe timing and thresholds
+            void setFailsafe(const failsafe_config_t & config)
+            {
+                _pidTask._failsafe._config = config;
+            }
+
+            float getLinkQuality(void)
+            {
+                return _linkQuality.get();
+            }
+
             void addPidController(PidController * pidController, uint8_t auxState=0) 
             {
                 _pidTask.addPidController(pidController, auxState);
+
+                // Gains saved from the GCS override the ones the sketch passed in.  Otherwise the sketch's
+                // are copied in for the GCS to read; they're saved along with any other parameter, but
+                // never take over from the gains in a later build of the sketch.
+                uint8_t id = pidController->gainsId();
+                uint8_t count = 0;
+                float * gains = _parameters.gains(id, count);
+                if (gains) {
+                    if (_parameters.hasGcsGains(id)) {
+                        pidController->stageGains(gains, count);
+                    }
+                    else {
+                        pidController->getGains(gains);
+                    }
+                }
             }
 
             void update(void)
@@ -243,13 +393,24 @@ namespace hf {
 
                 // Grab control signal if available
                 checkReceiver();
-
-                // Update PID controllers task
-                _pidTask.update();
+                checkArming();
 
                 // Check sensors
+                checkCalibration();
                 checkSensors();
 
+                // Fuse sensor measurements into vehicle state, and fuse everything queued so far just
+                // before the PID controllers run, so the gyro reading doesn't wait out an estimator period
+                if (_pidTask.due()) {
+                    _estimatorTask.run();
+                }
+                else {
+                    _estimatorTask.update();
+                }
+
+                // Update PID controllers task
+                _pidTask.update();
+
                 // Update serial comms task
                 _serialTask.update();
 
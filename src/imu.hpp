@@ -20,6 +20,8 @@
 
 #pragma once
 
+#include "datatypes.hpp"
+
 namespace hf {
 
     class IMU {
@@ -37,9 +39,15 @@ namespace hf {
         friend class Hackflight;
         friend class Quaternion;
         friend class Gyrometer;
+        friend class Accelerometer;
+        friend class Magnetometer;
+        friend class Barometer;
 
         protected:
 
+            // Set by Hackflight, for IMUs that fuse raw readings themselves (see Calibration)
+            const calibration_t * _calibration = NULL;
+
             // Core functionality
             virtual bool getQuaternion(float & qw, float & qx, float & qy, float & qz, float time) = 0;
             virtual bool getGyrometer(float & gx, float & gy, float & gz) = 0;
@@ -47,7 +55,6 @@ namespace hf {
             // Adjustment for non-standard mounting
             virtual void adjustGyrometer(float & x, float & y, float & z) { (void)x; (void)y; (void)z; }
             virtual void adjustQuaternion(float & w, float & x, float & y, float & z) { (void)w; (void)x; (void)y; (void)z;  }
-            virtual void adjustEulerAngles(float & x, float & y, float & z) { (void)x; (void)y; (void)z; }
 
 
             // Required by some IMUs
@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include "calibration.hpp"
 #include "filters.hpp"
 #include "imu.hpp"
 
@@ -35,12 +36,30 @@ namespace hf {
             const float GYRO_MEAS_ERROR_DEG = 20.f;
             const float GYRO_MEAS_DRIFT_DEG =  0.f;
 
-            // Update quaternion after this number of gyro updates
+            // Correct the gyro-integrated quaternion with the accelerometer after this number of gyro updates
             const uint8_t QUATERNION_DIVISOR = 5;
 
-            // Supports computing quaternion after a certain number of IMU readings
+            // Ignore gaps longer than this (startup, blocked loop) when integrating
+            static constexpr float MAX_DT = 0.1f;
+
+            // Supports running the accelerometer correction after a certain number of IMU readings
             uint8_t _quatCycleCount = 0;
 
+            // Set when imuReadAccelGyro() has given us a sample the quaternion hasn't seen yet
+            bool _gotNewSample = false;
+
+            // Same, for the Accelerometer sensor
+            bool _gotNewAccel = false;
+
+            // Time of the previous gyro integration, and time accumulated since the previous correction
+            float _sampleTime = 0;
+            float _correctionTime = 0;
+
+            // Accelerometer readings are averaged over each correction period
+            float _axSum = 0;
+            float _aySum = 0;
+            float _azSum = 0;
+
             // Params passed to Madgwick quaternion constructor
             const float _beta = sqrtf(3.0f / 4.0f) * Filter::deg2rad(GYRO_MEAS_ERROR_DEG);
             const float _zeta = sqrtf(3.0f / 4.0f) * Filter::deg2rad(GYRO_MEAS_DRIFT_DEG);  
@@ -71,37 +90,75 @@ namespace hf {
 
                     imuReadAccelGyro(_ax, _ay, _az, _gx, _gy, _gz);
 
+                    _gotNewSample = true;
+                    _gotNewAccel = true;
+
                     return true;
                 }
 
                 return false;
             }
 
+            // The raw reading that came with the latest gyro sample, once per sample
+            bool getAccelerometer(float & ax, float & ay, float & az) override
+            {
+                if (!_gotNewAccel) return false;
+                _gotNewAccel = false;
+
+                ax = _ax;
+                ay = _ay;
+                az = _az;
+
+                return true;
+            }
+
             bool getQuaternion(float & qw, float & qx, float & qy, float & qz, float time) override
             {
-                // Update quaternion after some number of IMU readings
-                _quatCycleCount = (_quatCycleCount + 1) % QUATERNION_DIVISOR;
+                // Integrate each gyro sample exactly once
+                if (!_gotNewSample) return false;
+                _gotNewSample = false;
 
-                if (_quatCycleCount == 0) {
+                float deltat = time - _sampleTime;
+                _sampleTime = time;
 
-                    // Set integration time by time elapsed since last filter update
-                    static float _time;
-                    float deltat = time - _time;
-                    _time = time;
+                if (deltat <= 0 || deltat > MAX_DT) return false;
 
-                    // Run the quaternion on the IMU values acquired in imuReadAccelGyro()                   
-                    _quaternionFilter.update(_ax, _ay, _az, _gx, _gy, _gz, deltat); 
+                // The Gyrometer sensor corrects its own copy of these readings
+                float gx = _gx, gy = _gy, gz = _gz;
+                float ax = _ax, ay = _ay, az = _az;
+                if (_calibration) {
+                    Calibration::applyGyrometer(*_calibration, gx, gy, gz);
+                    Calibration::applyAccelerometer(*_calibration, ax, ay, az);
+                }
 
-                    // Copy the quaternion back out
-                    qw = _quaternionFilter.q1;
-                    qx = _quaternionFilter.q2;
-                    qy = _quaternionFilter.q3;
-                    qz = _quaternionFilter.q4;
+                // Cheap gyro integration on every sample
+                _quaternionFilter.integrateGyro(gx, gy, gz, deltat);
 
-                    return true;
+                _axSum += ax;
+                _aySum += ay;
+                _azSum += az;
+                _correctionTime += deltat;
+
+                // Expensive accelerometer correction after some number of samples
+                _quatCycleCount = (_quatCycleCount + 1) % QUATERNION_DIVISOR;
+
+                if (_quatCycleCount == 0) {
+
+                    _quaternionFilter.correctAccel(_axSum, _aySum, _azSum, _correctionTime);
+
+                    _axSum = 0;
+                    _aySum = 0;
+                    _azSum = 0;
+                    _correctionTime = 0;
                 }
 
-                return false;
+                // Copy the quaternion back out
+                qw = _quaternionFilter.q1;
+                qx = _quaternionFilter.q2;
+                qy = _quaternionFilter.q3;
+                qz = _quaternionFilter.q4;
+
+                return true;
             }
 
     }; // class SoftwareQuaternionIMU
@@ -36,17 +36,12 @@ namespace hf {
                 y = -tmp;
             }
 
+            // Also negates roll and pitch
             virtual void adjustQuaternion(float & w, float & x, float & y, float & z) override
             {
                 float tmp = x;
-                x = -y;
-                y = tmp;
-            }
-
-            virtual void adjustEulerAngles(float & x, float & y, float & z) override
-            {
-                x = -x;
-                y = -y;
+                x = y;
+                y = -tmp;
             }
 
     }; // class USFS_Rotated
@@ -68,27 +68,74 @@ namespace hf {
                         LIS2MDL_MAG_LPF_ODR, LPS22HB_BARO_LPF,
                         MAG_V, MAG_H, MAG_DECLINATION);
 
+            // The gyro read clears the data-ready status, so it keeps the accelerometer and
+            // barometer readings that come with it until their sensors ask for them
+            float _acc[3] = {};
+            float _pressure = 0;
+            bool _gotAcc = false;
+            bool _gotPressure = false;
+
+            void gotPressure(float hpa)
+            {
+                _pressure = hpa * 100; // pascals
+                _gotPressure = true;
+            }
 
         protected:
 
             virtual bool getGyrometer(float & gx, float & gy, float & gz) override
             {
+                float gyro[3] = {};
+                float mag[3] = {};
+                float hpa = 0;
+
                 switch (_usfsmax.dataReady()) {
                     case USFSMAX::DATA_READY_GYRO_ACC:
+                        _usfsmax.readGyroAcc(gyro, _acc);
+                        break;
                     case USFSMAX::DATA_READY_GYRO_ACC_MAG_BARO:
-                        {
-                            float gyro[3] = {};
-                            float acc[3] = {};
-                            _usfsmax.readGyroAcc(gyro, acc);
-                            gx = gyro[0];
-                            gy = gyro[1];
-                            gz = gyro[2];
-                        }
-                        return true;
-                    default:
+                        _usfsmax.readGyroAccMagBaro(gyro, _acc, mag, hpa);
+                        gotPressure(hpa);
                         break;
+                    case USFSMAX::DATA_READY_MAG_BARO:
+                        _usfsmax.readMagBaro(mag, hpa);
+                        gotPressure(hpa);
+                        return false;
+                    default:
+                        return false;
                 }
-                return false;
+
+                _gotAcc = true;
+
+                gx = gyro[0];
+                gy = gyro[1];
+                gz = gyro[2];
+
+                return true;
+            }
+
+            virtual bool getAccelerometer(float & ax, float & ay, float & az) override
+            {
+                if (!_gotAcc) return false;
+
+                _gotAcc = false;
+
+                ax = _acc[0];
+                ay = _acc[1];
+                az = _acc[2];
+
+                return true;
+            }
+
+            virtual bool getBarometer(float & pressure) override
+            {
+                if (!_gotPressure) return false;
+
+                _gotPressure = false;
+
+                pressure = _pressure;
+
+                return true;
             }
 
             virtual bool getQuaternion(float & qw, float & qx, float & qy, float & qz, float time) override
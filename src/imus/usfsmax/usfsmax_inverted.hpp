@@ -33,11 +33,15 @@ namespace hf {
                 z = -z;
             }
 
-            virtual void adjustEulerAngles(float & x, float & y, float & z) override
+            // Rolls by pi and negates pitch and yaw
+            virtual void adjustQuaternion(float & w, float & x, float & y, float & z) override
             { 
-                x = -(M_PI - x);
-                y = -y;
-                z = -z;
+                float tmpw = w;
+                float tmpy = y;
+                w = x;
+                x = -tmpw;
+                y = z;
+                z = -tmpy;
             }
 
      }; // class USFSMAX_Inverted
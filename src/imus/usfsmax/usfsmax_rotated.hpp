@@ -33,10 +33,13 @@ namespace hf {
                 y = -y;
             }
 
-            virtual void adjustEulerAngles(float & x, float & y, float & z) override
+            // Negates pitch and yaw
+            virtual void adjustQuaternion(float & w, float & x, float & y, float & z) override
             { 
+                (void)w;
+                (void)x;
                 y = -y;
-                z = 2*M_PI - z;
+                z = -z;
             }
 
      }; // class USFSMAX_Rotated
@@ -0,0 +1,159 @@
+/*
+   Receiver link-quality estimator
+
+   Learns the receiver's frame interval, infers how many frames went missing
+   from each gap between frames, and keeps a running fraction of frames
+   received.  The interval starts from the median of the first few gaps,
+   so that one odd gap at startup can't make every later one look like
+   lost frames, and a run of gaps that agree with each other but not with
+   the estimate replaces it.  Receivers that report their own link quality
+   (e.g., CRSF) can only make the estimate worse, never better.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+
+namespace hf {
+
+    class LinkQuality {
+
+        friend class Hackflight;
+
+        private:
+
+            // Weight of each expected frame in the running quality, about the last 20 frames
+            static constexpr float QUALITY_ALPHA = 0.05f;
+
+            // Weight of each new frame interval in the running estimate
+            static constexpr float INTERVAL_ALPHA = 0.1f;
+
+            // A gap longer than this many frames is a lost link, not lost frames; the timeout takes care of it
+            static const uint8_t MAX_MISSED = 50;
+
+            // Gaps whose median gives the first interval estimate
+            static const uint8_t SEED_GAPS = 5;
+
+            // Consecutive gaps within AGREEMENT of each other that override the estimate.  Random
+            // loss almost never repeats the same gap this many times.
+            static const uint8_t AGREEING_GAPS = 10;
+            static constexpr float AGREEMENT = 0.1f;
+
+            float _interval = 0;
+            float _frameTime = 0;
+            bool _started = false;
+
+            // First gaps, in increasing order
+            float _seed[SEED_GAPS] = {};
+            uint8_t _seedCount = 0;
+
+            float _lastGap = 0;
+            uint8_t _agreeing = 0;
+
+            float _quality = 1;
+            float _reported = 1;
+
+            uint32_t _frames = 0;
+            uint32_t _missed = 0;
+
+            void addFrame(float time)
+            {
+                float interval = time - _frameTime;
+                _frameTime = time;
+
+                if (!_started) {
+                    _started = true;
+                    return;
+                }
+
+                _agreeing = fabsf(interval - _lastGap) < AGREEMENT * _lastGap ? _agreeing + 1 : 0;
+                _lastGap = interval;
+
+                if (_seedCount < SEED_GAPS) {
+                    uint8_t k = _seedCount++;
+                    for (; k>0 && _seed[k-1]>interval; --k) {
+                        _seed[k] = _seed[k-1];
+                    }
+                    _seed[k] = interval;
+                    if (_seedCount == SEED_GAPS) {
+                        _interval = _seed[SEED_GAPS/2];
+                    }
+                    _frames++;
+                    return;
+                }
+
+                // Frames we should have had since the last one, including this one
+                uint32_t expected = (uint32_t)(interval / _interval + 0.5f);
+
+                // Only an interval with no frames missing tells us the frame rate
+                if (expected <= 1) {
+                    _interval += INTERVAL_ALPHA * (interval - _interval);
+                    expected = 1;
+                }
+
+                // ... unless the estimate itself is wrong
+                else if (_agreeing >= AGREEING_GAPS) {
+                    _interval = interval;
+                    expected = 1;
+                }
+
+                for (uint32_t k=1; k<expected && k<MAX_MISSED; ++k) {
+                    _quality *= 1 - QUALITY_ALPHA;
+                }
+
+                _quality += QUALITY_ALPHA * (1 - _quality);
+
+                _frames++;
+                _missed += expected - 1;
+            }
+
+            // Link quality in percent, from receivers that report it
+            void addReported(uint8_t percent)
+            {
+                _reported = percent / 100.f;
+            }
+
+        public:
+
+            // In [0,1]
+            float get(void)
+            {
+                return _quality < _reported ? _quality : _reported;
+            }
+
+            float timeSinceFrame(float time)
+            {
+                return _started ? time - _frameTime : 0;
+            }
+
+            // Measured frame interval in seconds, or zero before we have one
+            float getInterval(void)
+            {
+                return _interval;
+            }
+
+            uint32_t getMissedFrames(void)
+            {
+                return _missed;
+            }
+
+    };  // class LinkQuality
+
+} // namespace hf
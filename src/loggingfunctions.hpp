@@ -1,3 +1,9 @@
+/*
+   Task timing log, buffered and written to Serial in blocks.  Define
+   HF_NO_TASK_LOG before including any Hackflight header to turn it off,
+   as the host tests do.
+ */
+
 #pragma once
 
 #include "debugger.hpp"
@@ -10,6 +16,10 @@ namespace hf {
     va_list ap;
 
     static void print_string(const char * fmt, ...){
+#ifdef HF_NO_TASK_LOG
+        (void)fmt;
+        return;
+#endif
         va_start(ap, fmt);
         
         int size = vsnprintf(&buf[index], 200, fmt, ap);
@@ -17,9 +27,9 @@ namespace hf {
         index += size;
 
         if(index >= 29800){
-            printf("Writing to serial started at,%d\n", micros());
+            printf("Writing to serial started at,%lu\n", micros());
             Serial.write(buf, index);
-            printf("Writing to serial completed at,%d\n", micros());
+            printf("Writing to serial completed at,%lu\n", micros());
             index = 0;
         }
         va_end(ap);
@@ -28,9 +38,9 @@ namespace hf {
     void printTaskTime(int task_id, bool task_start)
     {
         if (task_start)
-            print_string("Task,%d,started at time,%ld\n", task_id, micros());
+            print_string("Task,%d,started at time,%lu\n", task_id, micros());
         else
-            print_string("Task,%d,terminated at time,%ld\n", task_id, micros());
+            print_string("Task,%d,terminated at time,%lu\n", task_id, micros());
     }
 }
 
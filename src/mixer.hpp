@@ -43,21 +43,9 @@ namespace hf {
             // Arbitrary
             static const uint8_t MAXMOTORS = 20;
 
-            float _motorsPrev[MAXMOTORS] = {0};
-
-            void writeMotor(uint8_t index, float value)
+            void writeMotors(const float * values)
             {
-                _motors->write(index, value);
-            }
-
-            void safeWriteMotor(uint8_t index, float value)
-            {
-                // Avoid sending the motor the same value over and over
-                if (_motorsPrev[index] != value) {
-                    writeMotor(index, value);
-                }
-
-                _motorsPrev[index] = value;
+                _motors->writeAll(values, _nmotors);
             }
 
         protected:
@@ -70,10 +58,9 @@ namespace hf {
             {
                 _nmotors = nmotors;
 
-                // set disarmed, previous motor values
+                // set disarmed motor values
                 for (uint8_t i = 0; i < nmotors; i++) {
                     motorsDisarmed[i] = 0;
-                    _motorsPrev[i] = 0;
                 }
 
             }
@@ -93,9 +80,7 @@ namespace hf {
             // This is how we can spin the motors from the GCS
             void runDisarmed(void)
             {
-                for (uint8_t i = 0; i < _nmotors; i++) {
-                    safeWriteMotor(i, motorsDisarmed[i]);
-                }
+                writeMotors(motorsDisarmed);
             }
 
             // This helps support servos
@@ -107,9 +92,9 @@ namespace hf {
 
             void cut(void)
             {
-                for (uint8_t i = 0; i < _nmotors; i++) {
-                    writeMotor(i, 0);
-                }
+                float zeros[MAXMOTORS] = {0};
+
+                writeMotors(zeros);
             }
 
         public:
@@ -147,9 +132,7 @@ namespace hf {
                     motorvals[i] = constrainMotorValue(i, motorvals[i]);
                 }
 
-                for (uint8_t i = 0; i < _nmotors; i++) {
-                    safeWriteMotor(i, motorvals[i]);
-                }
+                writeMotors(motorvals);
             }
 
     }; // class Mixer
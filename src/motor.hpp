@@ -35,6 +35,9 @@ namespace hf {
             uint8_t _pins[MAX_COUNT];
             uint8_t _count = 0;
 
+            // Last value written to each motor; they start out stopped
+            float _written[MAX_COUNT] = {};
+
             Motor(const uint8_t count) 
             {
                 _count = count;
@@ -54,6 +57,26 @@ namespace hf {
 
             virtual void write(uint8_t index, float value) = 0;
 
+            // Writes all the motors at once.  This default writes the ones that changed, one at
+            // a time; override it for protocols that can update every channel in one transaction.
+            virtual void writeAll(const float * values, uint8_t count)
+            {
+                for (uint8_t k=0; k<count; ++k) {
+                    if (values[k] != _written[k]) {
+                        write(k, values[k]);
+                        _written[k] = values[k];
+                    }
+                }
+            }
+
+            // Mechanical RPM reported by the ESC, for motors that have telemetry
+            virtual bool getRpm(uint8_t index, float & rpm)
+            {
+                (void)index;
+                (void)rpm;
+                return false;
+            }
+
     }; // class Motor
 
 } // namespace hf
@@ -0,0 +1,343 @@
+/*
+   DShot digital ESC protocol
+
+   Each frame is 16 bits, sent MSB first: an 11-bit value (0 = stop, 1-47 =
+   commands, 48-2047 = throttle), a telemetry-request bit, and a 4-bit CRC.
+   Every bit takes the same time; a one is high for 3/4 of it and a zero
+   for 3/8.  There's no analog timing for the ESC to calibrate, and a frame
+   takes 107/53/27 usec at DShot150/300/600, so the refresh rate is set by
+   the flight loop rather than by a 50-490 Hz PWM period.
+
+   This class is hardware-agnostic: it turns the motor values into a buffer
+   of timer compare values, one per bit per motor, interleaved so that a
+   single DMA transfer clocked by the timer's update event writes all the
+   motors' compare registers at once.  Two zero slots at the end hold the
+   lines low between frames.  A board subclass sets up the timer (period
+   getBitTicks()) and implements transfer() to start the DMA.  writeAll()
+   sends a frame with every mixer update, so all the motors change
+   together as soon as the mixer has run.  ESCs disarm if frames stop
+   coming, so the subclass should also call send() from a timer while the
+   mixer isn't writing, e.g. with the motors cut.  A send() that interrupts
+   another one returns without sending, so the timer's can't garble the
+   mixer's.  There are two buffers, used in turn, so a send never rewrites
+   the one being transferred; transfer() should drop a request that comes
+   while one is running.
+
+   Special commands (beeps, spin direction, saving settings) have their own
+   slot, so the mixer's next throttle doesn't overwrite them: a command
+   goes out in place of the throttle for a number of frames, as ESCs
+   ignore one that isn't repeated, and then the throttle resumes.  ESCs
+   act on commands only with the motor stopped.
+
+   Bidirectional DShot inverts the lines (idle high, which the subclass
+   does with the timer's output polarity) and the CRC, and the ESC answers
+   each frame about 30 usec later, on the same wire at 5/4 the bitrate,
+   with its commutation period.  The reply is 20 bits of GCR (four 5-bit
+   groups for four nibbles), sent as a level change for each one bit.  The
+   subclass captures the times of the edges and passes them to receive(),
+   which decodes them into the motor's RPM.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "motor.hpp"
+
+namespace hf {
+
+    enum {
+        DSHOT150 = 150000,
+        DSHOT300 = 300000,
+        DSHOT600 = 600000
+    };
+
+    class DShotMotor : public Motor {
+
+        public:
+
+            static const uint16_t FRAME_BITS = 16;
+
+            // Low slots after the frame, so the line idles low when the transfer ends
+            static const uint16_t RESET_SLOTS = 2;
+
+            static const uint16_t VALUE_STOP = 0;
+            static const uint16_t VALUE_MIN  = 48;
+            static const uint16_t VALUE_MAX  = 2047;
+
+            // Frames per special command; the ones that change settings need at least six
+            static const uint8_t COMMAND_REPEATS = 10;
+
+            // Returned by the decoders for a reply that failed to decode or failed its CRC
+            static const uint32_t INVALID = 0xFFFFFFFF;
+
+            // 16-bit frame for an 11-bit value; bidirectional frames invert the CRC
+            static uint16_t frame(uint16_t value, bool telemetry, bool bidirectional=false)
+            {
+                uint16_t data = (value << 1) | (telemetry ? 1 : 0);
+
+                uint16_t crc = data ^ (data >> 4) ^ (data >> 8);
+
+                if (bidirectional) crc = ~crc;
+
+                return (data << 4) | (crc & 0x0F);
+            }
+
+            // Reply edge times to its 21 bits, start bit included, with a one wherever the level changed
+            static uint32_t edgesToGcr(const uint32_t * edges, uint8_t count, uint32_t bitTicks)
+            {
+                uint32_t value = 0;
+                uint8_t bits = 0;
+
+                for (uint8_t k=1; k<=count && bits<REPLY_BITS; ++k) {
+
+                    // The line goes back to idle after the last bit, so the last run is whatever is left
+                    uint32_t len = k < count ?
+                        (edges[k] - edges[k-1] + bitTicks/2) / bitTicks :
+                        REPLY_BITS - bits;
+
+                    if (len == 0 || bits + len > REPLY_BITS) return INVALID;
+
+                    value = (value << len) | (1 << (len-1));
+                    bits += len;
+                }
+
+                return bits == REPLY_BITS ? value : INVALID;
+            }
+
+            // GCR reply to the commutation period in usec, or zero for a stopped motor
+            static uint32_t gcrToPeriod(uint32_t gcr)
+            {
+                static const uint8_t X = 0xFF;
+
+                static const uint8_t nibbles[32] = {
+                    X, X, X, X, X, X, X, X, X, 9, 10, 11, X, 13, 14, 15,
+                    X, X, 2, 3, X, 5, 6, 7, X, 0, 8, 1, X, 4, 12, X
+                };
+
+                if (gcr == INVALID) return INVALID;
+
+                uint32_t data = 0;
+
+                for (uint8_t k=0; k<4; ++k) {
+                    uint8_t nibble = nibbles[(gcr >> (5*k)) & 0x1F];
+                    if (nibble == X) return INVALID;
+                    data |= nibble << (4*k);
+                }
+
+                uint32_t crc = data ^ (data >> 4) ^ (data >> 8) ^ (data >> 12);
+                if ((crc & 0x0F) != 0x0F) return INVALID;
+
+                // 3-bit shift and 9-bit mantissa
+                data >>= 4;
+
+                if (data == 0x0FFF) return 0;
+
+                uint32_t period = (data & 0x1FF) << (data >> 9);
+
+                return period ? period : INVALID;
+            }
+
+            // Motor value in [0,1] to DShot value; zero is the stop command rather than idle
+            static uint16_t throttleValue(float value)
+            {
+                if (!(value > 0)) return VALUE_STOP;
+
+                if (value >= 1) return VALUE_MAX;
+
+                return VALUE_MIN + (uint16_t)(value * (VALUE_MAX - VALUE_MIN) + 0.5f);
+            }
+
+        private:
+
+            // Start bit plus 20 bits of GCR
+            static const uint8_t REPLY_BITS = 21;
+
+            // Bad replies in a row before we stop trusting the last good one
+            static const uint8_t MAX_REPLY_ERRORS = 10;
+
+            static const uint16_t BUFFER_SIZE = (FRAME_BITS + RESET_SLOTS) * MAX_COUNT;
+
+            uint16_t _bitTicks = 0;
+            uint16_t _oneTicks = 0;
+            uint16_t _zeroTicks = 0;
+
+            volatile uint16_t _values[MAX_COUNT] = {};
+            volatile bool _telemetry[MAX_COUNT] = {};
+
+            // Special command for each motor, and how many more frames to send it in
+            volatile uint16_t _commands[MAX_COUNT] = {};
+            volatile uint8_t _commandRepeats[MAX_COUNT] = {};
+
+            // Set during send(), so that one interrupting another gives way
+            volatile bool _sending = false;
+
+            bool _bidirectional = false;
+            uint8_t _poles = 14;
+
+            volatile float _rpm[MAX_COUNT] = {};
+            volatile uint8_t _replyErrors[MAX_COUNT] = {};
+            volatile uint32_t _replyErrorCount = 0;
+
+            // Slot [bit*count + motor], i.e., one run of compare values per bit
+            uint16_t _buffers[2][BUFFER_SIZE] = {};
+            uint8_t _next = 0;
+
+            void encode(uint8_t index)
+            {
+                uint16_t value = _values[index];
+
+                if (_commandRepeats[index] > 0) {
+                    value = _commands[index];
+                    --_commandRepeats[index];
+                }
+
+                uint16_t data = frame(value, _telemetry[index], _bidirectional);
+
+                // Telemetry goes out on one frame per request
+                _telemetry[index] = false;
+
+                for (uint8_t k=0; k<FRAME_BITS; ++k) {
+                    _buffers[_next][k*_count+index] = (data & (0x8000 >> k)) ? _oneTicks : _zeroTicks;
+                }
+            }
+
+        protected:
+
+            /**
+              * timerHz:  clock of the timer that paces the DMA
+              * bitrate:  DSHOT150, DSHOT300 or DSHOT600
+              * bidirectional: ESCs reply with their RPM; the subclass must be able to capture the replies
+              * poles:    magnet poles in the motors, for converting electrical RPM to mechanical
+              */
+            DShotMotor(const uint8_t pins[], const uint8_t count, uint32_t timerHz, uint32_t bitrate,
+                       bool bidirectional=false, uint8_t poles=14)
+                : Motor(pins, count)
+            {
+                _bitTicks  = timerHz / bitrate;
+                _oneTicks  = (uint16_t)((_bitTicks * 3 + 2) / 4);
+                _zeroTicks = (uint16_t)((_bitTicks * 3 + 4) / 8);
+
+                _bidirectional = bidirectional;
+                _poles = poles;
+            }
+
+            // Starts the DMA transfer of length compare values; the buffer is ours again when it ends
+            virtual void transfer(const uint16_t * buffer, uint16_t length) = 0;
+
+            // Encodes every motor's latest value and sends them all in one transfer
+            void send(void)
+            {
+                // Interrupted a send in progress, which will go out with the latest values anyway
+                if (_sending) return;
+
+                _sending = true;
+
+                for (uint8_t k=0; k<_count; ++k) {
+                    encode(k);
+                }
+
+                transfer(_buffers[_next], (FRAME_BITS + RESET_SLOTS) * _count);
+
+                _next = 1 - _next;
+
+                _sending = false;
+            }
+
+            // Call with the times of a motor's reply edges, first edge first, in ticks of bitTicks per bit
+            void receive(uint8_t index, const uint32_t * edges, uint8_t count, uint32_t bitTicks)
+            {
+                uint32_t period = gcrToPeriod(edgesToGcr(edges, count, bitTicks));
+
+                if (period == INVALID) {
+                    ++_replyErrorCount;
+                    if (_replyErrors[index] < MAX_REPLY_ERRORS) {
+                        ++_replyErrors[index];
+                    }
+                    return;
+                }
+
+                // One commutation period per electrical revolution, poles/2 of those per mechanical one
+                _rpm[index] = period ? 60e6f / (period * (_poles / 2)) : 0;
+                _replyErrors[index] = 0;
+            }
+
+        public:
+
+            virtual void write(uint8_t index, float value) override
+            {
+                _values[index] = throttleValue(value);
+            }
+
+            virtual void writeAll(const float * values, uint8_t count) override
+            {
+                for (uint8_t k=0; k<count; ++k) {
+                    _values[k] = throttleValue(values[k]);
+                }
+
+                send();
+            }
+
+            // Sends a special command (1-47, e.g. beep or spin direction) in place of the throttle for the next few frames
+            void command(uint8_t index, uint16_t cmd, uint8_t repeats=COMMAND_REPEATS)
+            {
+                if (cmd == VALUE_STOP || cmd >= VALUE_MIN) return;
+
+                // Stop the old one first, in case a send interrupts us
+                _commandRepeats[index] = 0;
+                _commands[index] = cmd;
+                _commandRepeats[index] = repeats;
+            }
+
+            // Asks the ESC to reply on its telemetry wire after the next frame
+            void requestTelemetry(uint8_t index)
+            {
+                _telemetry[index] = true;
+            }
+
+            virtual bool getRpm(uint8_t index, float & rpm) override
+            {
+                if (!_bidirectional || _replyErrors[index] >= MAX_REPLY_ERRORS) return false;
+
+                rpm = _rpm[index];
+
+                return true;
+            }
+
+            // Timer period for one bit
+            uint16_t getBitTicks(void)
+            {
+                return _bitTicks;
+            }
+
+            // Timer period for one bit of a reply, on the same timer
+            uint16_t getReplyBitTicks(void)
+            {
+                return (_bitTicks * 4 + 2) / 5;
+            }
+
+            // Replies that failed to decode, since startup
+            uint32_t getReplyErrors(void)
+            {
+                return _replyErrorCount;
+            }
+
+    }; // class DShotMotor
+
+} // namespace hf
@@ -311,6 +311,49 @@ namespace hf {
                         serialize8(_checksum);
                         } break;
 
+                    case 123:
+                    {
+                        float nanResets = 0;
+                        float divergenceResets = 0;
+                        float covarianceTrace = 0;
+                        float innovationRatio = 0;
+                        handle_ESTIMATOR_HEALTH_Request(nanResets, divergenceResets, covarianceTrace, innovationRatio);
+                        prepareToSendFloats(4);
+                        sendFloat(nanResets);
+                        sendFloat(divergenceResets);
+                        sendFloat(covarianceTrace);
+                        sendFloat(innovationRatio);
+                        serialize8(_checksum);
+                        } break;
+
+                    case 124:
+                    {
+                        float index = 0;
+                        float count = 0;
+                        float value = 0;
+                        float min = 0;
+                        float max = 0;
+                        handle_PARAMETER_Request(index, count, value, min, max);
+                        prepareToSendFloats(5);
+                        sendFloat(index);
+                        sendFloat(count);
+                        sendFloat(value);
+                        sendFloat(min);
+                        sendFloat(max);
+                        serialize8(_checksum);
+                        } break;
+
+                    case 125:
+                    {
+                        float armed = 0;
+                        float blocks = 0;
+                        handle_ARMING_STATUS_Request(armed, blocks);
+                        prepareToSendFloats(2);
+                        sendFloat(armed);
+                        sendFloat(blocks);
+                        serialize8(_checksum);
+                        } break;
+
                     case 213:
                     {
                         float vx = 0;
@@ -376,6 +419,92 @@ namespace hf {
                         handle_SET_ARMED(flag);
                         } break;
 
+                    case 218:
+                    {
+                        uint8_t index = 0;
+                        memcpy(&index,  &_inBuf[0], sizeof(uint8_t));
+
+                        handle_SELECT_PARAMETER(index);
+                        } break;
+
+                    case 219:
+                    {
+                        uint8_t index = 0;
+                        memcpy(&index,  &_inBuf[0], sizeof(uint8_t));
+
+                        float value = 0;
+                        memcpy(&value,  &_inBuf[1], sizeof(float));
+
+                        handle_SET_PARAMETER(index, value);
+                        } break;
+
+                    case 220:
+                    {
+                        uint8_t flag = 0;
+                        memcpy(&flag,  &_inBuf[0], sizeof(uint8_t));
+
+                        handle_COMMIT_PARAMETERS(flag);
+                        } break;
+
+                    case 221:
+                    {
+                        float Kp = 0;
+                        memcpy(&Kp,  &_inBuf[0], sizeof(float));
+
+                        float Ki = 0;
+                        memcpy(&Ki,  &_inBuf[4], sizeof(float));
+
+                        float Kd = 0;
+                        memcpy(&Kd,  &_inBuf[8], sizeof(float));
+
+                        float Kp_yaw = 0;
+                        memcpy(&Kp_yaw,  &_inBuf[12], sizeof(float));
+
+                        float Ki_yaw = 0;
+                        memcpy(&Ki_yaw,  &_inBuf[16], sizeof(float));
+
+                        handle_SET_RATE_PID(Kp, Ki, Kd, Kp_yaw, Ki_yaw);
+                        } break;
+
+                    case 222:
+                    {
+                        float Kp_roll = 0;
+                        memcpy(&Kp_roll,  &_inBuf[0], sizeof(float));
+
+                        float Kp_pitch = 0;
+                        memcpy(&Kp_pitch,  &_inBuf[4], sizeof(float));
+
+                        handle_SET_LEVEL_PID(Kp_roll, Kp_pitch);
+                        } break;
+
+                    case 223:
+                    {
+                        float Kp_pos = 0;
+                        memcpy(&Kp_pos,  &_inBuf[0], sizeof(float));
+
+                        float Kp_vel = 0;
+                        memcpy(&Kp_vel,  &_inBuf[4], sizeof(float));
+
+                        float Ki_vel = 0;
+                        memcpy(&Ki_vel,  &_inBuf[8], sizeof(float));
+
+                        float Kd_vel = 0;
+                        memcpy(&Kd_vel,  &_inBuf[12], sizeof(float));
+
+                        handle_SET_ALTHOLD_PID(Kp_pos, Kp_vel, Ki_vel, Kd_vel);
+                        } break;
+
+                    case 224:
+                    {
+                        float Kp = 0;
+                        memcpy(&Kp,  &_inBuf[0], sizeof(float));
+
+                        float Ki = 0;
+                        memcpy(&Ki,  &_inBuf[4], sizeof(float));
+
+                        handle_SET_FLOWHOLD_PID(Kp, Ki);
+                        } break;
+
                 }
             }
 
@@ -407,6 +536,29 @@ namespace hf {
                 (void)yaw;
             }
 
+            virtual void handle_ESTIMATOR_HEALTH_Request(float & nanResets, float & divergenceResets, float & covarianceTrace, float & innovationRatio)
+            {
+                (void)nanResets;
+                (void)divergenceResets;
+                (void)covarianceTrace;
+                (void)innovationRatio;
+            }
+
+            virtual void handle_PARAMETER_Request(float & index, float & count, float & value, float & min, float & max)
+            {
+                (void)index;
+                (void)count;
+                (void)value;
+                (void)min;
+                (void)max;
+            }
+
+            virtual void handle_ARMING_STATUS_Request(float & armed, float & blocks)
+            {
+                (void)armed;
+                (void)blocks;
+            }
+
             virtual void handle_SET_VELOCITY_SETPOINTS(float  vx, float  vy, float  vz, float  yaw_rate)
             {
                 (void)vx;
@@ -438,6 +590,51 @@ namespace hf {
                 (void)flag;
             }
 
+            virtual void handle_SELECT_PARAMETER(uint8_t  index)
+            {
+                (void)index;
+            }
+
+            virtual void handle_SET_PARAMETER(uint8_t  index, float  value)
+            {
+                (void)index;
+                (void)value;
+            }
+
+            virtual void handle_COMMIT_PARAMETERS(uint8_t  flag)
+            {
+                (void)flag;
+            }
+
+            virtual void handle_SET_RATE_PID(float  Kp, float  Ki, float  Kd, float  Kp_yaw, float  Ki_yaw)
+            {
+                (void)Kp;
+                (void)Ki;
+                (void)Kd;
+                (void)Kp_yaw;
+                (void)Ki_yaw;
+            }
+
+            virtual void handle_SET_LEVEL_PID(float  Kp_roll, float  Kp_pitch)
+            {
+                (void)Kp_roll;
+                (void)Kp_pitch;
+            }
+
+            virtual void handle_SET_ALTHOLD_PID(float  Kp_pos, float  Kp_vel, float  Ki_vel, float  Kd_vel)
+            {
+                (void)Kp_pos;
+                (void)Kp_vel;
+                (void)Ki_vel;
+                (void)Kd_vel;
+            }
+
+            virtual void handle_SET_FLOWHOLD_PID(float  Kp, float  Ki)
+            {
+                (void)Kp;
+                (void)Ki;
+            }
+
         public:
 
             static uint8_t serialize_STATE_Request(uint8_t bytes[])
@@ -534,6 +731,95 @@ namespace hf {
                 return 18;
             }
 
+            static uint8_t serialize_ESTIMATOR_HEALTH_Request(uint8_t bytes[])
+            {
+                bytes[0] = 36;
+                bytes[1] = 77;
+                bytes[2] = 60;
+                bytes[3] = 0;
+                bytes[4] = 123;
+                bytes[5] = 123;
+
+                return 6;
+            }
+
+            static uint8_t serialize_ESTIMATOR_HEALTH(uint8_t bytes[], float  nanResets, float  divergenceResets, float  covarianceTrace, float  innovationRatio)
+            {
+                bytes[0] = 36;
+                bytes[1] = 77;
+                bytes[2] = 62;
+                bytes[3] = 16;
+                bytes[4] = 123;
+
+                memcpy(&bytes[5], &nanResets, sizeof(float));
+                memcpy(&bytes[9], &divergenceResets, sizeof(float));
+                memcpy(&bytes[13], &covarianceTrace, sizeof(float));
+                memcpy(&bytes[17], &innovationRatio, sizeof(float));
+
+                bytes[21] = CRC8(&bytes[3], 18);
+
+                return 22;
+            }
+
+            static uint8_t serialize_PARAMETER_Request(uint8_t bytes[])
+            {
+                bytes[0] = 36;
+                bytes[1] = 77;
+                bytes[2] = 60;
+                bytes[3] = 0;
+                bytes[4] = 124;
+                bytes[5] = 124;
+
+                return 6;
+            }
+
+            static uint8_t serialize_PARAMETER(uint8_t bytes[], float  index, float  count, float  value, float  min, float  max)
+            {
+                bytes[0] = 36;
+                bytes[1] = 77;
+                bytes[2] = 62;
+                bytes[3] = 20;
+                bytes[4] = 124;
+
+                memcpy(&bytes[5], &index, sizeof(float));
+                memcpy(&bytes[9], &count, sizeof(float));
+                memcpy(&bytes[13], &value, sizeof(float));
+                memcpy(&bytes[17], &min, sizeof(float));
+                memcpy(&bytes[21], &max, sizeof(float));
+
+                bytes[25] = CRC8(&bytes[3], 22);
+
+                return 26;
+            }
+
+            static uint8_t serialize_ARMING_STATUS_Request(uint8_t bytes[])
+            {
+                bytes[0] = 36;
+                bytes[1] = 77;
+                bytes[2] = 60;
+                bytes[3] = 0;
+                bytes[4] = 125;
+                bytes[5] = 125;
+
+                return 6;
+            }
+
+            static uint8_t serialize_ARMING_STATUS(uint8_t bytes[], float  armed, float  blocks)
+            {
+                bytes[0] = 36;
+                bytes[1] = 77;
+                bytes[2] = 62;
+                bytes[3] = 8;
+                bytes[4] = 125;
+
+                memcpy(&bytes[5], &armed, sizeof(float));
+                memcpy(&bytes[9], &blocks, sizeof(float));
+
+                bytes[13] = CRC8(&bytes[3], 10);
+
+                return 14;
+            }
+
             static uint8_t serialize_SET_VELOCITY_SETPOINTS(uint8_t bytes[], float  vx, float  vy, float  vz, float  yaw_rate)
             {
                 bytes[0] = 36;
@@ -605,6 +891,121 @@ namespace hf {
                 return 7;
             }
 
+            static uint8_t serialize_SELECT_PARAMETER(uint8_t bytes[], uint8_t  index)
+            {
+                bytes[0] = 36;
+                bytes[1] = 77;
+                bytes[2] = 62;
+                bytes[3] = 1;
+                bytes[4] = 218;
+
+                memcpy(&bytes[5], &index, sizeof(uint8_t));
+
+                bytes[6] = CRC8(&bytes[3], 3);
+
+                return 7;
+            }
+
+            static uint8_t serialize_SET_PARAMETER(uint8_t bytes[], uint8_t  index, float  value)
+            {
+                bytes[0] = 36;
+                bytes[1] = 77;
+                bytes[2] = 62;
+                bytes[3] = 5;
+                bytes[4] = 219;
+
+                memcpy(&bytes[5], &index, sizeof(uint8_t));
+                memcpy(&bytes[6], &value, sizeof(float));
+
+                bytes[10] = CRC8(&bytes[3], 7);
+
+                return 11;
+            }
+
+            static uint8_t serialize_COMMIT_PARAMETERS(uint8_t bytes[], uint8_t  flag)
+            {
+                bytes[0] = 36;
+                bytes[1] = 77;
+                bytes[2] = 62;
+                bytes[3] = 1;
+                bytes[4] = 220;
+
+                memcpy(&bytes[5], &flag, sizeof(uint8_t));
+
+                bytes[6] = CRC8(&bytes[3], 3);
+
+                return 7;
+            }
+
+            static uint8_t serialize_SET_RATE_PID(uint8_t bytes[], float  Kp, float  Ki, float  Kd, float  Kp_yaw, float  Ki_yaw)
+            {
+                bytes[0] = 36;
+                bytes[1] = 77;
+                bytes[2] = 62;
+                bytes[3] = 20;
+                bytes[4] = 221;
+
+                memcpy(&bytes[5], &Kp, sizeof(float));
+                memcpy(&bytes[9], &Ki, sizeof(float));
+                memcpy(&bytes[13], &Kd, sizeof(float));
+                memcpy(&bytes[17], &Kp_yaw, sizeof(float));
+                memcpy(&bytes[21], &Ki_yaw, sizeof(float));
+
+                bytes[25] = CRC8(&bytes[3], 22);
+
+                return 26;
+            }
+
+            static uint8_t serialize_SET_LEVEL_PID(uint8_t bytes[], float  Kp_roll, float  Kp_pitch)
+            {
+                bytes[0] = 36;
+                bytes[1] = 77;
+                bytes[2] = 62;
+                bytes[3] = 8;
+                bytes[4] = 222;
+
+                memcpy(&bytes[5], &Kp_roll, sizeof(float));
+                memcpy(&bytes[9], &Kp_pitch, sizeof(float));
+
+                bytes[13] = CRC8(&bytes[3], 10);
+
+                return 14;
+            }
+
+            static uint8_t serialize_SET_ALTHOLD_PID(uint8_t bytes[], float  Kp_pos, float  Kp_vel, float  Ki_vel, float  Kd_vel)
+            {
+                bytes[0] = 36;
+                bytes[1] = 77;
+                bytes[2] = 62;
+                bytes[3] = 16;
+                bytes[4] = 223;
+
+                memcpy(&bytes[5], &Kp_pos, sizeof(float));
+                memcpy(&bytes[9], &Kp_vel, sizeof(float));
+                memcpy(&bytes[13], &Ki_vel, sizeof(float));
+                memcpy(&bytes[17], &Kd_vel, sizeof(float));
+
+                bytes[21] = CRC8(&bytes[3], 18);
+
+                return 22;
+            }
+
+            static uint8_t serialize_SET_FLOWHOLD_PID(uint8_t bytes[], float  Kp, float  Ki)
+            {
+                bytes[0] = 36;
+                bytes[1] = 77;
+                bytes[2] = 62;
+                bytes[3] = 8;
+                bytes[4] = 224;
+
+                memcpy(&bytes[5], &Kp, sizeof(float));
+                memcpy(&bytes[9], &Ki, sizeof(float));
+
+                bytes[13] = CRC8(&bytes[3], 10);
+
+                return 14;
+            }
+
     }; // class MspParser
 
 } // namespace hf
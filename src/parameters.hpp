@@ -0,0 +1,257 @@
+/*
+   Tunable parameters
+
+   The flight code reads parameters straight from the parameters_t struct, so
+   there is no lookup on the hot path.  The registry below maps each
+   parameter's index to its place in the struct and its allowed range, for
+   getting and setting over MSP; the whole struct is saved as one versioned
+   blob in non-volatile storage.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "datatypes.hpp"
+#include "board.hpp"
+#include "storage.hpp"
+#include "calibration.hpp"
+
+namespace hf {
+
+    class Parameters {
+
+        friend class Hackflight;
+        friend class SerialTask;
+        friend class PidTask;
+
+        private:
+
+            // Stored right after the sensor calibration
+            static const uint16_t STORAGE_ADDRESS = Calibration::STORAGE_END;
+            static const uint16_t STORAGE_MAGIC   = 0x5250; // "PR"
+
+            // Bump this whenever parameters_t changes, so that an old blob is ignored rather than misread
+            static const uint8_t  STORAGE_VERSION = 3;
+
+            static constexpr float MAX_GAIN = 10;
+
+            typedef struct {
+
+                uint8_t offset;
+                float min;
+                float max;
+
+            } entry_t;
+
+            // Indices are part of the MSP protocol: append new parameters, don't reorder them
+            static const entry_t * registry(uint8_t & count)
+            {
+                static const entry_t entries[] = {
+                    { offsetof(parameters_t, cyclicExpo),   0, 1 },
+                    { offsetof(parameters_t, cyclicRate),   0, 2 },
+                    { offsetof(parameters_t, throttleExpo), 0, 1 },
+
+                    { offsetof(parameters_t, rateGains) + 0*sizeof(float), 0, MAX_GAIN },
+                    { offsetof(parameters_t, rateGains) + 1*sizeof(float), 0, MAX_GAIN },
+                    { offsetof(parameters_t, rateGains) + 2*sizeof(float), 0, MAX_GAIN },
+                    { offsetof(parameters_t, rateGains) + 3*sizeof(float), 0, MAX_GAIN },
+                    { offsetof(parameters_t, rateGains) + 4*sizeof(float), 0, MAX_GAIN },
+
+                    { offsetof(parameters_t, levelGains) + 0*sizeof(float), 0, MAX_GAIN },
+                    { offsetof(parameters_t, levelGains) + 1*sizeof(float), 0, MAX_GAIN },
+
+                    { offsetof(parameters_t, altHoldGains) + 0*sizeof(float), 0, MAX_GAIN },
+                    { offsetof(parameters_t, altHoldGains) + 1*sizeof(float), 0, MAX_GAIN },
+                    { offsetof(parameters_t, altHoldGains) + 2*sizeof(float), 0, MAX_GAIN },
+                    { offsetof(parameters_t, altHoldGains) + 3*sizeof(float), 0, MAX_GAIN },
+
+                    { offsetof(parameters_t, flowHoldGains) + 0*sizeof(float), 0, MAX_GAIN },
+                    { offsetof(parameters_t, flowHoldGains) + 1*sizeof(float), 0, MAX_GAIN },
+                };
+
+                count = sizeof(entries) / sizeof(entry_t);
+
+                return entries;
+            }
+
+            parameters_t _values;
+
+            // Set since the last commit
+            bool _dirty = false;
+
+            float * field(parameters_t & values, const entry_t & entry)
+            {
+                return (float *)((uint8_t *)&values + entry.offset);
+            }
+
+            // Rejects a stored blob with any value out of range, e.g. after a range was narrowed
+            bool valid(parameters_t & values)
+            {
+                uint8_t n = 0;
+                const entry_t * entries = registry(n);
+
+                for (uint8_t k=0; k<n; ++k) {
+                    float value = *field(values, entries[k]);
+                    if (!(value >= entries[k].min && value <= entries[k].max)) return false;
+                }
+
+                return true;
+            }
+
+            void load(Board * board)
+            {
+                parameters_t values;
+
+                if (Storage::load(board, STORAGE_ADDRESS, STORAGE_MAGIC, STORAGE_VERSION, &values, sizeof(values)) && valid(values)) {
+                    _values = values;
+                }
+            }
+
+            bool commit(Board * board)
+            {
+                if (_dirty && Storage::save(board, STORAGE_ADDRESS, STORAGE_MAGIC, STORAGE_VERSION, &_values, sizeof(_values))) {
+                    _dirty = false;
+                }
+
+                return !_dirty;
+            }
+
+            uint8_t count(void)
+            {
+                uint8_t n = 0;
+                registry(n);
+                return n;
+            }
+
+            bool get(uint8_t index, float & value, float & min, float & max)
+            {
+                uint8_t n = 0;
+                const entry_t * entries = registry(n);
+
+                if (index >= n) return false;
+
+                value = *field(_values, entries[index]);
+                min   = entries[index].min;
+                max   = entries[index].max;
+
+                return true;
+            }
+
+            // Out-of-range values are rejected rather than clamped, so the GCS knows what the vehicle is really using
+            bool set(uint8_t index, float value)
+            {
+                uint8_t n = 0;
+                const entry_t * entries = registry(n);
+
+                if (index >= n || !(value >= entries[index].min && value <= entries[index].max)) return false;
+
+                float * dst = field(_values, entries[index]);
+
+                *dst = value;
+
+                // A gain set on its own still makes the stored gains that controller's
+                for (uint8_t id=GAINS_RATE; id<=GAINS_FLOWHOLD; ++id) {
+                    uint8_t n = 0;
+                    float * g = gains(id, n);
+                    if (dst >= g && dst < g + n) {
+                        _values.gcsGains |= 1 << id;
+                    }
+                }
+
+                _dirty = true;
+
+                return true;
+            }
+
+            // The gains in _values for a controller, or NULL if it has none
+            float * gains(uint8_t id, uint8_t & count)
+            {
+                switch (id) {
+                    case GAINS_RATE:
+                        count = 5;
+                        return _values.rateGains;
+                    case GAINS_LEVEL:
+                        count = 2;
+                        return _values.levelGains;
+                    case GAINS_ALTHOLD:
+                        count = 4;
+                        return _values.altHoldGains;
+                    case GAINS_FLOWHOLD:
+                        count = 2;
+                        return _values.flowHoldGains;
+                }
+
+                count = 0;
+                return NULL;
+            }
+
+            // Sets a whole controller's gains at once; rejected if any is out of range
+            bool setGains(uint8_t id, const float * values)
+            {
+                uint8_t n = 0;
+                float * dst = gains(id, n);
+
+                if (!dst) return false;
+
+                for (uint8_t k=0; k<n; ++k) {
+                    if (!(values[k] >= 0 && values[k] <= MAX_GAIN)) return false;
+                }
+
+                for (uint8_t k=0; k<n; ++k) {
+                    dst[k] = values[k];
+                }
+
+                _values.gcsGains |= 1 << id;
+
+                _dirty = true;
+
+                return true;
+            }
+
+            // True once the GCS or an autotuner has set the controller's gains
+            bool hasGcsGains(uint8_t id)
+            {
+                return (_values.gcsGains >> id) & 1;
+            }
+
+        public:
+
+            // Storage after us should start here
+            static constexpr uint16_t STORAGE_END = STORAGE_ADDRESS + Storage::footprint(sizeof(parameters_t));
+
+            Parameters(void)
+            {
+                _values.cyclicExpo   = 0.65f;
+                _values.cyclicRate   = 0.90f;
+                _values.throttleExpo = 0.20f;
+
+                memset(_values.rateGains, 0, sizeof(_values.rateGains));
+                memset(_values.levelGains, 0, sizeof(_values.levelGains));
+                memset(_values.altHoldGains, 0, sizeof(_values.altHoldGains));
+                memset(_values.flowHoldGains, 0, sizeof(_values.flowHoldGains));
+
+                _values.gcsGains = 0;
+            }
+
+    };  // class Parameters
+
+} // namespace hf
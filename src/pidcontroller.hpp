@@ -28,6 +28,35 @@ namespace hf {
     class PidController {
 
         friend class PidTask;
+        friend class Hackflight;
+
+        private:
+
+            static const uint8_t MAX_GAINS = 5;
+
+            // New gains from the GCS wait here until PidTask swaps them in between iterations
+            float _stagedGains[MAX_GAINS] = {};
+            volatile bool _gainsStaged = false;
+
+            void stageGains(const float * gains, uint8_t count)
+            {
+                for (uint8_t k=0; k<count && k<MAX_GAINS; ++k) {
+                    _stagedGains[k] = gains[k];
+                }
+
+                __sync_synchronize();
+
+                _gainsStaged = true;
+            }
+
+            void swapGains(void)
+            {
+                if (_gainsStaged) {
+                    __sync_synchronize();
+                    setGains(_stagedGains);
+                    _gainsStaged = false;
+                }
+            }
 
         protected:
 
@@ -39,6 +68,17 @@ namespace hf {
 
             virtual void updateReceiver(bool throttleIsDown) { (void)throttleIsDown; }
 
+            // Board time in seconds, before each modifyDemands(), for controllers that measure time themselves
+            virtual void updateTime(float time) { (void)time; }
+
+            // Override these to support gains from the GCS; the gains are in constructor-argument order
+            virtual uint8_t gainsId(void) { return GAINS_NONE; }
+            virtual void getGains(float * gains) { (void)gains; }
+            virtual void setGains(const float * gains) { (void)gains; }
+
+            // Override this to supply gains for other controllers, e.g. from autotuning; return true once per new set
+            virtual bool getTunedGains(uint8_t & id, float * gains) { (void)id; (void)gains; return false; }
+
             uint8_t auxState = 0;
 
     };  // class PidController
@@ -66,6 +106,16 @@ namespace hf {
             // Prevents integral windup
             float _windupMax = 0;
 
+            // Setpoint weights: fraction of the target seen by the P and D terms
+            float _weightP = 1;
+            float _weightD = 1;
+
+            // Feed-forward on the change in target, smoothed because the receiver updates it in steps
+            float _Kf = 0;
+            float _feedForwardAlpha = 1;
+            float _lastTarget = 0;
+            float _targetDelta = 0;
+
         public:
 
             void init(const float Kp, const float Ki, const float Kd, const float windupMax=0.4) 
@@ -80,13 +130,44 @@ namespace hf {
                 reset();
             }
 
+            // Unlike init(), leaves the integral and derivative history alone, so gains can change in flight
+            void setGains(const float Kp, const float Ki, const float Kd)
+            {
+                _Kp = Kp;
+                _Ki = Ki;
+                _Kd = Kd;
+            }
+
+            void getGains(float & Kp, float & Ki, float & Kd)
+            {
+                Kp = _Kp;
+                Ki = _Ki;
+                Kd = _Kd;
+            }
+
+            // Weights below one soften the response to stick moves without changing disturbance rejection;
+            // a D weight of zero puts the D term on the measurement alone
+            void setSetpointWeights(const float weightP, const float weightD)
+            {
+                _weightP = weightP;
+                _weightD = weightD;
+            }
+
+            // Kf multiplies the per-iteration change in target, like Kd; smoothing in (0,1] is the fraction
+            // of each new change let through (1 for none)
+            void setFeedForward(const float Kf, const float smoothing=1)
+            {
+                _Kf = Kf;
+                _feedForwardAlpha = smoothing;
+            }
+
             float compute(float target, float actual)
             {
                 // Compute error as scaled target minus actual
                 float error = target - actual;
 
                 // Compute P term
-                float pterm = error * _Kp;
+                float pterm = (_weightP * target - actual) * _Kp;
 
                 // Compute I term
                 float iterm = 0;
@@ -96,16 +177,27 @@ namespace hf {
                 }
 
                 // Compute D term
+                float derror = _weightD * target - actual;
                 float dterm = 0;
                 if (_Kd > 0) { // optimization
-                    float deltaError = error - _lastError;
+                    float deltaError = derror - _lastError;
                     dterm = (_deltaError1 + _deltaError2 + deltaError) * _Kd; 
                     _deltaError2 = _deltaError1;
                     _deltaError1 = deltaError;
-                    _lastError = error;
                 }
 
-                return pterm + iterm + dterm;
+                // Tracked even without a D term, so that turning one on in flight doesn't kick
+                _lastError = derror;
+
+                // Compute feed-forward term
+                float fterm = 0;
+                if (_Kf > 0) { // optimization
+                    _targetDelta += _feedForwardAlpha * (target - _lastTarget - _targetDelta);
+                    fterm = _targetDelta * _Kf;
+                }
+                _lastTarget = target;
+
+                return pterm + iterm + dterm + fterm;
             }
 
             void updateReceiver(bool throttleIsDown)
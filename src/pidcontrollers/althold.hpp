@@ -79,6 +79,24 @@ namespace hf {
                 return true;
             }
 
+            virtual uint8_t gainsId(void) override
+            {
+                return GAINS_ALTHOLD;
+            }
+
+            virtual void getGains(float * gains) override
+            {
+                float Ki_pos = 0, Kd_pos = 0;
+                _posPid.getGains(gains[0], Ki_pos, Kd_pos);
+                _velPid.getGains(gains[1], gains[2], gains[3]);
+            }
+
+            virtual void setGains(const float * gains) override
+            {
+                _posPid.setGains(gains[0], 0, 0);
+                _velPid.setGains(gains[1], gains[2], gains[3]);
+            }
+
         public:
 
             AltitudeHoldPid(const float Kp_pos, const float Kp_vel, const float Ki_vel, const float Kd_vel) 
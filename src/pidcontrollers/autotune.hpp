@@ -0,0 +1,275 @@
+/*
+   Relay-feedback autotuner for the rate PID controller
+
+   Add this after the RatePid, on its own aux switch position.  While it is
+   switched in, it replaces the rate controller's output on one axis at a time
+   with a relay (bang-bang) signal that drives that axis into a small, steady
+   oscillation.  The amplitude and period of the oscillation give the
+   ultimate gain and period of the axis (Astrom and Hagglund), from which
+   the gains follow by the Tyreus-Luyben rules, which are less aggressive
+   than Ziegler-Nichols.  After tuning roll, pitch and yaw in turn, it hands
+   the gains to the rate controller and gets out of the way.  Switching it
+   out, or throttling down, abandons a tune in progress.  Cycles are timed
+   with the board clock that PidTask passes to updateTime(), and the
+   per-iteration gains use the loop period measured over the tune, so a
+   loop that runs slower or less evenly than planned still tunes right.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <math.h>
+
+#include "datatypes.hpp"
+#include "pidcontroller.hpp"
+
+namespace hf {
+
+    class AutotunePid : public PidController {
+
+        private:
+
+            // Let the oscillation settle for a few relay cycles, then average over a few more
+            static const uint8_t SETTLE_CYCLES  = 2;
+            static const uint8_t MEASURE_CYCLES = 4;
+
+            // Give up on an axis that hasn't finished by then (seconds)
+            static constexpr float TIMEOUT = 5;
+
+            enum {
+                IDLE,
+                TUNING,
+                DONE,
+                FAILED
+            };
+
+            float _relay = 0;
+            float _hysteresis = 0;
+
+            uint8_t _status = IDLE;
+            uint8_t _axis = AXIS_ROLL;
+
+            // modifyDemands() ran since the last updateReceiver(), i.e., we're switched in
+            bool _active = false;
+
+            // Relay output, +1 or -1
+            float _output = 0;
+
+            // Board time, and when the axis, the current cycle and the whole tune started (seconds)
+            float _time = 0;
+            float _axisStart = 0;
+            float _cycleStart = 0;
+            float _tuneStart = 0;
+
+            // Iterations since the tune started, for the mean loop period
+            uint32_t _ticks = 0;
+
+            uint8_t _cycles = 0;
+
+            // Extremes of the angular velocity over the current cycle
+            float _max = 0;
+            float _min = 0;
+
+            float _amplitudeSum = 0;
+            float _periodSum = 0;
+
+            // Ultimate gain and period for each axis
+            float _ku[3] = {};
+            float _tu[3] = {};
+
+            bool _gainsReady = false;
+            float _gains[5] = {};
+
+            static float & demand(demands_t & demands, uint8_t axis)
+            {
+                return axis == AXIS_ROLL ? demands.roll : (axis == AXIS_PITCH ? demands.pitch : demands.yaw);
+            }
+
+            void startAxis(uint8_t axis)
+            {
+                _axis = axis;
+                _output = 1;
+                _axisStart = _time;
+                _cycleStart = _time;
+                _cycles = 0;
+                _max = 0;
+                _min = 0;
+                _amplitudeSum = 0;
+                _periodSum = 0;
+            }
+
+            // Called on each switch of the relay from negative to positive, which ends a cycle
+            void endCycle(void)
+            {
+                if (_cycles > 0) {
+                    _amplitudeSum += (_max - _min) / 2;
+                    _periodSum += _time - _cycleStart;
+                }
+
+                _cycleStart = _time;
+                _max = -INFINITY;
+                _min = +INFINITY;
+
+                // The first cycle starts partway through, so it doesn't count toward the settling ones
+                if (++_cycles <= SETTLE_CYCLES + 1) {
+                    _amplitudeSum = 0;
+                    _periodSum = 0;
+                    return;
+                }
+
+                if (_cycles < SETTLE_CYCLES + 1 + MEASURE_CYCLES) return;
+
+                float a = _amplitudeSum / MEASURE_CYCLES;
+
+                // Hysteresis as big as the oscillation means we were just seeing noise
+                if (a <= _hysteresis) {
+                    _status = FAILED;
+                    return;
+                }
+
+                // Describing function of a relay with hysteresis
+                _ku[_axis] = 4 * _relay / ((float)M_PI * sqrtf(a*a - _hysteresis*_hysteresis));
+                _tu[_axis] = _periodSum / MEASURE_CYCLES;
+
+                if (_axis == AXIS_YAW) {
+                    computeGains();
+                    _status = DONE;
+                }
+                else {
+                    startAxis(_axis + 1);
+                }
+            }
+
+            // Converts continuous-time gains to the per-iteration form Pid uses (see pidcontroller.hpp): the
+            // integral is a plain sum of errors, and the derivative a difference over three iterations
+            void computeGains(void)
+            {
+                float dt = (_time - _tuneStart) / _ticks;
+
+                // Roll and pitch share gains, so take the more cautious of the two
+                float ku = _ku[AXIS_ROLL] < _ku[AXIS_PITCH] ? _ku[AXIS_ROLL] : _ku[AXIS_PITCH];
+                float tu = _ku[AXIS_ROLL] < _ku[AXIS_PITCH] ? _tu[AXIS_ROLL] : _tu[AXIS_PITCH];
+
+                // Tyreus-Luyben PID
+                float kp = ku / 2.2f;
+                float ti = 2.2f * tu;
+                float td = tu / 6.3f;
+
+                _gains[0] = kp;
+                _gains[1] = kp / ti * dt;
+                _gains[2] = kp * td / (3 * dt);
+
+                // Tyreus-Luyben PI
+                kp = _ku[AXIS_YAW] / 3.2f;
+                ti = 2.2f * _tu[AXIS_YAW];
+
+                _gains[3] = kp;
+                _gains[4] = kp / ti * dt;
+
+                _gainsReady = true;
+            }
+
+        protected:
+
+            virtual void modifyDemands(state_t * state, demands_t & demands) override
+            {
+                _active = true;
+
+                if (_status == IDLE) {
+                    _status = TUNING;
+                    _tuneStart = _time;
+                    _ticks = 0;
+                    startAxis(AXIS_ROLL);
+                }
+
+                if (_status != TUNING) return;
+
+                float y = state->angularVel[_axis];
+
+                if (y > _max) _max = y;
+                if (y < _min) _min = y;
+
+                ++_ticks;
+
+                if (_output > 0 && y > _hysteresis) {
+                    _output = -1;
+                }
+                else if (_output < 0 && y < -_hysteresis) {
+                    _output = +1;
+                    endCycle();
+                }
+
+                if (_status == TUNING && _time - _axisStart > TIMEOUT) {
+                    _status = FAILED;
+                }
+
+                if (_status == TUNING) {
+                    demand(demands, _axis) = _output * _relay;
+                }
+            }
+
+            virtual void updateReceiver(bool throttleIsDown) override
+            {
+                // Switched out or landed: start over next time
+                if (!_active || throttleIsDown) {
+                    _status = IDLE;
+                }
+
+                _active = false;
+            }
+
+            virtual void updateTime(float time) override
+            {
+                _time = time;
+            }
+
+            virtual bool getTunedGains(uint8_t & id, float * gains) override
+            {
+                if (!_gainsReady) return false;
+
+                for (uint8_t k=0; k<5; ++k) {
+                    gains[k] = _gains[k];
+                }
+
+                id = GAINS_RATE;
+
+                _gainsReady = false;
+
+                return true;
+            }
+
+        public:
+
+            /**
+              * relay:      size of the relay demand, in the units of the rate controller's output
+              * hysteresis: angular velocity (rad/sec) the axis must pass before the relay switches; set it above gyro noise
+              */
+            AutotunePid(float relay=0.05f, float hysteresis=0.05f)
+            {
+                _relay = relay;
+                _hysteresis = hysteresis;
+            }
+
+            bool failed(void)
+            {
+                return _status == FAILED;
+            }
+
+    };  // class AutotunePid
+
+} // namespace hf
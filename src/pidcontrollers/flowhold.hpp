@@ -44,6 +44,23 @@ namespace hf {
 
             }
 
+            virtual uint8_t gainsId(void) override
+            {
+                return GAINS_FLOWHOLD;
+            }
+
+            virtual void getGains(float * gains) override
+            {
+                float Kd = 0;
+                rollPid.getGains(gains[0], gains[1], Kd);
+            }
+
+            virtual void setGains(const float * gains) override
+            {
+                rollPid.setGains(gains[0], gains[1], 0);
+                pitchPid.setGains(gains[0], gains[1], 0);
+            }
+
         private:
 
             Pid rollPid;
@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include "attitude.hpp"
 #include "datatypes.hpp"
 #include "pidcontroller.hpp"
 
@@ -72,8 +73,30 @@ namespace hf {
 
             void modifyDemands(state_t * state, demands_t & demands)
             {
-                demands.roll  = _rollPid.compute(demands.roll, state->rotation[0]); 
-                demands.pitch = _pitchPid.compute(demands.pitch, state->rotation[1]);
+                const float * euler = Attitude::getEulerAngles(*state);
+
+                demands.roll  = _rollPid.compute(demands.roll, euler[0]); 
+                demands.pitch = _pitchPid.compute(demands.pitch, euler[1]);
+            }
+
+        protected:
+
+            virtual uint8_t gainsId(void) override
+            {
+                return GAINS_LEVEL;
+            }
+
+            virtual void getGains(float * gains) override
+            {
+                float Ki = 0, Kd = 0;
+                _rollPid.getGains(gains[0], Ki, Kd);
+                _pitchPid.getGains(gains[1], Ki, Kd);
+            }
+
+            virtual void setGains(const float * gains) override
+            {
+                _rollPid.setGains(gains[0], 0, 0);
+                _pitchPid.setGains(gains[1], 0, 0);
             }
 
     };  // class LevelPid
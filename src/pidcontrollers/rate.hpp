@@ -73,6 +73,11 @@ namespace hf {
             _AngularVelocityPid _pitchPid;
             _AngularVelocityPid _yawPid;
 
+            _AngularVelocityPid & axisPid(uint8_t axis)
+            {
+                return axis == AXIS_ROLL ? _rollPid : (axis == AXIS_PITCH ? _pitchPid : _yawPid);
+            }
+
         public:
 
             RatePid(const float Kp, const float Ki, const float Kd, const float Kp_yaw, const float Ki_yaw) 
@@ -97,6 +102,18 @@ namespace hf {
                 }
             }
 
+            // Optional feed-forward from stick movement, per axis (see Pid::setFeedForward)
+            void setFeedForward(uint8_t axis, const float Kf, const float smoothing=1)
+            {
+                axisPid(axis).setFeedForward(Kf, smoothing);
+            }
+
+            // Optional setpoint weighting, per axis (see Pid::setSetpointWeights)
+            void setSetpointWeights(uint8_t axis, const float weightP, const float weightD)
+            {
+                axisPid(axis).setSetpointWeights(weightP, weightD);
+            }
+
             virtual void updateReceiver(bool throttleIsDown) override
             {
                 // Check throttle-down for integral reset
@@ -105,6 +122,27 @@ namespace hf {
                 _yawPid.updateReceiver(throttleIsDown);
             }
 
+        protected:
+
+            virtual uint8_t gainsId(void) override
+            {
+                return GAINS_RATE;
+            }
+
+            virtual void getGains(float * gains) override
+            {
+                float Kd_yaw = 0;
+                _rollPid.getGains(gains[0], gains[1], gains[2]);
+                _yawPid.getGains(gains[3], gains[4], Kd_yaw);
+            }
+
+            virtual void setGains(const float * gains) override
+            {
+                _rollPid.setGains(gains[0], gains[1], gains[2]);
+                _pitchPid.setGains(gains[0], gains[1], gains[2]);
+                _yawPid.setGains(gains[3], gains[4], 0);
+            }
+
     };  // class RatePid
 
 } // namespace hf
@@ -24,6 +24,8 @@
 #include <math.h>
 
 #include "datatypes.hpp"
+#include "fastmath.hpp"
+#include "filters/stickcurve.hpp"
 #include "loggingfunctions.hpp"
 
 namespace hf {
@@ -37,44 +39,23 @@ namespace hf {
         private: 
 
             const float THROTTLE_MARGIN = 0.1f;
-            const float CYCLIC_EXPO     = 0.65f;
-            const float CYCLIC_RATE     = 0.90f;
-            const float THROTTLE_EXPO   = 0.20f;
             const float AUX_THRESHOLD   = 0.4f;
 
-            float adjustCommand(float command, uint8_t channel)
-            {
-                command /= 2;
+            // Expo and rates, set by Hackflight
+            const parameters_t * _parameters = NULL;
 
-                if (rawvals[_channelMap[channel]] < 0) {
-                    command = -command;
-                }
+            // Set from the parameters by updateCurves()
+            StickCurve _cyclicCurve;
+            StickCurve _throttleCurve;
 
-                return command;
-            }
-
-            float applyCyclicFunction(float command)
+            // Call whenever the parameters change
+            void updateCurves(void)
             {
-                return rcFun(command, CYCLIC_EXPO, CYCLIC_RATE);
-            }
+                // Cyclic demands are in [-0.5,+0.5]
+                _cyclicCurve.setExpo(_parameters->cyclicExpo, _parameters->cyclicRate / 2);
 
-            float makePositiveCommand(uint8_t channel)
-            {
-                return fabs(rawvals[_channelMap[channel]]);
-            }
-
-            static float rcFun(float x, float e, float r)
-            {
-                return (1 + e*(x*x - 1)) * x * r;
-            }
-
-            // [-1,+1] -> [0,1] -> [-1,+1]
-            float throttleFun(float x)
-            {
-                float mid = 0.5;
-                float tmp = (x + 1) / 2 - mid;
-                float y = tmp>0 ? 1-mid : (tmp<0 ? mid : 1);
-                return (mid + tmp*(1-THROTTLE_EXPO + THROTTLE_EXPO * (tmp*tmp) / (y*y))) * 2 - 1;
+                // Throttle expo is about mid-stick
+                _throttleCurve.setExpo(_parameters->throttleExpo);
             }
 
         protected: 
@@ -114,11 +95,16 @@ namespace hf {
             // Default to non-headless mode
             float headless = false;
 
-            // Raw receiver values in [-1,+1]
-            float rawvals[MAXCHAN] = {0};  
+            // Raw receiver values in [-1,+1].  Subclasses can fill in the values, or point
+            // rawvals at a buffer of their own to avoid copying.
+            float _rawvals[MAXCHAN] = {0};
+            float * rawvals = _rawvals;
 
             demands_t demands;
 
+            // Vehicle state, set by Hackflight, for receivers that send telemetry back
+            state_t * _vehicleState = NULL;
+
             float getRawval(uint8_t chan)
             {
                 return rawvals[_channelMap[chan]];
@@ -127,6 +113,13 @@ namespace hf {
             // Override this if your receiver provides RSSI or other weak-signal detection
             virtual bool lostSignal(void) { return false; }
 
+            // Override this if your receiver reports link quality, in percent
+            virtual bool linkQuality(uint8_t & percent)
+            {
+                (void)percent;
+                return false;
+            }
+
             /**
               * channelMap: throttle, roll, pitch, yaw, aux, arm
               */
@@ -152,19 +145,14 @@ namespace hf {
                 // Read raw channel values
                 readRawvals();
 
-                // Convert raw [-1,+1] to absolute value
-                demands.roll  = makePositiveCommand(CHANNEL_ROLL);
-                demands.pitch = makePositiveCommand(CHANNEL_PITCH);
-                demands.yaw   = makePositiveCommand(CHANNEL_YAW);
-
-                // Apply expo nonlinearity to roll, pitch
-                demands.roll  = applyCyclicFunction(demands.roll);
-                demands.pitch = applyCyclicFunction(demands.pitch);
+                // Apply expo nonlinearity to roll, pitch, yielding [-0.5,+0.5]
+                float cyclic[2] = { getRawval(CHANNEL_ROLL), getRawval(CHANNEL_PITCH) };
+                _cyclicCurve.get(cyclic, cyclic, 2);
+                demands.roll  = cyclic[0];
+                demands.pitch = cyclic[1];
 
-                // Put sign back on command, yielding [-0.5,+0.5]
-                demands.roll  = adjustCommand(demands.roll, CHANNEL_ROLL);
-                demands.pitch = adjustCommand(demands.pitch, CHANNEL_PITCH);
-                demands.yaw   = adjustCommand(demands.yaw, CHANNEL_YAW);
+                // Yaw is linear
+                demands.yaw = getRawval(CHANNEL_YAW) / 2;
 
                 // Add in software trim
                 demands.roll  += _trimRoll;
@@ -173,8 +161,8 @@ namespace hf {
 
                 // Support headless mode
                 if (headless) {
-                    float c = cos(yawAngle);
-                    float s = sin(yawAngle);
+                    float s = 0, c = 0;
+                    FastMath::sincos(yawAngle, s, c);
                     float p = demands.pitch;
                     float r = demands.roll;
                     
@@ -185,7 +173,7 @@ namespace hf {
                 demands.yaw = -demands.yaw;
 
                 // Pass throttle demand through exponential function
-                demands.throttle = throttleFun(rawvals[_channelMap[CHANNEL_THROTTLE]]);
+                demands.throttle = _throttleCurve.get(getRawval(CHANNEL_THROTTLE));
 
                 // Store auxiliary switch state
                 _aux1State = getRawval(CHANNEL_AUX1) >= 0.0 ? (getRawval(CHANNEL_AUX1) > AUX_THRESHOLD ? 2 : 1) : 0;
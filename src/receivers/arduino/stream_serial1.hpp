@@ -0,0 +1,80 @@
+/*
+   Stream receiver on Serial1, for any of the decoders in receivers/decoders
+
+   For example, SBUS on a Teensy:
+
+     hf::SbusDecoder decoder;
+     hf::StreamReceiver_Serial1 rc(&decoder, 100000, SERIAL_8E2_RXINV, CHANNEL_MAP, DEMAND_SCALE);
+
+   Bytes are decoded as soon as serialEvent1() gets them, which some cores
+   call from the UART interrupt and others between calls to loop().
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#include "receivers/stream.hpp"
+
+static hf::StreamReceiver * _stream_rx;
+
+void serialEvent1(void)
+{
+    while (Serial1.available()) {
+
+        _stream_rx->handleByte(Serial1.read(), micros());
+    }
+}
+
+namespace hf {
+
+    class StreamReceiver_Serial1 : public StreamReceiver {
+
+        private:
+
+            // No frames for this long means we've lost the transmitter, whatever the decoder says
+            static const uint32_t TIMEOUT_USEC = 100000;
+
+            uint32_t _baud = 0;
+            uint32_t _config = 0;
+
+        protected:
+
+            void begin(void) override 
+            {
+                Serial1.begin(_baud, _config);
+            }
+
+            bool lostSignal(void) override
+            {
+                return StreamReceiver::lostSignal() || (getSequence() > 0 && micros() - getFrameUsec() > TIMEOUT_USEC);
+            }
+
+        public:
+
+            StreamReceiver_Serial1(RxDecoder * decoder, uint32_t baud, uint32_t config, const uint8_t channelMap[6], const float demandScale)
+                :  StreamReceiver(decoder, channelMap, demandScale) 
+            { 
+                _baud = baud;
+                _config = config;
+
+                _stream_rx = this;
+            }
+
+    }; // class StreamReceiver_Serial1
+
+} // namespace hf
@@ -0,0 +1,283 @@
+/*
+   UDP receiver and telemetry for ESP8266 and ESP32 flight controllers
+
+   The vehicle runs a WiFi access point and listens on two UDP ports:
+
+     RC_PORT:        SET_RC_NORMAL messages from the transmitter
+     TELEMETRY_PORT: MSP requests (ATTITUDE_RADIANS, RC_NORMAL), each answered
+                     with one datagram to wherever it came from
+
+   That is all the WiFi link does: it flies the vehicle and shows its
+   attitude and sticks.  Every other message (motor tests, arming,
+   parameters) is ignored here and goes over the USB serial link, where
+   SerialTask handles it.  Each port has its own MSP parser, which starts
+   afresh with each datagram, so a message cut short can't garble the next
+   one, on either port.
+
+   Every datagram starts with a 32-bit little-endian sequence number, followed
+   by whole MSP messages.  On the RC port only the newest datagram counts: anything
+   older than what we've already used is dropped, and when several are
+   waiting we skip straight to the last.  Telemetry replies carry the sequence
+   number of their request, so the client can match them up and drop late
+   ones.  Nothing is ever resent; a lost frame is replaced by the next one.
+
+   Losing the transmitter shows up as frames stopping, which the failsafe
+   watches for.
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#if defined(ESP32)
+#include <WiFi.h>
+#else
+#include <ESP8266WiFi.h>
+#endif
+#include <WiFiUdp.h>
+
+#include "receiver.hpp"
+#include "attitude.hpp"
+#include "mspparser.hpp"
+
+namespace hf {
+
+    class UDP_Receiver : public Receiver {
+
+        private:
+
+            class RcParser : public MspParser {
+
+                friend class UDP_Receiver;
+
+                UDP_Receiver * _receiver = NULL;
+
+                virtual void handle_SET_RC_NORMAL(float  c1, float  c2, float  c3, float  c4, float  c5, float  c6) override
+                {
+                    _receiver->_gotMessage = true;
+                    _receiver->_sixvals[0] = c1;
+                    _receiver->_sixvals[1] = c2;
+                    _receiver->_sixvals[2] = c3;
+                    _receiver->_sixvals[3] = c4;
+                    _receiver->_sixvals[4] = c5;
+                    _receiver->_sixvals[5] = c6;
+                }
+
+            }; // class RcParser
+
+            class TelemetryParser : public MspParser {
+
+                friend class UDP_Receiver;
+
+                UDP_Receiver * _receiver = NULL;
+
+                virtual void handle_ATTITUDE_RADIANS_Request(float & roll, float & pitch, float & yaw) override
+                {
+                    if (!_receiver->_vehicleState) return;
+
+                    const float * euler = Attitude::getEulerAngles(*_receiver->_vehicleState);
+
+                    roll  = euler[AXIS_ROLL];
+                    pitch = euler[AXIS_PITCH];
+                    yaw   = euler[AXIS_YAW];
+                }
+
+                virtual void handle_RC_NORMAL_Request(float & c1, float & c2, float & c3, float & c4, float & c5, float & c6) override
+                {
+                    c1 = _receiver->getRawval(0);
+                    c2 = _receiver->getRawval(1);
+                    c3 = _receiver->getRawval(2);
+                    c4 = _receiver->getRawval(3);
+                    c5 = _receiver->getRawval(4);
+                    c6 = _receiver->getRawval(5);
+                }
+
+            }; // class TelemetryParser
+
+            static const uint16_t RC_PORT        = 9000;
+            static const uint16_t TELEMETRY_PORT = 9001;
+
+            static const uint16_t MAX_DATAGRAM = 128;
+
+            // A sequence number this far behind the last one means the client restarted
+            static const uint32_t MAX_REORDER = 1000;
+
+            char _ssid[100] = {0};
+            char _passwd[100] = {0};
+
+            WiFiUDP _rcUdp;
+            WiFiUDP _telemetryUdp;
+
+            RcParser _rcParser;
+            TelemetryParser _telemetryParser;
+
+            uint8_t _datagram[MAX_DATAGRAM] = {};
+
+            bool _gotSequence = false;
+            uint32_t _sequence = 0;
+
+            bool _gotMessage = false;
+            float _sixvals[6] = {0};
+
+            uint32_t _dropped = 0;
+
+            static uint32_t getSequence(const uint8_t * datagram)
+            {
+                return datagram[0] | (datagram[1] << 8) | ((uint32_t)datagram[2] << 16) | ((uint32_t)datagram[3] << 24);
+            }
+
+            // Newer than the last one used, allowing for wraparound and restarts
+            bool isNewer(uint32_t sequence)
+            {
+                int32_t delta = (int32_t)(sequence - _sequence);
+
+                return !_gotSequence || delta > 0 || delta < -(int32_t)MAX_REORDER;
+            }
+
+            // Answers every request waiting on the telemetry port
+            void serveTelemetry(void)
+            {
+                while (true) {
+
+                    int size = _telemetryUdp.parsePacket();
+
+                    if (size <= 0) break;
+
+                    int count = _telemetryUdp.read(_datagram, MAX_DATAGRAM);
+
+                    if (count < 4) continue;
+
+                    _telemetryUdp.beginPacket(_telemetryUdp.remoteIP(), _telemetryUdp.remotePort());
+                    _telemetryUdp.write(_datagram, 4);
+
+                    _telemetryParser.init();
+
+                    for (int k=4; k<count; ++k) {
+
+                        _telemetryParser.parse(_datagram[k]);
+
+                        while (_telemetryParser.availableBytes() > 0) {
+                            _telemetryUdp.write(_telemetryParser.readByte());
+                        }
+                    }
+
+                    _telemetryUdp.endPacket();
+                }
+            }
+
+        protected:
+
+            void begin(void)
+            {
+                WiFi.mode(WIFI_AP);
+                if (strlen(_passwd) > 0) {
+                    WiFi.softAP(_ssid, _passwd, 1, 1);
+                }
+                else {
+                    WiFi.softAP(_ssid); // no password
+                }
+
+                _rcUdp.begin(RC_PORT);
+                _telemetryUdp.begin(TELEMETRY_PORT);
+
+                _gotSequence = false;
+                _gotMessage = false;
+                memset(_sixvals, 0, 6*sizeof(float));
+            }
+
+            bool gotNewFrame(void)
+            {
+                serveTelemetry();
+
+                // Keep only the newest datagram waiting
+                bool gotDatagram = false;
+                uint8_t newest[MAX_DATAGRAM];
+                int newestCount = 0;
+
+                while (true) {
+
+                    int size = _rcUdp.parsePacket();
+
+                    if (size <= 0) break;
+
+                    int count = _rcUdp.read(_datagram, MAX_DATAGRAM);
+
+                    if (count < 4) continue;
+
+                    uint32_t sequence = getSequence(_datagram);
+
+                    if (!isNewer(sequence)) {
+                        _dropped++;
+                        continue;
+                    }
+
+                    if (gotDatagram) {
+                        _dropped++;
+                    }
+
+                    memcpy(newest, _datagram, count);
+                    newestCount = count;
+
+                    _sequence = sequence;
+                    _gotSequence = true;
+                    gotDatagram = true;
+                }
+
+                if (!gotDatagram) return false;
+
+                _gotMessage = false;
+                _rcParser.init();
+                for (int k=4; k<newestCount; ++k) {
+                    _rcParser.parse(newest[k]);
+                }
+
+                return _gotMessage;
+            }
+
+            void readRawvals(void)
+            {
+                memset(rawvals, 0, MAXCHAN*sizeof(float));
+                memcpy(rawvals, _sixvals, 6*sizeof(float));
+            }
+
+        public:
+
+            UDP_Receiver(const uint8_t channelMap[6], const float demandScale, const char * ssid, const char * passwd="") 
+                : Receiver(channelMap, demandScale) 
+            { 
+                strcpy(_ssid, ssid);
+                strcpy(_passwd, passwd);
+
+                _rcParser._receiver = this;
+                _telemetryParser._receiver = this;
+            }
+
+            // RC datagrams that arrived late or were overtaken before we got to them
+            uint32_t getDroppedFrames(void)
+            {
+                return _dropped;
+            }
+
+            void pause(void)
+            {
+            }
+
+            void resume(void)
+            {
+            }
+
+    }; // class UDP_Receiver
+
+} // namespace hf
@@ -0,0 +1,185 @@
+/*
+   TBS Crossfire (CRSF) protocol decoder, also spoken by ExpressLRS
+
+   Frames are an address byte, a length byte counting the rest of the frame,
+   a type byte, the payload, and a CRC-8 (DVB-S2) of the type and payload.
+   Channel frames carry sixteen 11-bit channels packed as in SBUS, at 150 to
+   500 Hz; the receiver also sends link statistics a few times a second.
+   Receivers stop sending channels when they lose the transmitter.  Run the
+   serial port at 420000 baud, 8N1.
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "receivers/decoders/decoder.hpp"
+
+namespace hf {
+
+    typedef struct {
+
+        uint8_t uplinkRssi1;         // dBm, negated
+        uint8_t uplinkRssi2;         // dBm, negated
+        uint8_t uplinkLinkQuality;   // percent
+        int8_t  uplinkSnr;           // dB
+        uint8_t activeAntenna;
+        uint8_t rfMode;
+        uint8_t uplinkTxPower;
+        uint8_t downlinkRssi;        // dBm, negated
+        uint8_t downlinkLinkQuality; // percent
+        int8_t  downlinkSnr;         // dB
+
+    } crsf_link_statistics_t;
+
+    class CrsfDecoder : public RxDecoder {
+
+        private:
+
+            static const uint8_t MAX_FRAME_SIZE = 64;
+
+            // Receivers address their frames to the flight controller, but some older ones use the
+            // transmitter's or their own address
+            static const uint8_t ADDRESS_FLIGHT_CONTROLLER = 0xC8;
+            static const uint8_t ADDRESS_TRANSMITTER       = 0xEE;
+            static const uint8_t ADDRESS_RECEIVER          = 0xEC;
+
+            static const uint8_t TYPE_LINK_STATISTICS = 0x14;
+            static const uint8_t TYPE_RC_CHANNELS     = 0x16;
+
+            static const uint8_t RC_CHANNELS_SIZE     = 22;
+            static const uint8_t LINK_STATISTICS_SIZE = 10;
+
+            // Bytes come 24 usec apart within a frame, and frames at least 1.3 msec apart
+            static const uint32_t FRAME_GAP_USEC = 500;
+
+            // Same range as SBUS
+            static constexpr float MIN_VALUE = 172;
+            static constexpr float MAX_VALUE = 1811;
+
+            uint8_t _frame[MAX_FRAME_SIZE] = {};
+            uint8_t _index = 0;
+            uint8_t _crc = 0;
+            uint32_t _lastUsec = 0;
+
+            // Payload of the last channel frame
+            uint8_t _channels[RC_CHANNELS_SIZE] = {};
+
+            crsf_link_statistics_t _statistics = {};
+            bool _gotStatistics = false;
+
+            static uint8_t crc8(uint8_t crc, uint8_t c)
+            {
+                crc ^= c;
+
+                for (uint8_t k=0; k<8; ++k) {
+                    crc = (crc & 0x80) ? (crc << 1) ^ 0xD5 : crc << 1;
+                }
+
+                return crc;
+            }
+
+            static bool isAddress(uint8_t c)
+            {
+                return c == ADDRESS_FLIGHT_CONTROLLER || c == ADDRESS_TRANSMITTER || c == ADDRESS_RECEIVER;
+            }
+
+        public:
+
+            virtual bool parse(uint8_t c, uint32_t usec) override
+            {
+                if (usec - _lastUsec > FRAME_GAP_USEC) {
+                    _index = 0;
+                }
+                _lastUsec = usec;
+
+                if (_index == 0 && !isAddress(c)) return false;
+
+                // Length covers the type, payload and CRC
+                if (_index == 1 && (c < 2 || c > MAX_FRAME_SIZE - 2)) {
+                    _index = 0;
+                    return false;
+                }
+
+                _frame[_index++] = c;
+
+                if (_index < 2) return false;
+
+                uint8_t size = _frame[1] + 2;
+
+                // The CRC is spread over the bytes as they come in, to keep the time per byte short
+                if (_index == 3) {
+                    _crc = 0;
+                }
+                if (_index > 2 && _index < size) {
+                    _crc = crc8(_crc, c);
+                }
+
+                if (_index < size) return false;
+
+                _index = 0;
+
+                if (c != _crc) return false;
+
+                const uint8_t type = _frame[2];
+                const uint8_t * payload = &_frame[3];
+                const uint8_t payloadSize = size - 4;
+
+                if (type == TYPE_RC_CHANNELS && payloadSize == RC_CHANNELS_SIZE) {
+                    for (uint8_t k=0; k<RC_CHANNELS_SIZE; ++k) {
+                        _channels[k] = payload[k];
+                    }
+                    return true;
+                }
+
+                if (type == TYPE_LINK_STATISTICS && payloadSize == LINK_STATISTICS_SIZE) {
+                    _statistics.uplinkRssi1         = payload[0];
+                    _statistics.uplinkRssi2         = payload[1];
+                    _statistics.uplinkLinkQuality   = payload[2];
+                    _statistics.uplinkSnr           = (int8_t)payload[3];
+                    _statistics.activeAntenna       = payload[4];
+                    _statistics.rfMode              = payload[5];
+                    _statistics.uplinkTxPower       = payload[6];
+                    _statistics.downlinkRssi        = payload[7];
+                    _statistics.downlinkLinkQuality = payload[8];
+                    _statistics.downlinkSnr         = (int8_t)payload[9];
+                    _gotStatistics = true;
+                }
+
+                // Other frame types (telemetry, device info) are for other devices on the bus
+                return false;
+            }
+
+            virtual void decode(float * channels) override
+            {
+                unpack11(_channels, channels, MIN_VALUE, MAX_VALUE);
+            }
+
+            virtual bool linkQuality(uint8_t & percent) override
+            {
+                percent = _statistics.uplinkLinkQuality;
+                return _gotStatistics;
+            }
+
+            // Returns false until the receiver has sent any statistics
+            bool getLinkStatistics(crsf_link_statistics_t & statistics)
+            {
+                statistics = _statistics;
+                return _gotStatistics;
+            }
+
+    };  // class CrsfDecoder
+
+} // namespace hf
@@ -0,0 +1,77 @@
+/*
+   Base class for receiver protocol decoders
+
+   A decoder takes the receiver's serial stream one byte at a time, with the
+   time each byte arrived, and says when it has a complete, valid frame; the
+   channels can then be read out.  Decoders don't depend on Arduino, so they
+   can run in a UART interrupt or be fed a recorded stream on a desktop.
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace hf {
+
+    class RxDecoder {
+
+        protected:
+
+            // Sixteen 11-bit channels packed little-endian into 22 bytes, as SBUS and CRSF send them
+            static void unpack11(const uint8_t * data, float * channels, float min, float max)
+            {
+                uint32_t bits = 0;
+                uint8_t nbits = 0;
+                uint8_t b = 0;
+
+                for (uint8_t k=0; k<MAXCHAN; ++k) {
+
+                    while (nbits < 11) {
+                        bits |= (uint32_t)data[b++] << nbits;
+                        nbits += 8;
+                    }
+
+                    channels[k] = 2 * ((bits & 0x07FF) - min) / (max - min) - 1;
+
+                    bits >>= 11;
+                    nbits -= 11;
+                }
+            }
+
+        public:
+
+            static const uint8_t MAXCHAN = 16;
+
+            // Returns true when c completes a valid frame
+            virtual bool parse(uint8_t c, uint32_t usec) = 0;
+
+            // Writes the last complete frame's channels, normalized to [-1,+1], into channels[MAXCHAN]
+            virtual void decode(float * channels) = 0;
+
+            // Whether the last complete frame reported that the receiver has lost the transmitter
+            virtual bool failsafe(void) { return false; }
+
+            // Uplink quality in percent, for protocols that report it
+            virtual bool linkQuality(uint8_t & percent)
+            {
+                (void)percent;
+                return false;
+            }
+
+    };  // class RxDecoder
+
+} // namespace hf
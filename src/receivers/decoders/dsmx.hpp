@@ -0,0 +1,95 @@
+/*
+   Spektrum DSMX (2048-step) satellite protocol decoder
+
+   Frames are 16 bytes: a fades byte, a system byte, and seven 16-bit
+   big-endian servo words, each holding a 4-bit channel number over an 11-bit
+   value.  Frames have no sync byte, so we rely on the gap between them.
+   Satellites just stop sending when they lose the transmitter, so there is
+   no failsafe flag; watch for frames stopping instead.
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "receivers/decoders/decoder.hpp"
+
+namespace hf {
+
+    class DsmxDecoder : public RxDecoder {
+
+        private:
+
+            static const uint8_t FRAME_SIZE = 16;
+
+            // A frame takes 1.4 msec at 115200 baud, and frames come every 11 or 22 msec
+            static const uint32_t FRAME_GAP_USEC = 5000;
+
+            uint8_t _frame[FRAME_SIZE] = {};
+            uint8_t _index = 0;
+            uint32_t _lastUsec = 0;
+
+            // Channels can be split across two frames, so we keep them all between frames
+            uint16_t _values[MAXCHAN] = {};
+
+        public:
+
+            DsmxDecoder(void)
+            {
+                for (uint8_t k=0; k<MAXCHAN; ++k) {
+                    _values[k] = 1024;
+                }
+            }
+
+            virtual bool parse(uint8_t c, uint32_t usec) override
+            {
+                if (usec - _lastUsec > FRAME_GAP_USEC) {
+                    _index = 0;
+                }
+                _lastUsec = usec;
+
+                // Anything after a complete frame, before the next gap, is garbage
+                if (_index >= FRAME_SIZE) return false;
+
+                _frame[_index++] = c;
+
+                if (_index < FRAME_SIZE) return false;
+
+                for (uint8_t k=2; k<FRAME_SIZE; k+=2) {
+
+                    uint16_t word = (_frame[k] << 8) | _frame[k+1];
+
+                    // Unused slots are all ones
+                    if (word == 0xFFFF) continue;
+
+                    uint8_t channel = (word >> 11) & 0x0F;
+
+                    _values[channel] = word & 0x07FF;
+                }
+
+                return true;
+            }
+
+            virtual void decode(float * channels) override
+            {
+                // Same scaling as the usual 988 + value/2 microsecond servo mapping
+                for (uint8_t k=0; k<MAXCHAN; ++k) {
+                    channels[k] = (_values[k] - 1024) / 1000.f;
+                }
+            }
+
+    };  // class DsmxDecoder
+
+} // namespace hf
@@ -0,0 +1,111 @@
+/*
+   FlySky IBUS protocol decoder
+
+   Frames are 32 bytes: a length byte (0x20), a command byte (0x40),
+   fourteen 16-bit little-endian channels from 1000 to 2000, and a 16-bit
+   checksum, 0xFFFF minus the sum of the other bytes.  Frames come every 7
+   msec at 115200 baud, 8N1.  Receivers either stop sending or send their
+   failsafe positions when they lose the transmitter, so there is no
+   failsafe flag.
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "receivers/decoders/decoder.hpp"
+
+namespace hf {
+
+    class IbusDecoder : public RxDecoder {
+
+        private:
+
+            static const uint8_t FRAME_SIZE = 32;
+            static const uint8_t LENGTH     = 0x20;
+            static const uint8_t COMMAND    = 0x40;
+
+            static const uint8_t CHANNELS = 14;
+
+            // Bytes come 87 usec apart within a frame, and frames at least 4 msec apart
+            static const uint32_t FRAME_GAP_USEC = 500;
+
+            uint8_t _frame[FRAME_SIZE] = {};
+            uint8_t _index = 0;
+            uint16_t _sum = 0;
+            uint32_t _lastUsec = 0;
+
+            // The last complete frame
+            uint16_t _values[CHANNELS] = {};
+
+        public:
+
+            IbusDecoder(void)
+            {
+                for (uint8_t k=0; k<CHANNELS; ++k) {
+                    _values[k] = 1500;
+                }
+            }
+
+            virtual bool parse(uint8_t c, uint32_t usec) override
+            {
+                if (usec - _lastUsec > FRAME_GAP_USEC) {
+                    _index = 0;
+                }
+                _lastUsec = usec;
+
+                if ((_index == 0 && c != LENGTH) || (_index == 1 && c != COMMAND)) {
+                    _index = 0;
+                    return false;
+                }
+
+                if (_index == 0) {
+                    _sum = 0;
+                }
+
+                _frame[_index++] = c;
+
+                if (_index <= FRAME_SIZE - 2) {
+                    _sum += c;
+                }
+
+                if (_index < FRAME_SIZE) return false;
+
+                _index = 0;
+
+                if ((uint16_t)(0xFFFF - _sum) != (_frame[30] | (_frame[31] << 8))) return false;
+
+                // Some receivers put extra channels in the top nibbles, which we don't use
+                for (uint8_t k=0; k<CHANNELS; ++k) {
+                    _values[k] = (_frame[2+2*k] | (_frame[3+2*k] << 8)) & 0x0FFF;
+                }
+
+                return true;
+            }
+
+            virtual void decode(float * channels) override
+            {
+                for (uint8_t k=0; k<CHANNELS; ++k) {
+                    channels[k] = (_values[k] - 1500) / 500.f;
+                }
+
+                for (uint8_t k=CHANNELS; k<MAXCHAN; ++k) {
+                    channels[k] = 0;
+                }
+            }
+
+    };  // class IbusDecoder
+
+} // namespace hf
@@ -0,0 +1,92 @@
+/*
+   Futaba SBUS protocol decoder
+
+   Frames are 25 bytes: a 0x0F header, sixteen 11-bit channels packed
+   little-endian into 22 bytes, a flags byte, and an end byte (0x00, or
+   0x04/0x14/0x24/0x34 for SBUS2).  A gap in the stream always starts a new
+   frame, so we resynchronize quickly after a glitch.
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "receivers/decoders/decoder.hpp"
+
+namespace hf {
+
+    class SbusDecoder : public RxDecoder {
+
+        private:
+
+            static const uint8_t FRAME_SIZE = 25;
+            static const uint8_t HEADER     = 0x0F;
+
+            static const uint8_t FLAG_FAILSAFE = 0x08;
+
+            // Bytes come 120 usec apart within a frame, and frames at least 3 msec apart
+            static const uint32_t FRAME_GAP_USEC = 1000;
+
+            // Full stick travel
+            static constexpr float MIN_VALUE = 172;
+            static constexpr float MAX_VALUE = 1811;
+
+            uint8_t _frame[FRAME_SIZE] = {};
+            uint8_t _index = 0;
+            uint32_t _lastUsec = 0;
+
+            // The last complete frame
+            uint8_t _complete[FRAME_SIZE] = {};
+
+        public:
+
+            virtual bool parse(uint8_t c, uint32_t usec) override
+            {
+                if (usec - _lastUsec > FRAME_GAP_USEC) {
+                    _index = 0;
+                }
+                _lastUsec = usec;
+
+                if (_index == 0 && c != HEADER) return false;
+
+                _frame[_index++] = c;
+
+                if (_index < FRAME_SIZE) return false;
+
+                _index = 0;
+
+                // End byte is zero for SBUS, or zero in the low nibble and 0x04 for SBUS2
+                if (c != 0x00 && (c & 0x0F) != 0x04) return false;
+
+                for (uint8_t k=0; k<FRAME_SIZE; ++k) {
+                    _complete[k] = _frame[k];
+                }
+
+                return true;
+            }
+
+            virtual void decode(float * channels) override
+            {
+                unpack11(&_complete[1], channels, MIN_VALUE, MAX_VALUE);
+            }
+
+            virtual bool failsafe(void) override
+            {
+                return _complete[23] & FLAG_FAILSAFE;
+            }
+
+    };  // class SbusDecoder
+
+} // namespace hf
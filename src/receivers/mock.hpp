@@ -47,6 +47,14 @@ namespace hf {
                 return false;
             }
 
+            virtual void pause(void) override
+            {
+            }
+
+            virtual void resume(void) override
+            {
+            }
+
         public:
 
             MockReceiver(void) 
@@ -0,0 +1,128 @@
+/*
+   Receiver fed a byte stream, e.g. from a UART interrupt
+
+   Call handleByte() for each byte received.  The decoder turns the stream
+   into frames, which we publish in a double-buffered block of channels
+   with a sequence number: a new frame goes into the block the control loop
+   isn't using, and then the two swap.  The control loop sees a new frame
+   by comparing sequence numbers, and uses the block in place, without
+   copying it.  That block is safe until two more frames arrive, which is
+   milliseconds away for any protocol we support.
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "receiver.hpp"
+#include "receivers/decoders/decoder.hpp"
+
+namespace hf {
+
+    class StreamReceiver : public Receiver {
+
+        private:
+
+            // Consecutive frames flagged failsafe before we report a lost signal
+            static const uint8_t MAX_FAILSAFE = 10;
+
+            RxDecoder * _decoder = NULL;
+
+            float _blocks[2][RxDecoder::MAXCHAN] = {};
+
+            // Written only by handleByte()
+            volatile uint8_t  _front = 0;
+            volatile uint32_t _sequence = 0;
+            volatile uint8_t  _failsafeCount = 0;
+            volatile uint32_t _frameUsec = 0;
+
+            // Last frame the control loop took
+            uint32_t _lastSequence = 0;
+
+        protected:
+
+            virtual bool gotNewFrame(void) override
+            {
+                return _sequence != _lastSequence;
+            }
+
+            virtual void readRawvals(void) override
+            {
+                _lastSequence = _sequence;
+
+                __sync_synchronize();
+
+                rawvals = _blocks[_front];
+            }
+
+            virtual bool lostSignal(void) override
+            {
+                return _failsafeCount > MAX_FAILSAFE;
+            }
+
+            virtual bool linkQuality(uint8_t & percent) override
+            {
+                return _decoder->linkQuality(percent);
+            }
+
+        public:
+
+            StreamReceiver(RxDecoder * decoder, const uint8_t channelMap[6], const float demandScale=1.0)
+                : Receiver(channelMap, demandScale)
+            {
+                _decoder = decoder;
+            }
+
+            // Safe to call from an interrupt
+            void handleByte(uint8_t c, uint32_t usec)
+            {
+                if (!_decoder->parse(c, usec)) return;
+
+                uint8_t back = 1 - _front;
+
+                _decoder->decode(_blocks[back]);
+
+                _failsafeCount = _decoder->failsafe() ? (_failsafeCount < 255 ? _failsafeCount + 1 : 255) : 0;
+
+                __sync_synchronize();
+
+                _front = back;
+                _sequence = _sequence + 1;
+                _frameUsec = usec;
+            }
+
+            // Frames decoded so far
+            uint32_t getSequence(void)
+            {
+                return _sequence;
+            }
+
+            // Arrival time of the last byte of the latest frame
+            uint32_t getFrameUsec(void)
+            {
+                return _frameUsec;
+            }
+
+            virtual void pause(void) override
+            {
+            }
+
+            virtual void resume(void) override
+            {
+            }
+
+    };  // class StreamReceiver
+
+} // namespace hf
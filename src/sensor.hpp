@@ -1,6 +1,10 @@
 /*
    Abstract class for sensors
 
+   Sensors are pure producers: each one pushes timestamped measurements onto
+   its own queue, either from a polling task or directly from an interrupt
+   handler, and the state estimator consumes them in timestamp order.
+
    Copyright (c) 2018 Simon D. Levy
 
    This file is part of Hackflight.
@@ -21,19 +25,47 @@
 #pragma once
 
 #include "datatypes.hpp"
+#include "spscqueue.hpp"
 
 namespace hf {
 
     class Sensor {
 
         friend class Hackflight;
+        friend class StateEstimator;
+
+        private:
+
+            // The estimator drains this at a higher rate than any sensor fills it
+            static const uint8_t QUEUE_SIZE = 8;
+
+            SpscQueue<measurement_t, QUEUE_SIZE> _measurements;
+
+            // Polling producer: timestamps the measurement by when it was sampled, not when we got to it
+            void poll(float time)
+            {
+                measurement_t measurement = {};
+                measurement.time = time - getLatency();
+                getMeasurement(measurement);
+                addMeasurement(measurement);
+            }
 
         protected:
 
-            virtual void modifyState(state_t & state, float time) = 0;
+            // Fills in the type and values of the measurement; the time is already set
+            virtual void getMeasurement(measurement_t & measurement) = 0;
 
             virtual bool ready(float time) = 0;
 
+            // Override this with the seconds between a physical sample and ready() reporting it
+            virtual float getLatency(void) { return 0; }
+
+            // Interrupt-driven sensors call this from their handler, with their own timestamp
+            void addMeasurement(const measurement_t & measurement)
+            {
+                _measurements.push(measurement);
+            }
+
     };  // class Sensor
 
 } // namespace hf
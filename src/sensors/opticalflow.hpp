@@ -1,6 +1,5 @@
 /*
-   Support for PMW3901 optical-flow sensor with low-pass filter
-
+   Support for PMW3901 optical-flow sensor
 
    Copyright (c) 2018 Simon D. Levy
 
@@ -27,7 +26,6 @@
 #include <PMW3901.h>
 
 #include "sensor.hpp"
-#include "filters.hpp"
 
 namespace hf {
 
@@ -35,38 +33,29 @@ namespace hf {
 
         private:
 
-            static constexpr float   UPDATE_PERIOD = .01f;
-            static const     uint8_t LPF_SIZE      = 64;
+            static constexpr float UPDATE_PERIOD = .01f;
+
+            // Avoid time blips
+            static constexpr float MAX_DELTA_TIME = .02f;
 
             // Use digital pin 10 for chip select
             PMW3901 _flowSensor = PMW3901(10);
 
-            // Use low-pass filters for smoothing
-            LowPassFilter _lpf_x = LowPassFilter(LPF_SIZE);
-            LowPassFilter _lpf_y = LowPassFilter(LPF_SIZE);
-
             // Track elapsed time for periodic readiness
             float _previousTime = 0;
             float _deltaTime = 0;
 
         protected:
 
-            virtual void modifyState(state_t & state, float time) override
+            virtual void getMeasurement(measurement_t & measurement) override
             {
-                // Avoid time blips
-                if (_deltaTime > 0.02) return;
-
-                // Read sensor
                 int16_t dpixelx=0, dpixely=0;
                 _flowSensor.readMotionCount(&dpixelx, &dpixely);
 
-                // Scale readings by altitude, then low-pass filter them to get velocity
-                state.inertialVel[0] = _lpf_y.update(dpixely  * state.location[2] * _deltaTime);
-                state.inertialVel[1] = _lpf_x.update(-dpixelx * state.location[2] * _deltaTime);
-
-                // Integrate velocity to get position
-                state.location[0] += state.inertialVel[0];
-                state.location[1] += state.inertialVel[1];
+                measurement.type = MEASUREMENT_OPTICALFLOW;
+                measurement.values[0] = dpixelx;
+                measurement.values[1] = dpixely;
+                measurement.values[2] = _deltaTime;
             }
 
             virtual bool ready(float time) override
@@ -80,7 +69,7 @@ namespace hf {
                     _previousTime = time;
                 }
 
-                return result;
+                return result && _deltaTime < MAX_DELTA_TIME;
             }
 
         public:
@@ -94,9 +83,6 @@ namespace hf {
                     }
                 }
 
-                _lpf_x.init();
-                _lpf_y.init();
-
                 _previousTime = 0;
 
             }
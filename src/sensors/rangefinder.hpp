@@ -24,7 +24,6 @@
 #include <math.h>
 
 #include "sensor.hpp"
-#include "filters.hpp"
 
 namespace hf {
 
@@ -38,25 +37,13 @@ namespace hf {
 
             float _distance = 0;
 
-            LowPassFilter _lpf = LowPassFilter(20);
-
         protected:
 
-            virtual void modifyState(state_t & state, float time) override
+            virtual void getMeasurement(measurement_t & measurement) override
             {
-                // Previous values to support first-differencing
-                static float _time;
-                static float _altitude;
-
-                // Compensate for effect of pitch, roll on rangefinder reading
-                state.location[2] =  _distance * cos(state.rotation[0]) * cos(state.rotation[1]);
-
-                // Use first-differenced, low-pass-filtered altitude as variometer
-                state.inertialVel[2] = _lpf.update((state.location[2]-_altitude) / (time-_time));
-
-                // Update first-difference values
-                _time = time;
-                _altitude = state.location[2];
+                // Tilt compensation is done by the state estimator
+                measurement.type = MEASUREMENT_RANGEFINDER;
+                measurement.values[0] = _distance;
             }
 
             virtual bool ready(float time) override
@@ -83,13 +70,6 @@ namespace hf {
 
             virtual bool distanceAvailable(float & distance) = 0;
 
-        public:
-
-            Rangefinder(void) 
-            {
-                _lpf.init();
-            }
-
     };  // class Rangefinder
 
 } // namespace
@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include "calibration.hpp"
 #include "sensor.hpp"
 #include "imu.hpp"
 
@@ -33,6 +34,9 @@ namespace hf {
 
             IMU * imu = NULL;
 
+            // Corrects the raw readings, and learns from them while disarmed
+            Calibration * calibration = NULL;
+
     };  // class SurfaceMountSensor
 
 } // namespace
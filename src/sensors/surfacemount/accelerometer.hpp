@@ -28,7 +28,7 @@
 #include <math.h>
 
 #include "sensor.hpp"
-#include "surfacemount.hpp"
+#include "sensors/surfacemount.hpp"
 #include "board.hpp"
 
 namespace hf {
@@ -43,11 +43,16 @@ namespace hf {
 
         protected:
 
-            virtual void modifyState(state_t & state, float time) override
+            virtual void getMeasurement(measurement_t & measurement) override
             {
-                // Here is where you'd do sensor fusion
-                (void)state;
-                (void)time;
+                if (calibration) {
+                    calibration->accelerometer(_ax, _ay, _az);
+                }
+
+                measurement.type = MEASUREMENT_ACCELEROMETER;
+                measurement.values[0] = _ax;
+                measurement.values[1] = _ay;
+                measurement.values[2] = _az;
             }
 
             virtual bool ready(float time) override
@@ -1,6 +1,9 @@
 /*
    Support for surface-mounted barometer
 
+   Reports raw pressure; conversion to altitude, ground calibration, and
+   fusion happen in the state estimator.
+
    Copyright (c) 2018 Simon D. Levy
 
    This file is part of Hackflight.
@@ -24,7 +27,7 @@
 #include <math.h>
 
 #include "sensor.hpp"
-#include "surfacemount.hpp"
+#include "sensors/surfacemount.hpp"
 
 namespace hf {
 
@@ -37,11 +40,10 @@ namespace hf {
 
         protected:
 
-            virtual void modifyState(state_t & state, float time) override
+            virtual void getMeasurement(measurement_t & measurement) override
             {
-                // Here is where you'd do sensor fusion
-                (void)state;
-                (void)time;
+                measurement.type = MEASUREMENT_BAROMETER;
+                measurement.values[0] = _pressure;
             }
 
             virtual bool ready(float time) override
@@ -22,6 +22,7 @@
 
 #include <math.h>
 
+#include "filters/gyrofilter.hpp"
 #include "sensors/surfacemount.hpp"
 
 namespace hf {
@@ -36,19 +37,30 @@ namespace hf {
             float _y = 0;
             float _z = 0;
 
+            // Optional; NULL passes the raw readings through
+            GyroFilter * _filter = NULL;
+
         protected:
 
-            virtual void modifyState(state_t & state, float time) override
+            virtual void getMeasurement(measurement_t & measurement) override
             {
-                (void)time;
+                // Calibration works in the IMU's own frame
+                if (calibration) {
+                    calibration->gyrometer(_x, _y, _z);
+                }
 
                 // Compensate for IMU mounting as needed
                 imu->adjustGyrometer(_x, _y, _z);
 
                 // NB: We negate gyro X, Y to simplify PID controller
-                state.angularVel[0] =  _x;
-                state.angularVel[1] = -_y;
-                state.angularVel[2] = -_z;
+                measurement.type = MEASUREMENT_GYROMETER;
+                measurement.values[0] =  _x;
+                measurement.values[1] = -_y;
+                measurement.values[2] = -_z;
+
+                if (_filter) {
+                    _filter->apply(measurement.values);
+                }
             }
 
             virtual bool ready(float time) override
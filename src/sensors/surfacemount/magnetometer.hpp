@@ -28,7 +28,7 @@
 #include <math.h>
 
 #include "sensor.hpp"
-#include "surfacemount.hpp"
+#include "sensors/surfacemount.hpp"
 
 namespace hf {
 
@@ -42,18 +42,23 @@ namespace hf {
 
         protected:
 
-            virtual void modifyState(state_t & state, float time) override
+            virtual void getMeasurement(measurement_t & measurement) override
             {
-                // Here is where you'd do sensor fusion
-                (void)state;
-                (void)time;
+                if (calibration) {
+                    calibration->magnetometer(_mx, _my, _mz);
+                }
+
+                measurement.type = MEASUREMENT_MAGNETOMETER;
+                measurement.values[0] = _mx;
+                measurement.values[1] = _my;
+                measurement.values[2] = _mz;
             }
 
             virtual bool ready(float time) override
             {
                 (void)time;
 
-                return imu->getMagnetometer(_uTs);
+                return imu->getMagnetometer(_mx, _my, _mz);
             }
 
         public:
@@ -27,6 +27,7 @@
 
 #include <math.h>
 
+#include "attitude.hpp"
 #include "sensors/surfacemount.hpp"
 
 namespace hf {
@@ -52,22 +53,19 @@ namespace hf {
                 _z = 0;
             }
 
-            virtual void modifyState(state_t & state, float time) override
+            virtual void getMeasurement(measurement_t & measurement) override
             {
-                (void)time;
+                float * q = measurement.values;
 
-                float qw = _w, qx = _x, qy = _y, qz = _z;
+                q[0] = _w;
+                q[1] = _x;
+                q[2] = _y;
+                q[3] = _z;
 
-                imu->adjustQuaternion(qw, qx, qy, qz);
+                // Euler angles are computed later, and only if something needs them
+                imu->adjustQuaternion(q[0], q[1], q[2], q[3]);
 
-                computeEulerAngles(qw, qx, qy, qz, state.rotation);
-
-                imu->adjustEulerAngles(state.rotation[0], state.rotation[1], state.rotation[2]);
-
-                // Convert heading from [-pi,+pi] to [0,2*pi]
-                if (state.rotation[2] < 0) {
-                    state.rotation[2] += 2*M_PI;
-                }
+                measurement.type = MEASUREMENT_ATTITUDE;
             }
 
             virtual bool ready(float time) override
@@ -81,9 +79,7 @@ namespace hf {
 
             static void computeEulerAngles(float qw, float qx, float qy, float qz, float euler[3])
             {
-                euler[0] = atan2(2.0f*(qw*qx+qy*qz), qw*qw-qx*qx-qy*qy+qz*qz);
-                euler[1] = asin(2.0f*(qx*qz-qw*qy));
-                euler[2] = atan2(2.0f*(qx*qy+qw*qz), qw*qw+qx*qx-qy*qy-qz*qz);
+                Attitude::computeEulerAngles(qw, qx, qy, qz, euler);
             }
 
     };  // class Quaternion
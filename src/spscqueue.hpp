@@ -0,0 +1,96 @@
+/*
+   Lock-free single-producer, single-consumer queue
+
+   The producer (an interrupt handler or a polling task) only writes the tail
+   index, and the consumer only writes the head index, so neither side ever
+   has to disable interrupts.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace hf {
+
+    // Holds up to SIZE-1 items
+    template <typename T, uint8_t SIZE>
+    class SpscQueue {
+
+        private:
+
+            T _items[SIZE];
+
+            volatile uint8_t _head = 0; // next item to read; written by consumer only
+            volatile uint8_t _tail = 0; // next slot to write; written by producer only
+
+            static uint8_t next(uint8_t index)
+            {
+                return (index + 1) % SIZE;
+            }
+
+        public:
+
+            // Producer side: returns false, dropping the item, if the queue is full
+            bool push(const T & item)
+            {
+                uint8_t tail = _tail;
+                uint8_t newTail = next(tail);
+
+                if (newTail == _head) {
+                    return false;
+                }
+
+                _items[tail] = item;
+
+                // Make sure the item is written before the consumer can see it
+                __sync_synchronize();
+
+                _tail = newTail;
+
+                return true;
+            }
+
+            // Consumer side: returns NULL if the queue is empty
+            const T * peek(void)
+            {
+                uint8_t head = _head;
+
+                if (head == _tail) {
+                    return NULL;
+                }
+
+                // Make sure we read the item after seeing the producer's tail
+                __sync_synchronize();
+
+                return &_items[head];
+            }
+
+            // Consumer side: call only after peek() has returned an item
+            void pop(void)
+            {
+                // Make sure we're done with the item before the producer can reuse its slot
+                __sync_synchronize();
+
+                _head = next(_head);
+            }
+
+    };  // class SpscQueue
+
+} // namespace hf
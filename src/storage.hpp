@@ -0,0 +1,118 @@
+/*
+   Framing for blobs kept in the board's non-volatile storage
+
+   Each blob is stored as a magic number, a version, its size, the payload,
+   and a CRC-16 over everything before it.  Loading fails (leaving the
+   caller's defaults alone) unless all of these match, so a blank chip, a
+   layout change, or a torn write never gets loaded as real data.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "board.hpp"
+
+namespace hf {
+
+    class Storage {
+
+        private:
+
+            static const uint8_t HEADER_SIZE = 5;   // magic (2), version, size (2)
+            static const uint8_t CRC_SIZE    = 2;
+            static const uint8_t CHUNK_SIZE  = 16;
+
+            // CRC-16/CCITT-FALSE
+            static uint16_t crc16(uint16_t crc, const uint8_t * data, uint16_t size)
+            {
+                for (uint16_t k=0; k<size; ++k) {
+                    crc ^= (uint16_t)data[k] << 8;
+                    for (uint8_t b=0; b<8; ++b) {
+                        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+                    }
+                }
+                return crc;
+            }
+
+            static void header(uint8_t buf[HEADER_SIZE], uint16_t magic, uint8_t version, uint16_t size)
+            {
+                buf[0] = magic & 0xFF;
+                buf[1] = magic >> 8;
+                buf[2] = version;
+                buf[3] = size & 0xFF;
+                buf[4] = size >> 8;
+            }
+
+        public:
+
+            // Bytes of storage a blob of the given payload size occupies
+            static constexpr uint16_t footprint(uint16_t size)
+            {
+                return HEADER_SIZE + size + CRC_SIZE;
+            }
+
+            static bool load(Board * board, uint16_t address, uint16_t magic, uint8_t version, void * data, uint16_t size)
+            {
+                uint8_t expected[HEADER_SIZE];
+                uint8_t actual[HEADER_SIZE];
+                header(expected, magic, version, size);
+
+                if (!board->storageRead(address, actual, HEADER_SIZE)) return false;
+
+                for (uint8_t k=0; k<HEADER_SIZE; ++k) {
+                    if (actual[k] != expected[k]) return false;
+                }
+
+                // Check the CRC in small chunks first, so that a bad blob leaves the caller's data untouched
+                uint16_t computed = crc16(0xFFFF, actual, HEADER_SIZE);
+
+                for (uint16_t k=0; k<size; k+=CHUNK_SIZE) {
+                    uint8_t chunk[CHUNK_SIZE];
+                    uint16_t n = size - k < CHUNK_SIZE ? size - k : CHUNK_SIZE;
+                    if (!board->storageRead(address + HEADER_SIZE + k, chunk, n)) return false;
+                    computed = crc16(computed, chunk, n);
+                }
+
+                uint8_t crc[CRC_SIZE];
+                if (!board->storageRead(address + HEADER_SIZE + size, crc, CRC_SIZE)) return false;
+
+                if (crc[0] != (computed & 0xFF) || crc[1] != (computed >> 8)) return false;
+
+                return board->storageRead(address + HEADER_SIZE, (uint8_t *)data, size);
+            }
+
+            static bool save(Board * board, uint16_t address, uint16_t magic, uint8_t version, const void * data, uint16_t size)
+            {
+                uint8_t head[HEADER_SIZE];
+                header(head, magic, version, size);
+
+                const uint8_t * payload = (const uint8_t *)data;
+
+                uint16_t computed = crc16(crc16(0xFFFF, head, HEADER_SIZE), payload, size);
+                uint8_t crc[CRC_SIZE] = { (uint8_t)(computed & 0xFF), (uint8_t)(computed >> 8) };
+
+                return board->storageWrite(address, head, HEADER_SIZE) &&
+                       board->storageWrite(address + HEADER_SIZE, payload, size) &&
+                       board->storageWrite(address + HEADER_SIZE + size, crc, CRC_SIZE);
+            }
+
+    };  // class Storage
+
+} // namespace hf
@@ -52,15 +52,24 @@ namespace hf {
 
             void update(void)
             {
-                float time = _board->getTime();
-
-                if ((time - _time) > _period)
-                {
-                    doTask();
-                    _time = time;
+                if (due()) {
+                    run();
                 }
             }
 
+            // True when update() would run the task
+            bool due(void)
+            {
+                return (_board->getTime() - _time) > _period;
+            }
+
+            // Runs the task now, restarting its period
+            void run(void)
+            {
+                _time = _board->getTime();
+                doTask();
+            }
+
             void change_frequency(float freq){
                 _period = 1 / freq;
             }
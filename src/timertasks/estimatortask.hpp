@@ -0,0 +1,63 @@
+/*
+   Timer task for the state estimator
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "timertask.hpp"
+#include "estimator.hpp"
+#include "datatypes.hpp"
+
+namespace hf {
+
+    class EstimatorTask : public TimerTask {
+
+        friend class Hackflight;
+
+        private:
+
+            // Fast enough to keep the queues short; Hackflight also runs us just before each PID iteration
+            static constexpr float FREQ = 500;
+
+            StateEstimator * _estimator = NULL;
+            state_t * _state = NULL;
+
+        protected:
+
+            EstimatorTask(void)
+                : TimerTask(FREQ)
+            {
+            }
+
+            void init(Board * board, StateEstimator * estimator, state_t * state)
+            {
+                TimerTask::init(board);
+
+                _estimator = estimator;
+                _state = state;
+            }
+
+            virtual void doTask(void) override
+            {
+                _estimator->update(*_state, _board->getTime());
+            }
+
+    };  // EstimatorTask
+
+} // namespace hf
@@ -21,6 +21,10 @@
 #pragma once
 
 #include "timertask.hpp"
+#include "pidcontroller.hpp"
+#include "parameters.hpp"
+#include "failsafe.hpp"
+#include "filters/rcsmoother.hpp"
 #include "loggingfunctions.hpp"
 #include "update_scheduler.hpp"
 
@@ -29,12 +33,13 @@ namespace hf {
     class PidTask : public TimerTask {
 
         friend class Hackflight;
+        friend class SerialTask;
 
         private:
 
             // For now, we keep all PID timer tasks the same.  At some point it might be useful to 
             // investigate, e.g., faster updates for Rate PID than for Level PID.
-            float FREQ = 300;
+            static constexpr float FREQ = 300;
 
             static constexpr unsigned int task_id = 0;
 
@@ -46,6 +51,13 @@ namespace hf {
             Receiver * _receiver = NULL;
             Mixer * _mixer = NULL;
             state_t  * _state    = NULL;
+            Parameters * _parameters = NULL;
+
+            // Fills in receiver demands between frames
+            RcSmoother _rcSmoother;
+
+            // Takes over the demands when the receiver link goes bad
+            Failsafe _failsafe;
             UpdateScheduler *_update_scheduler = NULL;
 
             demands_t previous_demands = {};
@@ -60,14 +72,14 @@ namespace hf {
                 _pid_controller_count = 0;
             }
 
-            void init(Board *board, Receiver *receiver, Mixer *mixer, state_t *state, UpdateScheduler *update_scheduler)
+            void init(Board *board, Receiver *receiver, Mixer *mixer, state_t *state, Parameters *parameters, UpdateScheduler *update_scheduler)
             {
-                change_frequency(FREQ);
                 TimerTask::init(board);
 
                 _receiver = receiver;
                 _mixer = mixer;
                 _state = state;
+                _parameters = parameters;
                 _update_scheduler = update_scheduler;
                 _update_scheduler->set_task_period(0, 1000000/FREQ);
             }
@@ -125,15 +137,34 @@ namespace hf {
                 _pid_controllers[_pid_controller_count++] = pidController;
             }
 
+            // Hands each controller its gains from the parameters; they take effect on its next iteration
+            void stageGains(Parameters * parameters)
+            {
+                for (uint8_t k=0; k<_pid_controller_count; ++k) {
+
+                    PidController * pidController = _pid_controllers[k];
+
+                    uint8_t id = pidController->gainsId();
+                    uint8_t count = 0;
+                    const float * gains = parameters->gains(id, count);
+
+                    if (gains && parameters->hasGcsGains(id)) {
+                        pidController->stageGains(gains, count);
+                    }
+                }
+            }
+
             virtual void doTask(void) override
             {
                 printTaskTime(task_id, true);
-                // Start with demands from receiver, scaling roll/pitch/yaw by constant
+                // Start with demands from receiver, smoothed between frames, scaling roll/pitch/yaw by constant
+                float time = _board->getTime();
                 demands_t demands = {};
-                demands.throttle = _receiver->demands.throttle;
-                demands.roll     = _receiver->demands.roll  * _receiver->_demandScale;
-                demands.pitch    = _receiver->demands.pitch * _receiver->_demandScale;
-                demands.yaw      = _receiver->demands.yaw   * _receiver->_demandScale;
+                _rcSmoother.get(time, demands);
+                _failsafe.modifyDemands(demands);
+                demands.roll     *= _receiver->_demandScale;
+                demands.pitch    *= _receiver->_demandScale;
+                demands.yaw      *= _receiver->_demandScale;
 
                 // Each PID controllers is associated with at least one auxiliary switch state
                 uint8_t auxState = _receiver->getAux2State();
@@ -147,16 +178,28 @@ namespace hf {
 
                     PidController * pidController = _pid_controllers[k];
 
+                    // Pick up any new gains from the GCS before this iteration
+                    pidController->swapGains();
+
                     // Some PID controllers need to reset their integral when the throttle is down
                     pidController->updateReceiver(_receiver->throttleIsDown());
 
-                    if (pidController->auxState <= auxState) {
+                    pidController->updateTime(time);
+
+                    if (pidController->auxState <= auxState || _failsafe.engages(pidController->gainsId())) {
 
                         pidController->modifyDemands(_state, demands); 
 
                         if (pidController->shouldFlashLed()) {
                             shouldFlash = true;
                         }
+
+                        // Gains from an autotuner go to the other controllers the same way as gains from the GCS
+                        uint8_t id = GAINS_NONE;
+                        float gains[PidController::MAX_GAINS] = {};
+                        if (pidController->getTunedGains(id, gains) && _parameters->setGains(id, gains)) {
+                            stageGains(_parameters);
+                        }
                     }
                 }
 
@@ -21,10 +21,14 @@
 #pragma once
 
 #include "timertask.hpp"
+#include "attitude.hpp"
 #include "board.hpp"
 #include "mspparser.hpp"
 #include "debugger.hpp"
 #include "mixer.hpp"
+#include "parameters.hpp"
+#include "arming.hpp"
+#include "timertasks/pidtask.hpp"
 #include "loggingfunctions.hpp"
 #include "update_scheduler.hpp"
 
@@ -36,7 +40,7 @@ namespace hf {
 
         private:
 
-            float FREQ = 66;
+            static constexpr float FREQ = 66;
 
             static constexpr unsigned int task_id = 1;
 
@@ -45,6 +49,24 @@ namespace hf {
             state_t  * _state = NULL;
             UpdateScheduler *_update_scheduler = NULL;
 
+            // Optional: reported as zeros when no sensor runs a state estimator
+            const estimator_health_t * _health = NULL;
+
+            Parameters * _parameters = NULL;
+            PidTask    * _pidTask = NULL;
+            Arming     * _arming = NULL;
+
+            // New gains reach the controllers between their iterations, without resetting them
+            void setPidGains(uint8_t id, const float * gains)
+            {
+                if (_parameters->setGains(id, gains)) {
+                    _pidTask->stageGains(_parameters);
+                }
+            }
+
+            // Next parameter reported to the GCS
+            uint8_t _parameterIndex = 0;
+
 
             void _init(Board * board, state_t * state, Receiver * receiver) 
             {
@@ -90,21 +112,21 @@ namespace hf {
                 variometer = 0;
                 positionX = 0;
                 positionY = 0;
-                heading = -_state->rotation[AXIS_YAW]; // NB: Angle negated for remote visualization
+                heading = -Attitude::getEulerAngles(*_state)[AXIS_YAW]; // NB: Angle negated for remote visualization
                 velocityForward = 0;
                 velocityRightward = 0;
             }
  
             virtual void handle_SET_ARMED(uint8_t  flag) override
             {
-                if (flag) {  // got arming command: arm only if throttle is down
-                    if (_receiver->throttleIsDown()) {
-                        _state->armed = true;
-                    }
-                }
-                else {          // got disarming command: always disarm
-                    _state->armed = false;
-                }
+                // Arming needs the arming switch on and nothing blocking, as from the receiver; disarming always works
+                _arming->request(flag);
+            }
+
+            virtual void handle_ARMING_STATUS_Request(float & armed, float & blocks) override
+            {
+                armed  = _state->armed;
+                blocks = _arming->getBlocks();
             }
 
             virtual void handle_RC_NORMAL_Request(float & c1, float & c2, float & c3, float & c4, float & c5, float & c6) override
@@ -119,9 +141,80 @@ namespace hf {
 
             virtual void handle_ATTITUDE_RADIANS_Request(float & roll, float & pitch, float & yaw) override
             {
-                roll  = _state->rotation[AXIS_ROLL];
-                pitch = _state->rotation[AXIS_PITCH];
-                yaw   = _state->rotation[AXIS_YAW];
+                const float * euler = Attitude::getEulerAngles(*_state);
+
+                roll  = euler[AXIS_ROLL];
+                pitch = euler[AXIS_PITCH];
+                yaw   = euler[AXIS_YAW];
+            }
+
+            virtual void handle_ESTIMATOR_HEALTH_Request(float & nanResets, float & divergenceResets, 
+                    float & covarianceTrace, float & innovationRatio) override
+            {
+                if (_health) {
+                    nanResets        = _health->nanResets;
+                    divergenceResets = _health->divergenceResets;
+                    covarianceTrace  = _health->covarianceTrace;
+                    innovationRatio  = _health->innovationRatio;
+                }
+            }
+
+            virtual void handle_PARAMETER_Request(float & index, float & count, float & value, float & min, float & max) override
+            {
+                index = _parameterIndex;
+                count = _parameters->count();
+
+                if (_parameters->get(_parameterIndex, value, min, max)) {
+                    _parameterIndex = (_parameterIndex + 1) % _parameters->count();
+                }
+            }
+
+            virtual void handle_SELECT_PARAMETER(uint8_t  index) override
+            {
+                _parameterIndex = index;
+            }
+
+            virtual void handle_SET_PARAMETER(uint8_t  index, float  value) override
+            {
+                // The parameter may be a receiver curve or a PID gain
+                if (_parameters->set(index, value)) {
+                    _receiver->updateCurves();
+                    _pidTask->stageGains(_parameters);
+                }
+            }
+
+            virtual void handle_SET_RATE_PID(float  Kp, float  Ki, float  Kd, float  Kp_yaw, float  Ki_yaw) override
+            {
+                float gains[5] = {Kp, Ki, Kd, Kp_yaw, Ki_yaw};
+                setPidGains(GAINS_RATE, gains);
+            }
+
+            virtual void handle_SET_LEVEL_PID(float  Kp_roll, float  Kp_pitch) override
+            {
+                float gains[2] = {Kp_roll, Kp_pitch};
+                setPidGains(GAINS_LEVEL, gains);
+            }
+
+            virtual void handle_SET_ALTHOLD_PID(float  Kp_pos, float  Kp_vel, float  Ki_vel, float  Kd_vel) override
+            {
+                float gains[4] = {Kp_pos, Kp_vel, Ki_vel, Kd_vel};
+                setPidGains(GAINS_ALTHOLD, gains);
+            }
+
+            virtual void handle_SET_FLOWHOLD_PID(float  Kp, float  Ki) override
+            {
+                float gains[2] = {Kp, Ki};
+                setPidGains(GAINS_FLOWHOLD, gains);
+            }
+
+            virtual void handle_COMMIT_PARAMETERS(uint8_t  flag) override
+            {
+                (void)flag;
+
+                // Writing to flash can stall the loop for milliseconds, which we can't afford in flight
+                if (!_state->armed) {
+                    _parameters->commit(_board);
+                }
             }
 
             virtual void handle_SET_MOTOR_NORMAL(float  m1, float  m2, float  m3, float  m4) override
@@ -137,17 +230,24 @@ namespace hf {
             {
             }
 
-            void init(Board *board, state_t *state, Receiver *receiver, Mixer *mixer, UpdateScheduler *update_scheduler)
+            void init(Board *board, state_t *state, Receiver *receiver, Mixer *mixer, Parameters *parameters, PidTask *pidTask, Arming *arming, UpdateScheduler *update_scheduler)
             {
-                change_frequency(FREQ);
                 TimerTask::init(board);
                 _state = state;
                 _receiver = receiver;
                 _mixer = mixer;
+                _parameters = parameters;
+                _pidTask = pidTask;
+                _arming = arming;
                 _update_scheduler = update_scheduler;
                 _update_scheduler->set_task_period(1, 1000000 / FREQ);
             }
 
+            void useEstimatorHealth(const estimator_health_t * health)
+            {
+                _health = health;
+            }
+
     };  // SerialTask
 
 } // namespace hf
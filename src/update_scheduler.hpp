@@ -54,11 +54,18 @@ namespace hf
             number_of_tasks = sensor_count + 2;
             hf::UpdateScheduler::_receiver = receiver;
             hf::UpdateScheduler::update_time_required = update_time_required;
-            for (int i = 0; i < number_of_tasks; i++) {
+            for (unsigned int i = 0; i < number_of_tasks; i++) {
                 task_infos.push_back(task_info());
             }
         }
 
+        // Each sensor added after init() gets its own task
+        void add_task(void)
+        {
+            task_infos.push_back(task_info());
+            number_of_tasks++;
+        }
+
             void set_task_period(int task_id, unsigned int period)
         {
             task_infos[task_id].period = period;
@@ -80,12 +87,10 @@ namespace hf
         unsigned int when_schedule_update(unsigned int update_time_required)
         {
             unsigned int min_value = UINT_MAX;
-            unsigned int min_index;
             for (unsigned int i = 0; i < number_of_tasks; i++) {
                 print_string("Task index,%d,Next invocation time,%d\n", i, task_infos[i].time_next_invocation);
                 if (task_infos[i].time_next_invocation < min_value) {
                     min_value = task_infos[i].time_next_invocation;
-                    min_index = i;
                 }
             }
             unsigned int current_time = micros();